@@ -1,2 +1,4 @@
 #cmake -DCMAKE_CXX_COMPILER=g++ -DCMAKE_C_COMPILER=gcc -DCMAKE_BUILD_TYPE=Release -DLLVM_ENABLE_PIC=off -DLLVM_ENABLE_RTTI=off -DLLVM_ENABLE_TERMINFO=off -DLLVM_ENABLE_THREADS=off -DLLVM_ENABLE_TIMESTAMPS=off -DLLVM_ENABLE_ZLIB=off -DLLVM_TARGETS_TO_BUILD="X86" -DLLVM_BUILD_32_BITS=on -DLLVM_EXTERNAL_CLANG_BUILD=off -DLLVM_EXTERNAL_COMPILER_RT_BUILD=off  ..
-cmake -DCMAKE_CXX_COMPILER=g++ -DCMAKE_C_COMPILER=gcc -DCMAKE_BUILD_TYPE=RelWithDebInfo -DLLVM_ENABLE_PIC=off -DLLVM_ENABLE_RTTI=off -DLLVM_ENABLE_TERMINFO=off -DLLVM_ENABLE_TIMESTAMPS=off -DLLVM_ENABLE_ZLIB=off -DLLVM_TARGETS_TO_BUILD="X86" -DLLVM_BUILD_32_BITS=on -DLLVM_EXTERNAL_CLANG_BUILD=off -DLLVM_EXTERNAL_COMPILER_RT_BUILD=off  ..
+# ./configurellvm.sh x64 builds LLVM for an x86-64 host, see target_arch in build/common.gypi.
+if [ "$1" = "x64" ]; then BUILD_32_BITS=off; else BUILD_32_BITS=on; fi
+cmake -DCMAKE_CXX_COMPILER=g++ -DCMAKE_C_COMPILER=gcc -DCMAKE_BUILD_TYPE=RelWithDebInfo -DLLVM_ENABLE_PIC=off -DLLVM_ENABLE_RTTI=off -DLLVM_ENABLE_TERMINFO=off -DLLVM_ENABLE_TIMESTAMPS=off -DLLVM_ENABLE_ZLIB=off -DLLVM_TARGETS_TO_BUILD="X86" -DLLVM_BUILD_32_BITS=$BUILD_32_BITS -DLLVM_EXTERNAL_CLANG_BUILD=off -DLLVM_EXTERNAL_COMPILER_RT_BUILD=off  ..
@@ -0,0 +1,18 @@
+#ifndef CHAINLOOKUP_H
+#define CHAINLOOKUP_H
+#include <stdint.h>
+namespace jit {
+
+// Asked while linking an LLVM translation, for each direct exit whose
+// successor is known: the guest block at pc with flags. Returns where
+// the exit should jump, the m_chainEntry of the successor's translation
+// in either tier, or null to leave the exit to the dispatcher. site is
+// the direct jump of the exit, as the dispatcher would have reported it.
+// A non-null result makes it a chained site like any other: the embedder
+// unchains it with unpatchDirectJump(site, dispDirect) when the successor
+// is invalidated, and points it at the new m_chainEntry with
+// retargetDirectJump when another tier replaces the successor. Link pads
+// the exit so the immediate of site stays in one cache line.
+typedef void* (*ChainLookup)(void* opaque, uint32_t pc, uint64_t flags, uintptr_t site);
+}
+#endif /* CHAINLOOKUP_H */
@@ -0,0 +1,273 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+#include "LLVMAPI.h"
+#include "CompilePipeline.h"
+#include "HelperLibrary.h"
+
+namespace jit {
+static pthread_key_t pipelineKey;
+static pthread_once_t pipelineKeyOnce = PTHREAD_ONCE_INIT;
+static unsigned recycleLimit = 1000;
+
+void CompilePipeline::createKey()
+{
+    pthread_key_create(&pipelineKey, destroy);
+}
+
+void CompilePipeline::destroy(void* p)
+{
+    delete static_cast<CompilePipeline*>(p);
+}
+
+CompilePipeline& CompilePipeline::current()
+{
+    pthread_once(&pipelineKeyOnce, createKey);
+    CompilePipeline* pipeline = static_cast<CompilePipeline*>(pthread_getspecific(pipelineKey));
+    if (!pipeline) {
+        pipeline = new CompilePipeline;
+        pthread_setspecific(pipelineKey, pipeline);
+    }
+    return *pipeline;
+}
+
+void CompilePipeline::setRecycleLimit(unsigned limit)
+{
+    EMASSERT(limit != 0);
+    recycleLimit = limit;
+}
+
+CompilePipeline::CompilePipeline()
+    : m_context(nullptr)
+    , m_helperLibrary(nullptr)
+    , m_targetMachine(nullptr)
+    , m_fastPasses(nullptr)
+    , m_basicPasses(nullptr)
+    , m_fullPasses(nullptr)
+    , m_aggressivePasses(nullptr)
+    , m_loopPasses(nullptr)
+    , m_dataLayout(nullptr)
+    , m_users(0)
+    , m_compilations(0)
+{
+}
+
+CompilePipeline::~CompilePipeline()
+{
+    EMASSERT(m_users == 0);
+    reset();
+}
+
+LLVMContextRef CompilePipeline::acquireContext()
+{
+    if (!m_context)
+        m_context = llvmAPI->ContextCreate();
+    m_users++;
+    return m_context;
+}
+
+void CompilePipeline::releaseContext()
+{
+    EMASSERT(m_users != 0);
+    m_users--;
+    if (m_users == 0 && ++m_compilations >= recycleLimit)
+        reset();
+}
+
+HelperLibrary* CompilePipeline::helperLibrary()
+{
+    EMASSERT(m_context != nullptr);
+    if (!m_helperLibrary)
+        m_helperLibrary = new HelperLibrary(m_context);
+    return m_helperLibrary;
+}
+
+void CompilePipeline::reset()
+{
+    delete m_helperLibrary;
+    if (m_fastPasses)
+        llvmAPI->DisposePassManager(m_fastPasses);
+    if (m_basicPasses)
+        llvmAPI->DisposePassManager(m_basicPasses);
+    if (m_fullPasses)
+        llvmAPI->DisposePassManager(m_fullPasses);
+    if (m_aggressivePasses)
+        llvmAPI->DisposePassManager(m_aggressivePasses);
+    if (m_loopPasses)
+        llvmAPI->DisposePassManager(m_loopPasses);
+    if (m_dataLayout)
+        free(m_dataLayout);
+    if (m_targetMachine)
+        llvmAPI->DisposeTargetMachine(m_targetMachine);
+    if (m_context)
+        llvmAPI->ContextDispose(m_context);
+    m_helperLibrary = nullptr;
+    m_fastPasses = nullptr;
+    m_basicPasses = nullptr;
+    m_fullPasses = nullptr;
+    m_aggressivePasses = nullptr;
+    m_loopPasses = nullptr;
+    m_dataLayout = nullptr;
+    m_targetMachine = nullptr;
+    m_context = nullptr;
+    m_compilations = 0;
+}
+
+void CompilePipeline::createPasses(LLVMExecutionEngineRef engine)
+{
+    // clone the target machine of the engine, which dies with the engine.
+    LLVMTargetMachineRef engineMachine = llvmAPI->GetExecutionEngineTargetMachine(engine);
+    char* triple = llvmAPI->GetTargetMachineTriple(engineMachine);
+    char* cpu = llvmAPI->GetTargetMachineCPU(engineMachine);
+    char* features = llvmAPI->GetTargetMachineFeatureString(engineMachine);
+#if defined(__i386__)
+    // the VFP lowering assumes SSE2, which ia32 gets only from the engine
+    // features llvm.3.6.1.patch sets. x87 would round twice and keep the
+    // exception flags out of MXCSR.
+    if (!strstr(features, "+sse2")) {
+        LOGE("FATAL: LLVM would emit x87 floating point, features %s.\n", features);
+        EMASSERT(false);
+    }
+#endif
+    LLVMTargetRef target;
+    char* error = nullptr;
+    if (llvmAPI->GetTargetFromTriple(triple, &target, &error)) {
+        LOGE("FATAL: Could not find LLVM target %s: %s", triple, error);
+        EMASSERT(false);
+    }
+    m_targetMachine = llvmAPI->CreateTargetMachine(target, triple, cpu, features,
+        LLVMCodeGenLevelDefault, LLVMRelocDefault, LLVMCodeModelJITDefault);
+    llvmAPI->DisposeMessage(triple);
+    llvmAPI->DisposeMessage(cpu);
+    llvmAPI->DisposeMessage(features);
+
+    LLVMTargetDataRef targetData = llvmAPI->GetTargetMachineData(m_targetMachine);
+    m_dataLayout = llvmAPI->CopyStringRepOfTargetData(targetData);
+
+    // promotion needs mem2reg at any level.
+    LLVMPassManagerRef fastPasses = llvmAPI->CreatePassManager();
+    llvmAPI->AddTargetData(targetData, fastPasses);
+    llvmAPI->AddPromoteMemoryToRegisterPass(fastPasses);
+    llvmAPI->AddLowerSwitchPass(fastPasses);
+    m_fastPasses = fastPasses;
+
+    // Basic cleans up what the lowering leaves behind, without the alias
+    // analysis and GVN that make up most of the time of Full.
+    LLVMPassManagerRef basicPasses = createPassManager(targetData);
+    llvmAPI->AddPromoteMemoryToRegisterPass(basicPasses);
+    llvmAPI->AddConstantPropagationPass(basicPasses);
+    llvmAPI->AddInstructionCombiningPass(basicPasses);
+    llvmAPI->AddCFGSimplificationPass(basicPasses);
+    llvmAPI->AddAggressiveDCEPass(basicPasses);
+    llvmAPI->AddLowerSwitchPass(basicPasses);
+    m_basicPasses = basicPasses;
+
+    // the NEON lowering leaves a vector operation per 32 or 64 bit piece
+    // of a register, SLP joins the neighbouring ones outside of loops too.
+    LLVMPassManagerRef fullPasses = createPassManager(targetData);
+    addScalarPasses(fullPasses);
+    addVectorCleanupPasses(fullPasses);
+    llvmAPI->AddLowerSwitchPass(fullPasses);
+    m_fullPasses = fullPasses;
+
+    // Aggressive threads the flag tests of consecutive guest instructions
+    // through each other and runs the scalar set a second time on what
+    // that leaves.
+    LLVMPassManagerRef aggressivePasses = createPassManager(targetData);
+    addScalarPasses(aggressivePasses);
+    llvmAPI->AddCorrelatedValuePropagationPass(aggressivePasses);
+    llvmAPI->AddJumpThreadingPass(aggressivePasses);
+    llvmAPI->AddReassociatePass(aggressivePasses);
+    addScalarPasses(aggressivePasses);
+    addVectorCleanupPasses(aggressivePasses);
+    llvmAPI->AddLowerSwitchPass(aggressivePasses);
+    m_aggressivePasses = aggressivePasses;
+
+    LLVMPassManagerRef loopPasses = createPassManager(targetData);
+    addScalarPasses(loopPasses);
+    addLoopPasses(loopPasses);
+    llvmAPI->AddLowerSwitchPass(loopPasses);
+    m_loopPasses = loopPasses;
+}
+
+LLVMPassManagerRef CompilePipeline::createPassManager(LLVMTargetDataRef targetData)
+{
+    LLVMPassManagerRef passes = llvmAPI->CreatePassManager();
+    llvmAPI->AddTargetData(targetData, passes);
+    llvmAPI->AddAnalysisPasses(m_targetMachine, passes);
+    return passes;
+}
+
+void CompilePipeline::addScalarPasses(LLVMPassManagerRef passes)
+{
+    llvmAPI->AddPromoteMemoryToRegisterPass(passes);
+    llvmAPI->AddGlobalOptimizerPass(passes);
+    llvmAPI->AddFunctionInliningPass(passes);
+    llvmAPI->AddPruneEHPass(passes);
+    llvmAPI->AddGlobalDCEPass(passes);
+    llvmAPI->AddConstantPropagationPass(passes);
+    llvmAPI->AddAggressiveDCEPass(passes);
+    llvmAPI->AddInstructionCombiningPass(passes);
+    // BEGIN - DO NOT CHANGE THE ORDER OF THE ALIAS ANALYSIS PASSES
+    llvmAPI->AddTypeBasedAliasAnalysisPass(passes);
+    llvmAPI->AddBasicAliasAnalysisPass(passes);
+    // END - DO NOT CHANGE THE ORDER OF THE ALIAS ANALYSIS PASSES
+    llvmAPI->AddGVNPass(passes);
+    llvmAPI->AddCFGSimplificationPass(passes);
+    llvmAPI->AddDeadStoreEliminationPass(passes);
+}
+
+void CompilePipeline::addVectorCleanupPasses(LLVMPassManagerRef passes)
+{
+    llvmAPI->AddSLPVectorizePass(passes);
+    llvmAPI->AddInstructionCombiningPass(passes);
+    llvmAPI->AddCFGSimplificationPass(passes);
+}
+
+// after the scalar cleanup the guest registers of a loop are SSA values,
+// and TBAA keeps env and guest memory apart, so only accesses to guest
+// memory may alias each other. The loop vectorizer checks those at run
+// time before it takes the vector loop.
+void CompilePipeline::addLoopPasses(LLVMPassManagerRef passes)
+{
+    llvmAPI->AddLoopRotatePass(passes);
+    llvmAPI->AddLICMPass(passes);
+    llvmAPI->AddIndVarSimplifyPass(passes);
+    llvmAPI->AddLoopDeletionPass(passes);
+    llvmAPI->AddLoopUnrollPass(passes);
+    llvmAPI->AddLoopVectorizePass(passes);
+    llvmAPI->AddSLPVectorizePass(passes);
+    llvmAPI->AddInstructionCombiningPass(passes);
+    llvmAPI->AddGVNPass(passes);
+    llvmAPI->AddCFGSimplificationPass(passes);
+    llvmAPI->AddDeadStoreEliminationPass(passes);
+}
+
+void CompilePipeline::optimize(LLVMModuleRef module, LLVMExecutionEngineRef engine, OptLevel level, bool loops)
+{
+    if (!m_fastPasses)
+        createPasses(engine);
+    llvmAPI->SetDataLayout(module, m_dataLayout);
+    LLVMPassManagerRef passes = nullptr;
+    if (loops && level >= OptLevel::Full)
+        passes = m_loopPasses;
+    else {
+        switch (level) {
+        case OptLevel::Fast:
+            passes = m_fastPasses;
+            break;
+        case OptLevel::Basic:
+            passes = m_basicPasses;
+            break;
+        case OptLevel::Full:
+            passes = m_fullPasses;
+            break;
+        case OptLevel::Aggressive:
+            passes = m_aggressivePasses;
+            break;
+        }
+    }
+    llvmAPI->RunPassManager(passes, module);
+}
+}
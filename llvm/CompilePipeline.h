@@ -0,0 +1,58 @@
+#ifndef COMPILEPIPELINE_H
+#define COMPILEPIPELINE_H
+#include "LLVMHeaders.h"
+#include "CompilePolicy.h"
+namespace jit {
+class HelperLibrary;
+
+// LLVM objects that outlive a single compilation, one set per thread: the
+// context modules are built in, the helper library loaded into it, a
+// target machine and the module pass managers, one per OptLevel. Types
+// and constants pile up in a context, so the whole set is rebuilt every
+// recycle limit compilations.
+class CompilePipeline {
+public:
+    static CompilePipeline& current();
+    // 1 rebuilds everything for every compilation.
+    static void setRecycleLimit(unsigned limit);
+
+    // the context for a new module, paired with releaseContext.
+    LLVMContextRef acquireContext();
+    void releaseContext();
+    // the helper bitcode loaded into the current context.
+    HelperLibrary* helperLibrary();
+    // set the data layout of module and run the passes of level on it.
+    // engine is the MCJIT engine the module has been handed to. Full and
+    // Aggressive run the SLP vectorizer, loops adds the loop passes and
+    // the loop vectorizer from OptLevel::Full on, for regions with back
+    // edges.
+    void optimize(LLVMModuleRef module, LLVMExecutionEngineRef engine, OptLevel level, bool loops);
+
+private:
+    CompilePipeline();
+    ~CompilePipeline();
+    CompilePipeline(const CompilePipeline&) = delete;
+    CompilePipeline& operator=(const CompilePipeline&) = delete;
+    void createPasses(LLVMExecutionEngineRef engine);
+    LLVMPassManagerRef createPassManager(LLVMTargetDataRef targetData);
+    void addScalarPasses(LLVMPassManagerRef passes);
+    void addVectorCleanupPasses(LLVMPassManagerRef passes);
+    void addLoopPasses(LLVMPassManagerRef passes);
+    void reset();
+    static void destroy(void*);
+    static void createKey();
+
+    LLVMContextRef m_context;
+    HelperLibrary* m_helperLibrary;
+    LLVMTargetMachineRef m_targetMachine;
+    LLVMPassManagerRef m_fastPasses;
+    LLVMPassManagerRef m_basicPasses;
+    LLVMPassManagerRef m_fullPasses;
+    LLVMPassManagerRef m_aggressivePasses;
+    LLVMPassManagerRef m_loopPasses;
+    char* m_dataLayout;
+    unsigned m_users;
+    unsigned m_compilations;
+};
+}
+#endif /* COMPILEPIPELINE_H */
@@ -0,0 +1,158 @@
+#include <time.h>
+#include <algorithm>
+#include "log.h"
+#include "CompilePolicy.h"
+
+namespace jit {
+// unused budget piles up for at most this many seconds.
+static const double burstSeconds = 1.0;
+// a spent budget is looked at again after at least this long.
+static const double minWaitSeconds = 1e-3;
+// compilations kept for recordSpeedup, past it an arbitrary one is
+// dropped for each new pc.
+static const size_t maxRecords = 4096;
+static const uint32_t largeRegionInsns = 1024;
+static const uint32_t aggressiveRegionInsns = 256;
+static const uint32_t hotExecutions = 1000;
+static const uint32_t veryHotExecutions = 100000;
+static const char* const levelNames[] = { "fast", "basic", "full", "aggressive" };
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + static_cast<double>(t.tv_nsec) / 1e9;
+}
+
+CompilePolicy& CompilePolicy::current()
+{
+    static CompilePolicy policy;
+    return policy;
+}
+
+CompilePolicy::CompilePolicy()
+    : m_budget(0)
+    , m_available(0)
+    , m_lastRefill(now())
+{
+    pthread_mutex_init(&m_lock, nullptr);
+    const double guesses[levelCount] = { 5e-6, 2e-5, 3e-5, 5e-5 };
+    for (int i = 0; i < levelCount; ++i)
+        m_levels[i] = { guesses[i], 0, 0, 0, 0 };
+}
+
+void CompilePolicy::setBudget(double fraction)
+{
+    EMASSERT(fraction >= 0);
+    pthread_mutex_lock(&m_lock);
+    m_budget = fraction;
+    m_available = fraction * burstSeconds;
+    m_lastRefill = now();
+    pthread_mutex_unlock(&m_lock);
+}
+
+void CompilePolicy::refill()
+{
+    double t = now();
+    m_available += (t - m_lastRefill) * m_budget;
+    if (m_available > m_budget * burstSeconds)
+        m_available = m_budget * burstSeconds;
+    m_lastRefill = t;
+}
+
+double CompilePolicy::estimate(OptLevel level, uint32_t guestInsns) const
+{
+    return m_levels[static_cast<int>(level)].m_secondsPerInsn * guestInsns;
+}
+
+bool CompilePolicy::choose(uint32_t guestInsns, uint32_t executions, bool loops, OptLevel* level)
+{
+    OptLevel chosen;
+    if (executions == 0)
+        chosen = OptLevel::Full;
+    else if (guestInsns > largeRegionInsns)
+        chosen = OptLevel::Basic;
+    else if (executions >= veryHotExecutions && (loops || guestInsns <= aggressiveRegionInsns))
+        chosen = OptLevel::Aggressive;
+    else if (executions >= hotExecutions)
+        chosen = OptLevel::Full;
+    else
+        chosen = OptLevel::Basic;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_budget != 0) {
+        refill();
+        if (m_available <= 0) {
+            pthread_mutex_unlock(&m_lock);
+            return false;
+        }
+        while (chosen != OptLevel::Fast && estimate(chosen, guestInsns) > m_available)
+            chosen = static_cast<OptLevel>(static_cast<int>(chosen) - 1);
+    }
+    pthread_mutex_unlock(&m_lock);
+    *level = chosen;
+    return true;
+}
+
+double CompilePolicy::secondsUntilBudget()
+{
+    double seconds = 0;
+    pthread_mutex_lock(&m_lock);
+    if (m_budget != 0) {
+        refill();
+        if (m_available <= 0)
+            seconds = std::max(-m_available / m_budget, minWaitSeconds);
+    }
+    pthread_mutex_unlock(&m_lock);
+    return seconds;
+}
+
+void CompilePolicy::record(uint32_t pc, OptLevel level, double seconds, uint32_t guestInsns, uint32_t executions)
+{
+    pthread_mutex_lock(&m_lock);
+    // may go below zero, the next compilations pay for it.
+    if (m_budget != 0) {
+        refill();
+        m_available -= seconds;
+    }
+    LevelStats& stats = m_levels[static_cast<int>(level)];
+    if (guestInsns)
+        stats.m_secondsPerInsn += (seconds / guestInsns - stats.m_secondsPerInsn) / 4;
+    stats.m_compilations++;
+    stats.m_seconds += seconds;
+    if (m_records.size() >= maxRecords && !m_records.count(pc))
+        m_records.erase(m_records.begin());
+    m_records[pc] = { level, seconds, guestInsns, executions, 0 };
+    pthread_mutex_unlock(&m_lock);
+}
+
+void CompilePolicy::recordSpeedup(uint32_t pc, double speedup)
+{
+    pthread_mutex_lock(&m_lock);
+    auto found = m_records.find(pc);
+    if (found != m_records.end()) {
+        Record& record = found->second;
+        LevelStats& stats = m_levels[static_cast<int>(record.m_level)];
+        if (record.m_speedup != 0) {
+            stats.m_speedups--;
+            stats.m_speedupSum -= record.m_speedup;
+        }
+        record.m_speedup = speedup;
+        stats.m_speedups++;
+        stats.m_speedupSum += speedup;
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void CompilePolicy::dump()
+{
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < levelCount; ++i) {
+        const LevelStats& stats = m_levels[i];
+        double meanSpeedup = stats.m_speedups ? stats.m_speedupSum / stats.m_speedups : 0;
+        LOGE("%s: %u compilations, %lf ms in total, %lf us per guest instruction, mean speedup %lf over %u regions.\n",
+            levelNames[i], stats.m_compilations, stats.m_seconds * 1e3, stats.m_secondsPerInsn * 1e6, meanSpeedup, stats.m_speedups);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+}
@@ -0,0 +1,76 @@
+#ifndef COMPILEPOLICY_H
+#define COMPILEPOLICY_H
+#include <pthread.h>
+#include <stdint.h>
+#include <unordered_map>
+namespace jit {
+
+// How hard the LLVM tier works on a translation. Fast runs mem2reg only
+// and FastISel, the others a pass list of their own, see CompilePipeline,
+// and the codegen opt level of the same number. Full and Aggressive add
+// the SLP vectorizer, regions with loops get the loop passes from Full.
+enum class OptLevel {
+    Fast,
+    Basic,
+    Full,
+    Aggressive,
+};
+
+// Picks the opt level of each LLVM translation from its size and how
+// often the baseline block ran, within a budget of compile seconds per
+// wall clock second shared by all compiling threads. Once the budget is
+// spent, nothing should compile until it refills. Every compilation is
+// recorded with its cost, and the embedder may add the speedup it
+// measured, so the thresholds can be tuned from real runs. The records
+// per pc are capped, the totals per level are not.
+class CompilePolicy {
+public:
+    static CompilePolicy& current();
+
+    // fraction of wall time that may go to compiling, 0 for no limit.
+    void setBudget(double fraction);
+    // executions is the count of the baseline block, 0 if unknown. False
+    // if the budget is spent and the compilation should wait, see
+    // secondsUntilBudget, otherwise level is set.
+    bool choose(uint32_t guestInsns, uint32_t executions, bool loops, OptLevel* level);
+    // how long until choose compiles again, 0 if it does now.
+    double secondsUntilBudget();
+    void record(uint32_t pc, OptLevel level, double seconds, uint32_t guestInsns, uint32_t executions);
+    // speedup of the translation at pc over the baseline block, as the
+    // embedder measured it. Ignored if the record of pc has been dropped.
+    void recordSpeedup(uint32_t pc, double speedup);
+    // log the cost and the speedup of each level.
+    void dump();
+
+private:
+    CompilePolicy();
+    CompilePolicy(const CompilePolicy&) = delete;
+    CompilePolicy& operator=(const CompilePolicy&) = delete;
+    static const int levelCount = 4;
+    void refill();
+    double estimate(OptLevel level, uint32_t guestInsns) const;
+
+    struct Record {
+        OptLevel m_level;
+        double m_seconds;
+        uint32_t m_guestInsns;
+        uint32_t m_executions;
+        double m_speedup;
+    };
+    struct LevelStats {
+        // moving average, seeded with a guess.
+        double m_secondsPerInsn;
+        unsigned m_compilations;
+        double m_seconds;
+        unsigned m_speedups;
+        double m_speedupSum;
+    };
+    pthread_mutex_t m_lock;
+    double m_budget;
+    double m_available;
+    double m_lastRefill;
+    LevelStats m_levels[levelCount];
+    std::unordered_map<uint32_t, Record> m_records;
+};
+}
+#endif /* COMPILEPOLICY_H */
@@ -0,0 +1,187 @@
+#include <string.h>
+#include <time.h>
+#include "log.h"
+#include "CompileQueue.h"
+
+namespace jit {
+
+CompileQueue::CompileQueue(unsigned workerCount, const TranslateDesc& desc, InstallFunc install, void* opaque)
+    : m_desc(desc)
+    , m_install(install)
+    , m_opaque(opaque)
+    , m_compileHook(nullptr)
+    , m_compileHookOpaque(nullptr)
+    , m_stopping(false)
+{
+    m_desc.m_optimal = true;
+    m_desc.m_hotCounter = nullptr;
+    m_desc.m_recording = nullptr;
+    m_desc.m_mayDefer = true;
+    pthread_mutex_init(&m_lock, nullptr);
+    // the workers wait for the budget with timeouts on this clock.
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&m_cond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
+    for (unsigned i = 0; i < workerCount; ++i) {
+        pthread_t thread;
+        if (0 != pthread_create(&thread, nullptr, workerMain, this)) {
+            LOGE("%s: fails to create compile worker.\n", __FUNCTION__);
+            continue;
+        }
+        m_workers.push_back(thread);
+    }
+    EMASSERT(!m_workers.empty());
+}
+
+CompileQueue::~CompileQueue()
+{
+    pthread_mutex_lock(&m_lock);
+    m_stopping = true;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+    for (pthread_t thread : m_workers) {
+        pthread_join(thread, nullptr);
+    }
+    for (auto& pending : m_pending) {
+        delete pending.second;
+    }
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void CompileQueue::enqueue(CPUARMState* env, uint32_t hotness, const RegionBlock* region, size_t regionSize, const OpRecording* recording)
+{
+    uint32_t pc;
+    uint64_t flags;
+    getBlockState(env, &pc, &flags);
+    pthread_mutex_lock(&m_lock);
+    auto found = m_requests.find(RequestKey(pc, flags));
+    if (found != m_requests.end()) {
+        Request* request = found->second;
+        if (!request->m_running && request->m_pendingPos->first < hotness) {
+            m_pending.erase(request->m_pendingPos);
+            request->m_pendingPos = m_pending.insert(std::make_pair(hotness, request));
+            request->m_hotness = hotness;
+        }
+        pthread_mutex_unlock(&m_lock);
+        return;
+    }
+    Request* request = new Request;
+    memcpy(&request->m_cpu, arm_env_get_cpu(env), sizeof(ARMCPU));
+    request->m_pc = pc;
+    request->m_flags = flags;
+    request->m_hotness = hotness;
+    request->m_region.assign(region, region + regionSize);
+    if (recording)
+        request->m_recording = *recording;
+    request->m_running = false;
+    request->m_cancelled = false;
+    request->m_pendingPos = m_pending.insert(std::make_pair(hotness, request));
+    m_requests.insert(std::make_pair(RequestKey(pc, flags), request));
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool CompileQueue::overlaps(const Request& request, uint32_t start, uint32_t end)
+{
+    if (request.m_pc >= start && request.m_pc < end)
+        return true;
+    for (const RegionBlock& block : request.m_region) {
+        if (block.m_pc >= start && block.m_pc < end)
+            return true;
+    }
+    return false;
+}
+
+void CompileQueue::cancel(uint32_t start, uint32_t end)
+{
+    pthread_mutex_lock(&m_lock);
+    for (auto it = m_requests.begin(); it != m_requests.end();) {
+        Request* request = it->second;
+        if (!overlaps(*request, start, end)) {
+            ++it;
+            continue;
+        }
+        if (request->m_running) {
+            // the worker deletes it once the compilation returns.
+            request->m_cancelled = true;
+        }
+        else {
+            m_pending.erase(request->m_pendingPos);
+            delete request;
+        }
+        it = m_requests.erase(it);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void CompileQueue::setCompileHook(CompileHook hook, void* opaque)
+{
+    pthread_mutex_lock(&m_lock);
+    m_compileHook = hook;
+    m_compileHookOpaque = opaque;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void* CompileQueue::workerMain(void* p)
+{
+    static_cast<CompileQueue*>(p)->run();
+    return nullptr;
+}
+
+void CompileQueue::run()
+{
+    pthread_mutex_lock(&m_lock);
+    while (true) {
+        while (!m_stopping && m_pending.empty()) {
+            pthread_cond_wait(&m_cond, &m_lock);
+        }
+        if (m_stopping)
+            break;
+        double wait = CompilePolicy::current().secondsUntilBudget();
+        if (wait > 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            double seconds = deadline.tv_nsec / 1e9 + wait;
+            deadline.tv_sec += static_cast<time_t>(seconds);
+            deadline.tv_nsec = static_cast<long>((seconds - static_cast<time_t>(seconds)) * 1e9);
+            pthread_cond_timedwait(&m_cond, &m_lock, &deadline);
+            continue;
+        }
+        Request* request = m_pending.begin()->second;
+        m_pending.erase(m_pending.begin());
+        request->m_running = true;
+        CompileHook hook = m_compileHook;
+        void* hookOpaque = m_compileHookOpaque;
+        pthread_mutex_unlock(&m_lock);
+
+        if (hook)
+            hook(hookOpaque, request->m_pc, request->m_flags);
+        TranslateDesc desc = m_desc;
+        desc.m_region = request->m_region.data();
+        desc.m_regionSize = request->m_region.size();
+        desc.m_executions = request->m_hotness;
+        if (!request->m_recording.empty())
+            desc.m_recording = &request->m_recording;
+        translate(&request->m_cpu.env, desc);
+
+        pthread_mutex_lock(&m_lock);
+        if (!request->m_cancelled && !desc.m_code) {
+            // the budget ran out since the wait above.
+            request->m_running = false;
+            request->m_pendingPos = m_pending.insert(std::make_pair(request->m_hotness, request));
+            continue;
+        }
+        // a cancelled translation is left to the allocator, nothing
+        // jumps to it.
+        if (!request->m_cancelled) {
+            m_install(m_opaque, request->m_pc, request->m_flags, desc);
+            m_requests.erase(RequestKey(request->m_pc, request->m_flags));
+        }
+        delete request;
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+}
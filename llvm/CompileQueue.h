@@ -0,0 +1,84 @@
+#ifndef COMPILEQUEUE_H
+#define COMPILEQUEUE_H
+#include <pthread.h>
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+#include "TcgGenerator.h"
+namespace jit {
+
+// Runs LLVM tier translations of hot blocks on background threads, so the
+// guest thread that hit the threshold never waits for MCJIT.
+// Requests are keyed by guest pc and tb flags, the block translate would
+// make. Queueing a block that is already pending only raises its priority,
+// queueing one that is being compiled does nothing.
+// While CompilePolicy finds the compile budget spent, the requests stay
+// queued, a request the budget ran out for goes back into the queue.
+class CompileQueue {
+public:
+    // Called on a worker thread with the queue lock held, so it never races
+    // with cancel. desc.m_code is the entry of the new translation; the
+    // embedder publishes it and moves the chain sites of the baseline block
+    // over with retargetDirectJump.
+    typedef void (*InstallFunc)(void* opaque, uint32_t pc, uint64_t flags, const TranslateDesc& desc);
+    // tests only: called on a worker thread without the queue lock, right
+    // before it compiles a request, so a test can cancel it in flight.
+    typedef void (*CompileHook)(void* opaque, uint32_t pc, uint64_t flags);
+
+    // desc supplies the dispatchers and the allocator for every
+    // translation. The allocator is shared by all workers and must be
+    // thread safe.
+    CompileQueue(unsigned workerCount, const TranslateDesc& desc, InstallFunc install, void* opaque);
+    ~CompileQueue();
+    CompileQueue(const CompileQueue&) = delete;
+    CompileQueue& operator=(const CompileQueue&) = delete;
+
+    // queue the block at the pc of env, hotter blocks compile first.
+    // The cpu state is copied, env may change right after the call.
+    // region, if given, is translated as one trace, see formTrace.
+    // recording, if given, is the op stream of the baseline block, which
+    // is copied and replayed instead of decoding the block again.
+    void enqueue(CPUARMState* env, uint32_t hotness, const RegionBlock* region = nullptr, size_t regionSize = 0, const OpRecording* recording = nullptr);
+    // forget requests for guest code in [start, end), translations of it
+    // that are in flight get dropped instead of installed.
+    void cancel(uint32_t start, uint32_t end);
+    // call before the first enqueue.
+    void setCompileHook(CompileHook hook, void* opaque);
+
+private:
+    struct Request;
+    typedef std::multimap<uint32_t, Request*, std::greater<uint32_t> > PendingMap;
+    typedef std::pair<uint32_t, uint64_t> RequestKey;
+    struct Request {
+        ARMCPU m_cpu;
+        uint32_t m_pc;
+        uint64_t m_flags;
+        uint32_t m_hotness;
+        std::vector<RegionBlock> m_region;
+        OpRecording m_recording;
+        bool m_running;
+        bool m_cancelled;
+        PendingMap::iterator m_pendingPos;
+    };
+
+    static bool overlaps(const Request&, uint32_t start, uint32_t end);
+    static void* workerMain(void*);
+    void run();
+
+    TranslateDesc m_desc;
+    InstallFunc m_install;
+    void* m_opaque;
+    CompileHook m_compileHook;
+    void* m_compileHookOpaque;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_cond;
+    bool m_stopping;
+    // pending and running requests, by hotness and by pc and flags.
+    PendingMap m_pending;
+    std::map<RequestKey, Request*> m_requests;
+    std::vector<pthread_t> m_workers;
+};
+}
+#endif /* COMPILEQUEUE_H */
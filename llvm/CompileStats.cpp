@@ -0,0 +1,155 @@
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include <llvm/Pass.h>
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/raw_ostream.h>
+#include "log.h"
+#include "CompileStats.h"
+
+namespace jit {
+static pthread_key_t statsKey;
+static pthread_once_t statsKeyOnce = PTHREAD_ONCE_INIT;
+// guards the thread list, the counters of exited threads and the dump
+// schedule.
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<CompileStats*> threadStats;
+static CompileCounters exitedCounters;
+static double dumpInterval;
+static double lastDump;
+static bool passTiming;
+static const char* const phaseNames[] = { "build", "passes", "codegen", "link" };
+
+double CompileStats::now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + static_cast<double>(t.tv_nsec) / 1e9;
+}
+
+static void addCounters(CompileCounters& to, const CompileCounters& from)
+{
+    to.m_compilations += from.m_compilations;
+    for (int i = 0; i < compilePhaseCount; ++i)
+        to.m_seconds[i] += from.m_seconds[i];
+    to.m_instructions += from.m_instructions;
+    to.m_basicBlocks += from.m_basicBlocks;
+    to.m_patchpoints += from.m_patchpoints;
+    to.m_codeBytes += from.m_codeBytes;
+}
+
+void CompileStats::createKey()
+{
+    pthread_key_create(&statsKey, destroy);
+}
+
+void CompileStats::destroy(void* p)
+{
+    delete static_cast<CompileStats*>(p);
+}
+
+CompileStats& CompileStats::current()
+{
+    pthread_once(&statsKeyOnce, createKey);
+    CompileStats* stats = static_cast<CompileStats*>(pthread_getspecific(statsKey));
+    if (!stats) {
+        stats = new CompileStats;
+        pthread_setspecific(statsKey, stats);
+    }
+    return *stats;
+}
+
+CompileStats::CompileStats()
+    : m_counters()
+{
+    pthread_mutex_init(&m_lock, nullptr);
+    pthread_mutex_lock(&statsLock);
+    threadStats.push_back(this);
+    pthread_mutex_unlock(&statsLock);
+}
+
+CompileStats::~CompileStats()
+{
+    pthread_mutex_lock(&statsLock);
+    threadStats.erase(std::find(threadStats.begin(), threadStats.end(), this));
+    addCounters(exitedCounters, m_counters);
+    pthread_mutex_unlock(&statsLock);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void CompileStats::record(const CompileCounters& counters)
+{
+    // only snapshot contends for the lock.
+    pthread_mutex_lock(&m_lock);
+    addCounters(m_counters, counters);
+    pthread_mutex_unlock(&m_lock);
+
+    bool due = false;
+    pthread_mutex_lock(&statsLock);
+    if (dumpInterval > 0) {
+        double t = now();
+        if (t - lastDump >= dumpInterval) {
+            lastDump = t;
+            due = true;
+        }
+    }
+    pthread_mutex_unlock(&statsLock);
+    if (due)
+        dump();
+}
+
+void CompileStats::snapshot(CompileCounters* total)
+{
+    pthread_mutex_lock(&statsLock);
+    *total = exitedCounters;
+    for (CompileStats* stats : threadStats) {
+        pthread_mutex_lock(&stats->m_lock);
+        addCounters(*total, stats->m_counters);
+        pthread_mutex_unlock(&stats->m_lock);
+    }
+    pthread_mutex_unlock(&statsLock);
+}
+
+void CompileStats::dump()
+{
+    CompileCounters total;
+    snapshot(&total);
+    double n = total.m_compilations ? total.m_compilations : 1;
+    double seconds = 0;
+    for (int i = 0; i < compilePhaseCount; ++i)
+        seconds += total.m_seconds[i];
+    LOGE("llvm: %llu compilations, %lf ms in total.\n", static_cast<unsigned long long>(total.m_compilations), seconds * 1e3);
+    for (int i = 0; i < compilePhaseCount; ++i) {
+        LOGE("%s: %lf ms in total, %lf us per compilation, %.1lf%%.\n",
+            phaseNames[i], total.m_seconds[i] * 1e3, total.m_seconds[i] * 1e6 / n, seconds > 0 ? total.m_seconds[i] * 100 / seconds : 0);
+    }
+    LOGE("per compilation: %lf IR instructions, %lf basic blocks, %lf patchpoints, %lf code bytes.\n",
+        total.m_instructions / n, total.m_basicBlocks / n, total.m_patchpoints / n, total.m_codeBytes / n);
+    pthread_mutex_lock(&statsLock);
+    bool timing = passTiming;
+    pthread_mutex_unlock(&statsLock);
+    // prints and resets the timers, so each dump covers the time since
+    // the previous one.
+    if (timing)
+        llvm::TimerGroup::printAll(llvm::errs());
+}
+
+void CompileStats::setDumpInterval(double seconds)
+{
+    EMASSERT(seconds >= 0);
+    pthread_mutex_lock(&statsLock);
+    dumpInterval = seconds;
+    lastDump = now();
+    pthread_mutex_unlock(&statsLock);
+}
+
+// the pass managers look at the flag when they run, so it applies from
+// the next compilation on.
+void CompileStats::setPassTiming(bool enable)
+{
+    pthread_mutex_lock(&statsLock);
+    passTiming = enable;
+    llvm::TimePassesIsEnabled = enable;
+    pthread_mutex_unlock(&statsLock);
+}
+}
@@ -0,0 +1,63 @@
+#ifndef COMPILESTATS_H
+#define COMPILESTATS_H
+#include <pthread.h>
+#include <stdint.h>
+namespace jit {
+
+// The phases of an LLVM compilation: decoding the guest code into IR
+// through Output, the module passes, MCJIT codegen, and link, which reads
+// the stack maps and patches the exits.
+enum class CompilePhase {
+    Build,
+    Passes,
+    Codegen,
+    Link,
+};
+static const int compilePhaseCount = 4;
+
+struct CompileCounters {
+    uint64_t m_compilations;
+    double m_seconds[compilePhaseCount];
+    // the IR before the passes.
+    uint64_t m_instructions;
+    uint64_t m_basicBlocks;
+    uint64_t m_patchpoints;
+    // code sections with the prologue.
+    uint64_t m_codeBytes;
+};
+
+// Where the compile time of the LLVM tier goes. Each compiling thread adds
+// to its own counters, snapshot sums them over all threads, including
+// those that have exited.
+class CompileStats {
+public:
+    // the counters of the calling thread.
+    static CompileStats& current();
+    // add one compilation, then dump if the dump interval has passed.
+    void record(const CompileCounters& counters);
+
+    static void snapshot(CompileCounters* total);
+    // log the totals and the mean of each counter, and LLVM's pass timers
+    // if pass timing is on.
+    static void dump();
+    // dump at the first compilation after this many seconds since the
+    // last dump, 0, the default, never.
+    static void setDumpInterval(double seconds);
+    // time every LLVM pass, codegen passes included, through -time-passes.
+    static void setPassTiming(bool enable);
+    // seconds on the clock the phases are timed with.
+    static double now();
+
+private:
+    CompileStats();
+    ~CompileStats();
+    CompileStats(const CompileStats&) = delete;
+    CompileStats& operator=(const CompileStats&) = delete;
+    static void destroy(void*);
+    static void createKey();
+
+    pthread_mutex_t m_lock;
+    CompileCounters m_counters;
+};
+}
+#endif /* COMPILESTATS_H */
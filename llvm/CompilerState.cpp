@@ -1,5 +1,6 @@
 #include "LLVMAPI.h"
 #include "CompilerState.h"
+#include "CompilePipeline.h"
 
 namespace jit {
 
@@ -9,14 +10,19 @@ CompilerState::CompilerState(const char* moduleName, const PlatformDesc& desc)
     , m_function(nullptr)
     , m_context(nullptr)
     , m_entryPoint(nullptr)
+    , m_codeSize(0)
     , m_platformDesc(desc)
+    , m_helperLibrary(nullptr)
 {
-    m_context = llvmAPI->ContextCreate();
+    m_context = CompilePipeline::current().acquireContext();
+    m_helperLibrary = CompilePipeline::current().helperLibrary();
     m_module = llvmAPI->ModuleCreateWithNameInContext("test", m_context);
 }
 
 CompilerState::~CompilerState()
 {
-    llvmAPI->ContextDispose(m_context);
+    if (m_module)
+        llvmAPI->DisposeModule(m_module);
+    CompilePipeline::current().releaseContext();
 }
 }
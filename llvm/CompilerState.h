@@ -11,31 +11,36 @@ namespace jit {
 enum class PatchType {
     TcgDirect,
     TcgIndirect,
+    Deopt,
 };
 
 struct PatchDesc {
     PatchType m_type;
     void* m_function;
+    // TcgDirect only: the guest block the exit goes to, if known.
+    bool m_hasTarget;
+    uint32_t m_targetPc;
+    uint64_t m_targetFlags;
 };
 
-typedef std::vector<uint8_t> ByteBuffer;
-typedef std::list<ByteBuffer> BufferList;
 typedef std::list<uint8_t*> ExecutableBufferList;
-typedef std::list<std::string> StringList;
 typedef std::unordered_map<unsigned /* stackmaps id */, PatchDesc> PatchMap;
 
 struct CompilerState {
     ExecutableBufferList m_codeSectionList;
-    BufferList m_dataSectionList;
-    StringList m_dataSectionNames;
-    ByteBuffer* m_stackMapsSection;
+    // in SectionArena::linkSections(), valid until the next compilation
+    // on this thread.
+    const uint8_t* m_stackMapsSection;
     PatchMap m_patchMap;
     LLVMModuleRef m_module;
     LLVMValueRef m_function;
     LLVMContextRef m_context;
     void* m_entryPoint;
+    // bytes of the code sections, prologue included.
+    size_t m_codeSize;
     struct PlatformDesc m_platformDesc;
     class ExecutableMemoryAllocator* m_executableMemAllocator;
+    class HelperLibrary* m_helperLibrary;
     CompilerState(const char* moduleName, const PlatformDesc& desc);
     ~CompilerState();
     CompilerState(const CompilerState&) = delete;
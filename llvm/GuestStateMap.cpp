@@ -0,0 +1,101 @@
+#include "GuestStateMap.h"
+#include "log.h"
+
+namespace jit {
+
+static void writeULEB(std::vector<uint8_t>& out, uint32_t val)
+{
+    do {
+        uint8_t byte = val & 0x7f;
+        val >>= 7;
+        if (val)
+            byte |= 0x80;
+        out.push_back(byte);
+    } while (val);
+}
+
+static uint32_t readULEB(const uint8_t*& p)
+{
+    uint32_t result = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do {
+        byte = *p++;
+        result |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return result;
+}
+
+GuestStateMapEncoder::GuestStateMapEncoder(uint32_t startPc)
+    : m_startPc(startPc)
+    , m_lastHostOffset(0)
+    , m_lastPc(startPc)
+    , m_lastCondexec(0)
+    , m_count(0)
+{
+}
+
+void GuestStateMapEncoder::append(uint32_t hostOffset, uint32_t pc, uint8_t condexec)
+{
+    EMASSERT(hostOffset >= m_lastHostOffset);
+    EMASSERT(pc >= m_lastPc);
+    uint32_t changed = condexec != m_lastCondexec;
+    writeULEB(m_entries, hostOffset - m_lastHostOffset);
+    writeULEB(m_entries, ((pc - m_lastPc) << 1) | changed);
+    if (changed)
+        m_entries.push_back(condexec);
+    m_lastHostOffset = hostOffset;
+    m_lastPc = pc;
+    m_lastCondexec = condexec;
+    m_count++;
+}
+
+const std::vector<uint8_t>& GuestStateMapEncoder::finish()
+{
+    m_result.clear();
+    writeULEB(m_result, m_count);
+    writeULEB(m_result, m_startPc);
+    m_result.insert(m_result.end(), m_entries.begin(), m_entries.end());
+    return m_result;
+}
+
+bool decodeGuestState(const uint8_t* map, uint32_t hostOffset, GuestState* state)
+{
+    const uint8_t* p = map;
+    uint32_t count = readULEB(p);
+    uint32_t hostOff = 0;
+    uint32_t pc = readULEB(p);
+    uint8_t condexec = 0;
+    bool found = false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        hostOff += readULEB(p);
+        if (hostOff > hostOffset)
+            break;
+        uint32_t pcDelta = readULEB(p);
+        pc += pcDelta >> 1;
+        if (pcDelta & 1)
+            condexec = *p++;
+        found = true;
+    }
+    if (found) {
+        state->m_pc = pc;
+        state->m_condexec = condexec;
+    }
+    return found;
+}
+
+size_t guestStateMapSize(const uint8_t* map)
+{
+    const uint8_t* p = map;
+    uint32_t count = readULEB(p);
+    readULEB(p);
+    for (uint32_t i = 0; i < count; ++i) {
+        readULEB(p);
+        if (readULEB(p) & 1)
+            p++;
+    }
+    return p - map;
+}
+}
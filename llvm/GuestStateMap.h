@@ -0,0 +1,46 @@
+#ifndef GUESTSTATEMAP_H
+#define GUESTSTATEMAP_H
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+namespace jit {
+
+// Compact host pc -> guest state table stored right behind the code of a
+// translation. It plays the role of search_pc and gen_opc_condexec_bits
+// upstream, without retranslating the block.
+//
+// Layout (all numbers are ULEB128):
+//   count, start pc
+//   count * { host offset delta, (pc delta << 1) | condexec changed, [condexec byte] }
+// The host offset of an entry is where the code of that guest instruction
+// starts. The condexec byte uses the CPUARMState::condexec_bits encoding.
+struct GuestState {
+    uint32_t m_pc;
+    uint8_t m_condexec;
+};
+
+class GuestStateMapEncoder {
+public:
+    explicit GuestStateMapEncoder(uint32_t startPc);
+    void append(uint32_t hostOffset, uint32_t pc, uint8_t condexec);
+    // the encoded table, valid until the next append.
+    const std::vector<uint8_t>& finish();
+
+private:
+    std::vector<uint8_t> m_entries;
+    std::vector<uint8_t> m_result;
+    uint32_t m_startPc;
+    uint32_t m_lastHostOffset;
+    uint32_t m_lastPc;
+    uint8_t m_lastCondexec;
+    uint32_t m_count;
+};
+
+// Find the guest instruction whose host code contains hostOffset.
+// For a return address pass the return address minus one.
+// Returns false if hostOffset is before the first instruction.
+bool decodeGuestState(const uint8_t* map, uint32_t hostOffset, GuestState* state);
+// Number of bytes the table at map occupies.
+size_t guestStateMapSize(const uint8_t* map);
+}
+#endif /* GUESTSTATEMAP_H */
@@ -0,0 +1,136 @@
+#include <string>
+#include <llvm/ADT/Triple.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include "LLVMAPI.h"
+#include "HelperLibrary.h"
+#include "QEMUDisasContext.h"
+#include "log.h"
+
+// generated by helperbitcode.py, empty if the build has no clang.
+extern "C" {
+extern const unsigned char helperBitcode[];
+extern const size_t helperBitcodeSize;
+}
+
+namespace jit {
+static const unsigned maxInlineInstructions = 48;
+
+HelperLibrary::HelperLibrary(LLVMContextRef context)
+    : m_module(nullptr)
+{
+    if (!helperBitcodeSize)
+        return;
+    LLVMMemoryBufferRef buffer = llvmAPI->CreateMemoryBufferWithMemoryRange(
+        reinterpret_cast<const char*>(helperBitcode), helperBitcodeSize, "helpers", false);
+    char* error = nullptr;
+    if (llvmAPI->ParseBitcodeInContext(context, buffer, &m_module, &error)) {
+        LOGE("%s: fails to parse the helper bitcode: %s.\n", __FUNCTION__, error);
+        llvmAPI->DisposeMessage(error);
+        m_module = nullptr;
+    }
+    llvmAPI->DisposeMemoryBuffer(buffer);
+    if (!m_module)
+        return;
+    // the modules of the LLVM tier have no triple, MCJIT emits for the
+    // process. helpers built for another width would not fit them.
+    llvm::Triple helperTriple(llvm::unwrap(m_module)->getTargetTriple());
+    llvm::Triple jitTriple(llvm::sys::getProcessTriple());
+    if (helperTriple.getArch() != jitTriple.getArch()) {
+        LOGE("FATAL: helper bitcode is for %s, the JIT emits for %s.\n", helperTriple.str().c_str(), jitTriple.str().c_str());
+        EMASSERT(false);
+        llvmAPI->DisposeModule(m_module);
+        m_module = nullptr;
+    }
+}
+
+HelperLibrary::~HelperLibrary()
+{
+    if (m_module)
+        llvmAPI->DisposeModule(m_module);
+}
+
+// anything but intrinsics a helper references would have to be resolved in
+// the module too, so only small leaf helpers qualify.
+static bool worthInlining(const llvm::Function& helper)
+{
+    if (helper.isDeclaration() || helper.isVarArg())
+        return false;
+    unsigned count = 0;
+    for (const llvm::BasicBlock& bb : helper) {
+        for (const llvm::Instruction& inst : bb) {
+            if (++count > maxInlineInstructions)
+                return false;
+            const llvm::CallInst* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+            if (call && !call->getCalledFunction())
+                return false;
+            for (unsigned i = 0; i < inst.getNumOperands(); ++i) {
+                const llvm::Value* operand = inst.getOperand(i);
+                if (const llvm::Function* callee = llvm::dyn_cast<llvm::Function>(operand)) {
+                    if (!callee->isIntrinsic())
+                        return false;
+                }
+                else if (llvm::isa<llvm::GlobalValue>(operand) || llvm::isa<llvm::ConstantExpr>(operand)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+LLVMValueRef HelperLibrary::inlinable(void* func)
+{
+    auto found = m_inlinable.find(func);
+    if (found != m_inlinable.end())
+        return found->second;
+    llvm::Function* helper = nullptr;
+    const char* name = qemu::helperName(func);
+    if (m_module && name) {
+        helper = llvm::unwrap(m_module)->getFunction(std::string("helper_") + name);
+        if (helper && !worthInlining(*helper))
+            helper = nullptr;
+    }
+    LLVMValueRef result = llvm::wrap(helper);
+    m_inlinable.insert(std::make_pair(func, result));
+    return result;
+}
+
+LLVMValueRef HelperLibrary::cloneInto(LLVMModuleRef module, void* func)
+{
+    llvm::Function* helper = llvm::unwrap<llvm::Function>(inlinable(func));
+    if (!helper)
+        return nullptr;
+    llvm::Module* dest = llvm::unwrap(module);
+    // one copy per module, however many calls the translation makes.
+    if (llvm::Function* existing = dest->getFunction(helper->getName()))
+        return llvm::wrap(existing);
+
+    llvm::Function* clone = llvm::Function::Create(helper->getFunctionType(),
+        llvm::GlobalValue::InternalLinkage, helper->getName(), dest);
+    llvm::ValueToValueMapTy map;
+    llvm::Function::arg_iterator cloneArg = clone->arg_begin();
+    for (llvm::Function::const_arg_iterator arg = helper->arg_begin(); arg != helper->arg_end(); ++arg, ++cloneArg) {
+        cloneArg->setName(arg->getName());
+        map[&*arg] = &*cloneArg;
+    }
+    // intrinsics are declared again in the destination module.
+    for (const llvm::BasicBlock& bb : *helper) {
+        for (const llvm::Instruction& inst : bb) {
+            const llvm::CallInst* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+            if (!call)
+                continue;
+            llvm::Function* callee = call->getCalledFunction();
+            map[callee] = dest->getOrInsertFunction(callee->getName(), callee->getFunctionType(), callee->getAttributes());
+        }
+    }
+    llvm::SmallVector<llvm::ReturnInst*, 4> returns;
+    llvm::CloneFunctionInto(clone, helper, map, true, returns);
+    clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+    clone->addFnAttr(llvm::Attribute::AlwaysInline);
+    return llvm::wrap(clone);
+}
+}
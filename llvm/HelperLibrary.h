@@ -0,0 +1,30 @@
+#ifndef HELPERLIBRARY_H
+#define HELPERLIBRARY_H
+#include <unordered_map>
+#include "LLVMHeaders.h"
+namespace jit {
+
+// The qemu helpers, compiled to bitcode at build time by helperbitcode.py
+// and loaded into one context. Small helpers that call nothing but
+// intrinsics are cloned into the modules of the LLVM tier, so the inliner
+// sees their bodies instead of an opaque call.
+class HelperLibrary {
+public:
+    explicit HelperLibrary(LLVMContextRef context);
+    ~HelperLibrary();
+    HelperLibrary(const HelperLibrary&) = delete;
+    HelperLibrary& operator=(const HelperLibrary&) = delete;
+
+    // an internal copy of the helper at func in module, null if the helper
+    // is not in the library or not worth inlining.
+    LLVMValueRef cloneInto(LLVMModuleRef module, void* func);
+
+private:
+    LLVMValueRef inlinable(void* func);
+
+    LLVMModuleRef m_module;
+    // helper address to its definition in m_module, null if not inlinable.
+    std::unordered_map<void*, LLVMValueRef> m_inlinable;
+};
+}
+#endif /* HELPERLIBRARY_H */
@@ -23,6 +23,8 @@
     macro(subWithOverflow32, "llvm.ssub.with.overflow.i32", functionType(structType(m_context, int32, boolean), int32, int32)) \
     macro(subWithOverflow64, "llvm.ssub.with.overflow.i64", functionType(structType(m_context, int64, boolean), int64, int64)) \
     macro(trap, "llvm.trap", functionType(voidType)) \
+    macro(uaddWithOverflow32, "llvm.uadd.with.overflow.i32", functionType(structType(m_context, int32, boolean), int32, int32)) \
+    macro(usubWithOverflow32, "llvm.usub.with.overflow.i32", functionType(structType(m_context, int32, boolean), int32, int32)) \
     macro(x86SSE2CvtTSD2SI, "llvm.x86.sse2.cvttsd2si", functionType(int32, vectorType(doubleType, 2)))
 namespace jit {
 class IntrinsicRepository : public CommonValues {
@@ -517,6 +517,8 @@
     macro(LLVMBool, TargetHasJIT, (LLVMTargetRef T)) \
     macro(LLVMBool, TargetHasTargetMachine, (LLVMTargetRef T)) \
     macro(LLVMBool, TargetHasAsmBackend, (LLVMTargetRef T)) \
+    macro(LLVMBool, GetTargetFromTriple, (const char* Triple, LLVMTargetRef *T, char **ErrorMessage)) \
+    macro(LLVMTargetMachineRef, CreateTargetMachine, (LLVMTargetRef T, const char *Triple, const char *CPU, const char *Features, LLVMCodeGenOptLevel Level, LLVMRelocMode Reloc, LLVMCodeModel CodeModel)) \
     macro(void, DisposeTargetMachine, (LLVMTargetMachineRef T)) \
     macro(LLVMTargetRef, GetTargetMachineTarget, (LLVMTargetMachineRef T)) \
     macro(char *, GetTargetMachineTriple, (LLVMTargetMachineRef T)) \
@@ -617,6 +619,8 @@
     macro(void, AddEarlyCSEPass, (LLVMPassManagerRef PM)) \
     macro(void, AddLowerExpectIntrinsicPass, (LLVMPassManagerRef PM)) \
     macro(void, AddTypeBasedAliasAnalysisPass, (LLVMPassManagerRef PM)) \
-    macro(void, AddBasicAliasAnalysisPass, (LLVMPassManagerRef PM))
+    macro(void, AddBasicAliasAnalysisPass, (LLVMPassManagerRef PM)) \
+    macro(void, AddLoopVectorizePass, (LLVMPassManagerRef PM)) \
+    macro(void, AddSLPVectorizePass, (LLVMPassManagerRef PM))
 
 #endif /* LLVMAPIFUNCTIONS_H */
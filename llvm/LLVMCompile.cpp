@@ -2,8 +2,11 @@
 #include "log.h"
 #include "LLVMAPI.h"
 #include "CompilerState.h"
+#include "CompilePipeline.h"
+#include "CompileStats.h"
 #include "ExecutableMemoryAllocator.h"
 #include "LLVMDisasContext.h"
+#include "SectionArena.h"
 #define SECTION_NAME_PREFIX "."
 #define SECTION_NAME(NAME) (SECTION_NAME_PREFIX NAME)
 
@@ -24,6 +27,7 @@ static uint8_t* mmAllocateCodeSection(
     size += additionSize;
     uint8_t* buffer = static_cast<uint8_t*>(state.m_executableMemAllocator->allocate(size, alignment));
     state.m_codeSectionList.push_back(buffer);
+    state.m_codeSize += size;
 
     return const_cast<uint8_t*>(buffer + additionSize);
 }
@@ -34,17 +38,13 @@ static uint8_t* mmAllocateDataSection(
 {
     State& state = *static_cast<State*>(opaqueState);
 
-    state.m_dataSectionList.push_back(jit::ByteBuffer());
-    state.m_dataSectionNames.push_back(sectionName);
-
-    jit::ByteBuffer& bb(state.m_dataSectionList.back());
-    bb.resize(size);
-    EMASSERT((reinterpret_cast<uintptr_t>(bb.data()) & (alignment - 1)) == 0);
+    // only link reads the stack maps, the code may read anything else.
     if (!strcmp(sectionName, SECTION_NAME("llvm_stackmaps"))) {
-        state.m_stackMapsSection = &bb;
+        uint8_t* section = SectionArena::linkSections().allocate(size, alignment);
+        state.m_stackMapsSection = section;
+        return section;
     }
-
-    return const_cast<uint8_t*>(bb.data());
+    return SectionArena::codeSections().allocate(size, alignment);
 }
 
 static LLVMBool mmApplyPermissions(void*, char**)
@@ -58,12 +58,19 @@ static void mmDestroy(void*)
 
 void LLVMDisasContext::compile()
 {
+    finalizePromotion();
+    countIR();
+    double buildEnd = CompileStats::now();
+    m_counters.m_seconds[static_cast<int>(CompilePhase::Build)] = buildEnd - m_buildStart;
+    m_counters.m_patchpoints = state()->m_patchMap.size();
+    SectionArena::linkSections().reset();
 #ifdef ENABLE_DUMP_LLVM_MODULE
     dumpModule(state()->m_module);
 #endif // ENABLE_DUMP_LLVM_MODULE
     LLVMMCJITCompilerOptions options;
     llvmAPI->InitializeMCJITCompilerOptions(&options, sizeof(options));
-    options.OptLevel = 2;
+    options.OptLevel = static_cast<unsigned>(m_optLevel);
+    options.EnableFastISel = m_optLevel == OptLevel::Fast;
     LLVMExecutionEngineRef engine;
     char* error = 0;
     options.MCJMM = llvmAPI->CreateSimpleMCJITMemoryManager(
@@ -73,41 +80,38 @@ void LLVMDisasContext::compile()
         LOGE("FATAL: Could not create LLVM execution engine: %s", error);
         EMASSERT(false);
     }
-    LLVMModuleRef module = state()->m_module;
-    LLVMPassManagerRef functionPasses = 0;
-    LLVMPassManagerRef modulePasses;
-    LLVMTargetDataRef targetData = llvmAPI->GetExecutionEngineTargetData(engine);
-    char* stringRepOfTargetData = llvmAPI->CopyStringRepOfTargetData(targetData);
-    llvmAPI->SetDataLayout(module, stringRepOfTargetData);
-    free(stringRepOfTargetData);
-
-    modulePasses = llvmAPI->CreatePassManager();
-    llvmAPI->AddTargetData(targetData, modulePasses);
-    llvmAPI->AddAnalysisPasses(llvmAPI->GetExecutionEngineTargetMachine(engine), modulePasses);
-    llvmAPI->AddPromoteMemoryToRegisterPass(modulePasses);
-    llvmAPI->AddGlobalOptimizerPass(modulePasses);
-    llvmAPI->AddFunctionInliningPass(modulePasses);
-    llvmAPI->AddPruneEHPass(modulePasses);
-    llvmAPI->AddGlobalDCEPass(modulePasses);
-    llvmAPI->AddConstantPropagationPass(modulePasses);
-    llvmAPI->AddAggressiveDCEPass(modulePasses);
-    llvmAPI->AddInstructionCombiningPass(modulePasses);
-    // BEGIN - DO NOT CHANGE THE ORDER OF THE ALIAS ANALYSIS PASSES
-    llvmAPI->AddTypeBasedAliasAnalysisPass(modulePasses);
-    llvmAPI->AddBasicAliasAnalysisPass(modulePasses);
-    // END - DO NOT CHANGE THE ORDER OF THE ALIAS ANALYSIS PASSES
-    llvmAPI->AddGVNPass(modulePasses);
-    llvmAPI->AddCFGSimplificationPass(modulePasses);
-    llvmAPI->AddDeadStoreEliminationPass(modulePasses);
-
-    llvmAPI->AddLowerSwitchPass(modulePasses);
-
-    llvmAPI->RunPassManager(modulePasses, module);
+    double passesStart = CompileStats::now();
+    CompilePipeline::current().optimize(state()->m_module, engine, m_optLevel, m_hasLoops);
+    double passesEnd = CompileStats::now();
+    countEnvLoads();
+    // MCJIT generates the code here.
     state()->m_entryPoint = reinterpret_cast<void*>(llvmAPI->GetPointerToGlobal(engine, state()->m_function));
 
-    if (functionPasses)
-        llvmAPI->DisposePassManager(functionPasses);
-    llvmAPI->DisposePassManager(modulePasses);
+    // the engine owns the module from here on.
     llvmAPI->DisposeExecutionEngine(engine);
+    state()->m_module = nullptr;
+    state()->m_function = nullptr;
+    m_counters.m_seconds[static_cast<int>(CompilePhase::Passes)] = passesEnd - passesStart;
+    m_counters.m_seconds[static_cast<int>(CompilePhase::Codegen)] = (passesStart - buildEnd) + (CompileStats::now() - passesEnd);
+}
+
+void LLVMDisasContext::countIR()
+{
+    for (LBasicBlock bb = llvmAPI->GetFirstBasicBlock(state()->m_function); bb; bb = llvmAPI->GetNextBasicBlock(bb)) {
+        m_counters.m_basicBlocks++;
+        for (LValue inst = llvmAPI->GetFirstInstruction(bb); inst; inst = llvmAPI->GetNextInstruction(inst))
+            m_counters.m_instructions++;
+    }
+}
+
+void LLVMDisasContext::countEnvLoads()
+{
+    m_envLoads = 0;
+    for (LBasicBlock bb = llvmAPI->GetFirstBasicBlock(state()->m_function); bb; bb = llvmAPI->GetNextBasicBlock(bb)) {
+        for (LValue inst = llvmAPI->GetFirstInstruction(bb); inst; inst = llvmAPI->GetNextInstruction(inst)) {
+            if (llvmAPI->GetInstructionOpcode(inst) == LLVMLoad && output()->isEnvAccess(inst))
+                m_envLoads++;
+        }
+    }
 }
 }
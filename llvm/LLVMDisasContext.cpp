@@ -5,7 +5,11 @@
 #include "CompilerState.h"
 #include "IntrinsicRepository.h"
 #include "InitializeLLVM.h"
+#include "NeonLowering.h"
+#include "PinnedRegisters.h"
+#include "VfpLowering.h"
 #include "Output.h"
+#include "QEMUDisasContext.h"
 #include "cpu.h"
 #include "tb.h"
 #include "log.h"
@@ -43,12 +47,20 @@ struct TcgSizeTrait<TCGv_i64> {
 };
 namespace jit {
 
+// see LLVMLink.cpp for the sequences patched into the prologue and the
+// exits.
 static PlatformDesc g_desc = {
     sizeof(CPUARMState),
     static_cast<size_t>(offsetof(CPUARMState, regs[15])), /* offset of pc */
-    2, /* prologue size */
+#if defined(__x86_64__)
+    pinnedLoadsSize + 3, /* prologue size */
+    16, /* assist size */
+    16 + pinnedMovesSize + 7, /* tcg size, with room to align the jump */
+#else
+    pinnedLoadsSize + 2, /* prologue size */
     10, /* assist size */
-    10, /* tcg size */
+    10 + pinnedMovesSize + 3, /* tcg size, with room to align the jump */
+#endif
 };
 static pthread_once_t initLLVMOnce = PTHREAD_ONCE_INIT;
 
@@ -56,8 +68,28 @@ LLVMDisasContext::LLVMDisasContext(ExecutableMemoryAllocator* executableMemAlloc
     : m_currentBufferPointer(nullptr)
     , m_currentBufferEnd(nullptr)
     , m_labelCount(0)
+    , m_discoverBlocks(false)
+    , m_nextBlockToTranslate(0)
+    , m_hasLoops(false)
+    , m_optLevel(OptLevel::Full)
+    , m_promote(false)
+    , m_body(nullptr)
+    , m_env(nullptr)
+    , m_envLoads(0)
+    , m_dispDeopt(nullptr)
+    , m_codeStart(0)
+    , m_codeEnd(0)
+    , m_insnPc(0)
+    , m_insnCondexec(0)
+    , m_indirectTargetCount(0)
+    , m_thumb(false)
+    , m_blockFlags(0)
+    , m_chainLookup(nullptr)
+    , m_chainOpaque(nullptr)
     , m_dispDirect(dispDirect)
     , m_dispIndirect(dispIndirect)
+    , m_counters()
+    , m_buildStart(CompileStats::now())
 {
     pthread_once(&initLLVMOnce, initLLVM);
     m_state.reset(new CompilerState("qemu", g_desc));
@@ -128,7 +160,9 @@ LValue LLVMDisasContext::unwrap(TCGType v)
 {
     EMASSERT(v->m_value != nullptr);
     if (v->m_isMem) {
-        return output()->buildLoad(v->m_value);
+        LValue load = output()->buildLoad(v->m_value);
+        output()->tagEnvAccess(load);
+        return load;
     }
     else {
         return v->m_value;
@@ -143,7 +177,7 @@ void LLVMDisasContext::storeToTCG(LValue v, TCGType ret)
     }
     else {
         EMASSERT(ret->m_value != nullptr);
-        output()->buildStore(v, ret->m_value);
+        output()->tagEnvAccess(output()->buildStore(v, ret->m_value));
     }
 }
 
@@ -191,6 +225,11 @@ LValue LLVMDisasContext::tcgPointerToLLVM(TCGMemOp op, TCGv pointer)
     opInt &= ~MO_SIGN;
     LValue pointerBeforeCast = unwrap(pointer);
     EMASSERT(jit::typeOf(pointerBeforeCast) != output()->repo().ref32);
+#if defined(__x86_64__)
+    // guest addresses are zero extended to 64 bits, see gen_aa32_ld.
+    if (GUEST_BASE)
+        pointerBeforeCast = output()->buildAdd(pointerBeforeCast, output()->constInt64(GUEST_BASE));
+#endif
 
     switch (opInt) {
     case MO_8:
@@ -242,7 +281,9 @@ void LLVMDisasContext::gen_set_label(int n)
 
 TCGv_i64 LLVMDisasContext::global_mem_new_i64(int reg, intptr_t offset, const char* name)
 {
-    LValue v = output()->buildArgGEP(offset / sizeof(target_ulong));
+    if (m_promote)
+        return wrapMem<TCGv_i64>(m_slots[promotedSlot(offset, 64, true)].m_alloca);
+    LValue v = output()->buildArgGEP(offset / sizeof(uint32_t));
     LValue v2 = output()->buildPointerCast(v, output()->repo().ref64);
 
     return wrapMem<TCGv_i64>(v2);
@@ -250,7 +291,9 @@ TCGv_i64 LLVMDisasContext::global_mem_new_i64(int reg, intptr_t offset, const ch
 
 TCGv_i32 LLVMDisasContext::global_mem_new_i32(int reg, intptr_t offset, const char* name)
 {
-    LValue v = output()->buildArgGEP(offset / sizeof(target_ulong));
+    if (m_promote)
+        return wrapMem<TCGv_i32>(m_slots[promotedSlot(offset, 32, true)].m_alloca);
+    LValue v = output()->buildArgGEP(offset / sizeof(uint32_t));
     LValue v2 = output()->buildPointerCast(v, output()->repo().ref32);
 
     return wrapMem<TCGv_i32>(v2);
@@ -259,7 +302,8 @@ TCGv_i32 LLVMDisasContext::global_mem_new_i32(int reg, intptr_t offset, const ch
 TCGv_ptr LLVMDisasContext::global_reg_new_ptr(int reg, const char* name)
 {
     LValue v = output()->buildArgGEP(0);
-    return wrap<TCGv_ptr>(v);
+    m_env = wrap<TCGv_ptr>(v);
+    return m_env;
 }
 
 TCGv_i32 LLVMDisasContext::const_i32(int32_t val)
@@ -298,6 +342,61 @@ void LLVMDisasContext::gen_add2_i32(TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
     extract_64_32(t0123, thirtytwo, rl, rh);
 }
 
+void LLVMDisasContext::buildAddWithFlags(LValue a, LValue b, LValue carryIn, LValue* sum, LValue* carryOut, LValue* overflow)
+{
+    LValue u = output()->buildCall(output()->repo().uaddWithOverflow32Intrinsic(), a, b);
+    LValue s = output()->buildCall(output()->repo().addWithOverflow32Intrinsic(), a, b);
+    *sum = output()->buildExtractValue(u, 0);
+    *carryOut = output()->buildExtractValue(u, 1);
+    *overflow = output()->buildExtractValue(s, 1);
+    if (!carryIn)
+        return;
+    // a + b and the carry cannot both carry out, and two signed overflows
+    // cancel out.
+    LValue u2 = output()->buildCall(output()->repo().uaddWithOverflow32Intrinsic(), *sum, carryIn);
+    LValue s2 = output()->buildCall(output()->repo().addWithOverflow32Intrinsic(), *sum, carryIn);
+    *sum = output()->buildExtractValue(u2, 0);
+    *carryOut = output()->buildOr(*carryOut, output()->buildExtractValue(u2, 1));
+    *overflow = output()->buildXor(*overflow, output()->buildExtractValue(s2, 1));
+}
+
+void LLVMDisasContext::storeFlags(LValue result, LValue carryOut, LValue overflow, TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf, TCGv_i32 vf, TCGv_i32 dest)
+{
+    LValue carry32 = output()->buildCast(LLVMZExt, carryOut, output()->repo().int32);
+    LValue overflow32 = output()->buildShl(output()->buildCast(LLVMZExt, overflow, output()->repo().int32), output()->constInt32(31));
+    storeToTCG(result, nf);
+    storeToTCG(result, zf);
+    storeToTCG(carry32, cf);
+    storeToTCG(overflow32, vf);
+    storeToTCG(result, dest);
+}
+
+void LLVMDisasContext::gen_add_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+    TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry)
+{
+    LValue result, carryOut, overflow;
+    buildAddWithFlags(unwrap(t0), unwrap(t1), carry ? unwrap(cf) : nullptr, &result, &carryOut, &overflow);
+    storeFlags(result, carryOut, overflow, nf, zf, cf, vf, dest);
+}
+
+void LLVMDisasContext::gen_sub_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+    TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry)
+{
+    LValue result, carryOut, overflow;
+    if (carry) {
+        buildAddWithFlags(unwrap(t0), output()->buildNot(unwrap(t1)), unwrap(cf), &result, &carryOut, &overflow);
+    }
+    else {
+        // ARM sets C when there is no borrow.
+        LValue u = output()->buildCall(output()->repo().usubWithOverflow32Intrinsic(), unwrap(t0), unwrap(t1));
+        LValue s = output()->buildCall(output()->repo().subWithOverflow32Intrinsic(), unwrap(t0), unwrap(t1));
+        result = output()->buildExtractValue(u, 0);
+        carryOut = output()->buildNot(output()->buildExtractValue(u, 1));
+        overflow = output()->buildExtractValue(s, 1);
+    }
+    storeFlags(result, carryOut, overflow, nf, zf, cf, vf, dest);
+}
+
 void LLVMDisasContext::gen_add_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2)
 {
     LValue v = output()->buildAdd(unwrap(arg1), unwrap(arg2));
@@ -324,11 +423,15 @@ void LLVMDisasContext::gen_addi_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2)
 
 void LLVMDisasContext::gen_addi_ptr(TCGv_ptr ret, TCGv_ptr arg1, int32_t arg2)
 {
-    LValue constant = output()->constInt32(arg2);
+    // sign extended to the pointer width, the add is done in intPtr.
+    LValue constant = jit::constInt(output()->repo().intPtr, arg2, SignExtend);
     LValue arg1V = unwrap(arg1);
     arg1V = output()->buildCast(LLVMPtrToInt, arg1V, output()->repo().intPtr);
     LValue retVal = output()->buildAdd(arg1V, constant);
-    storeToTCG(output()->buildCast(LLVMIntToPtr, retVal, output()->repo().ref8), ret);
+    retVal = output()->buildCast(LLVMIntToPtr, retVal, output()->repo().ref8);
+    if (arg1 == m_env && arg2 == static_cast<int32_t>(offsetof(CPUARMState, vfp.fp_status)))
+        m_vfpStatusPointers.insert(retVal);
+    storeToTCG(retVal, ret);
 }
 
 void LLVMDisasContext::gen_addi_i64(TCGv_i64 ret, TCGv_i64 arg1, int64_t arg2)
@@ -456,10 +559,105 @@ void LLVMDisasContext::gen_mov_i32(TCGv_i32 ret, TCGv_i32 arg)
 
 void LLVMDisasContext::gen_exit_tb(int direct)
 {
-    if (direct)
-        output()->buildTcgDirectPatch();
-    else
-        output()->buildTcgIndirectPatch();
+    if (direct) {
+        // translate.c knows the target, but not the IT state there.
+        buildDirectExit(false, 0, false);
+        return;
+    }
+    LValue exit = output()->buildTcgIndirectPatch();
+    recordSync(exit, SyncStoreGlobals | SyncStoreEnv);
+}
+
+// a direct exit to pc in the thumb state given and outside an IT block,
+// if hasTarget, which link may chain to the translation there.
+void LLVMDisasContext::buildDirectExit(bool hasTarget, target_ulong pc, bool thumb)
+{
+    LValue pinned[pinnedRegisterCount];
+    loadPinnedRegisters(pinned);
+    uint64_t flags = m_blockFlags & ~static_cast<uint64_t>(ARM_TBFLAG_THUMB_MASK | ARM_TBFLAG_CONDEXEC_MASK);
+    if (thumb)
+        flags |= ARM_TBFLAG_THUMB_MASK;
+    LValue exit = output()->buildTcgDirectPatch(pinned, hasTarget, pc, flags);
+    recordSync(exit, SyncStoreGlobals | SyncStoreEnv);
+}
+
+// what a direct exit leaves in the pinned host registers, from the slots
+// or env.
+void LLVMDisasContext::loadPinnedRegisters(LValue* values)
+{
+    for (size_t i = 0; i < pinnedRegisterCount; ++i) {
+        intptr_t offset = offsetof(CPUARMState, regs) + pinnedGuestRegisters[i] * sizeof(uint32_t);
+        values[i] = unwrap(global_mem_new_i32(0, offset, nullptr));
+    }
+}
+
+void LLVMDisasContext::gen_goto_tb(target_ulong dest, bool link)
+{
+    // a function region leaves at calls.
+    if (link && m_discoverBlocks) {
+        buildDirectExit(true, dest, m_thumb);
+        return;
+    }
+    auto found = m_regionBlocks.find(dest);
+    if (found == m_regionBlocks.end() && m_discoverBlocks && m_regionBlocks.size() < maxFunctionBlocks) {
+        found = m_regionBlocks.insert(std::make_pair(dest, output()->appendBasicBlock("region"))).first;
+        m_blocksToTranslate.push_back(dest);
+    }
+    if (found == m_regionBlocks.end()) {
+        buildDirectExit(true, dest, m_thumb);
+        return;
+    }
+    // every cycle has an edge to a block translated before.
+    if (m_begunBlocks.count(dest))
+        m_hasLoops = true;
+    output()->buildBr(found->second);
+    output()->setCurrentBlockTerminated();
+}
+
+// compare the guest pc against the dominant targets of the block. A hit
+// branches to the target when it is in the region and takes a direct exit
+// the embedder chains otherwise, so a hot virtual call or jump table stays
+// out of the dispatcher. Only exits outside an IT block are compared, the
+// translations of the targets assume none.
+void LLVMDisasContext::gen_exit_indirect()
+{
+    if (m_indirectTargetCount) {
+        TCGv_i32 pc = temp_new_i32();
+        TCGv_i32 thumb = temp_new_i32();
+        TCGv_i32 condexec = temp_new_i32();
+        gen_ld_i32(pc, m_env, offsetof(CPUARMState, regs[15]));
+        gen_ld_i32(thumb, m_env, offsetof(CPUARMState, thumb));
+        gen_ld_i32(condexec, m_env, offsetof(CPUARMState, condexec_bits));
+        LValue target = output()->buildOr(unwrap(pc), unwrap(thumb));
+        LBasicBlock compare = output()->appendBasicBlock("indirect_compare");
+        LBasicBlock miss = output()->appendBasicBlock("indirect_miss");
+        output()->buildCondBr(output()->buildICmp(LLVMIntEQ, unwrap(condexec), output()->repo().int32Zero), compare, miss);
+        output()->positionToBBEnd(compare);
+        for (size_t i = 0; i < m_indirectTargetCount; ++i) {
+            uint32_t expected = m_indirectTargets[i];
+            LBasicBlock hit = output()->appendBasicBlock("indirect_hit");
+            LBasicBlock next = i + 1 < m_indirectTargetCount ? output()->appendBasicBlock("indirect_next") : miss;
+            output()->buildCondBr(output()->buildICmp(LLVMIntEQ, target, output()->constInt32(expected)), hit, next);
+            output()->positionToBBEnd(hit);
+            if ((expected & 1) == m_thumb)
+                gen_goto_tb(expected & ~1u, false);
+            else
+                buildDirectExit(true, expected & ~1u, expected & 1);
+            output()->positionToBBEnd(next);
+        }
+        temp_free_i32(pc);
+        temp_free_i32(thumb);
+        temp_free_i32(condexec);
+    }
+    gen_exit_tb(0);
+}
+
+void LLVMDisasContext::begin_baseline_only()
+{
+}
+
+void LLVMDisasContext::end_baseline_only()
+{
 }
 
 void LLVMDisasContext::gen_ext16s_i32(TCGv_i32 ret, TCGv_i32 arg)
@@ -509,22 +707,34 @@ void LLVMDisasContext::gen_extu_i32_i64(TCGv_i64 ret, TCGv_i32 arg)
 
 void LLVMDisasContext::gen_ld_i32(TCGv_i32 ret, TCGv_ptr arg2, tcg_target_long offset)
 {
+    int slot = envSlot(arg2, offset, 32);
+    if (slot >= 0) {
+        storeToTCG(loadSlot(slot, offset, 32), ret);
+        return;
+    }
     LValue pointer = unwrap(arg2);
     pointer = output()->buildPointerCast(pointer, output()->repo().ref8);
     pointer = output()->buildGEP(pointer, offset);
     pointer = output()->buildPointerCast(pointer, output()->repo().ref32);
     LValue retVal = output()->buildLoad(pointer);
+    output()->tagEnvAccess(retVal);
     storeToTCG(retVal, ret);
 }
 
 void LLVMDisasContext::gen_ld_i64(TCGv_i64 ret, TCGv_ptr arg2,
     target_long offset)
 {
+    int slot = envSlot(arg2, offset, 64);
+    if (slot >= 0) {
+        storeToTCG(loadSlot(slot, offset, 64), ret);
+        return;
+    }
     LValue pointer = unwrap(arg2);
     pointer = output()->buildPointerCast(pointer, output()->repo().ref8);
     pointer = output()->buildGEP(pointer, offset);
     pointer = output()->buildPointerCast(pointer, output()->repo().ref64);
     LValue retVal = output()->buildLoad(pointer);
+    output()->tagEnvAccess(retVal);
     storeToTCG(retVal, ret);
 }
 
@@ -667,6 +877,7 @@ void LLVMDisasContext::gen_qemu_ld_i32(TCGv_i32 val, TCGv addr, TCGArg idx, TCGM
     EMASSERT(idx == 0);
     LValue pointer = tcgPointerToLLVM(memop, addr);
     LValue retVal = output()->buildLoad(pointer);
+    output()->tagGuestAccess(retVal);
     retVal = tcgMemCastTo32(memop, retVal);
     switch (memop) {
     case MO_UB:
@@ -698,6 +909,7 @@ void LLVMDisasContext::gen_qemu_ld_i64(TCGv_i64 val, TCGv addr, TCGArg idx, TCGM
     EMASSERT(idx == 0);
     LValue pointer = tcgPointerToLLVM(memop, addr);
     LValue retVal = output()->buildLoad(pointer);
+    output()->tagGuestAccess(retVal);
     switch (memop) {
     case MO_UB:
         retVal = output()->buildCast(LLVMZExt, retVal, output()->repo().int64);
@@ -729,6 +941,7 @@ void LLVMDisasContext::gen_qemu_ld_i64(TCGv_i64 val, TCGv addr, TCGArg idx, TCGM
 void LLVMDisasContext::gen_qemu_st_i32(TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop)
 {
     EMASSERT(idx == 0);
+    guardCodeStore(addr);
     LValue pointer = tcgPointerToLLVM(memop, addr);
     LValue valToStore = unwrap(val);
     switch (memop) {
@@ -752,12 +965,13 @@ void LLVMDisasContext::gen_qemu_st_i32(TCGv_i32 val, TCGv addr, TCGArg idx, TCGM
     default:
         EMASSERT("unknown memop" && false);
     }
-    output()->buildStore(valToStore, pointer);
+    output()->tagGuestAccess(output()->buildStore(valToStore, pointer));
 }
 
 void LLVMDisasContext::gen_qemu_st_i64(TCGv_i64 val, TCGv addr, TCGArg idx, TCGMemOp memop)
 {
     EMASSERT(idx == 0);
+    guardCodeStore(addr);
     LValue pointer = tcgPointerToLLVM(memop, addr);
     LValue valToStore = unwrap(val);
     switch (memop) {
@@ -779,7 +993,7 @@ void LLVMDisasContext::gen_qemu_st_i64(TCGv_i64 val, TCGv addr, TCGArg idx, TCGM
     default:
         EMASSERT("unknown memop" && false);
     }
-    output()->buildStore(valToStore, pointer);
+    output()->tagGuestAccess(output()->buildStore(valToStore, pointer));
 }
 
 void LLVMDisasContext::gen_rotr_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2)
@@ -876,19 +1090,29 @@ void LLVMDisasContext::gen_shri_i64(TCGv_i64 ret, TCGv_i64 arg1, int64_t arg2)
 
 void LLVMDisasContext::gen_st_i32(TCGv_i32 arg1, TCGv_ptr arg2, tcg_target_long offset)
 {
+    int slot = envSlot(arg2, offset, 32);
+    if (slot >= 0) {
+        storeSlot(slot, offset, 32, unwrap(arg1));
+        return;
+    }
     LValue pointer = output()->buildPointerCast(unwrap(arg2), output()->repo().ref8);
     pointer = output()->buildGEP(pointer, offset);
     pointer = output()->buildPointerCast(pointer, output()->repo().ref32);
-    output()->buildStore(unwrap(arg1), pointer);
+    output()->tagEnvAccess(output()->buildStore(unwrap(arg1), pointer));
 }
 
 void LLVMDisasContext::gen_st_i64(TCGv_i64 arg1, TCGv_ptr arg2,
     tcg_target_long offset)
 {
+    int slot = envSlot(arg2, offset, 64);
+    if (slot >= 0) {
+        storeSlot(slot, offset, 64, unwrap(arg1));
+        return;
+    }
     LValue pointer = output()->buildPointerCast(unwrap(arg2), output()->repo().ref8);
     pointer = output()->buildGEP(pointer, offset);
     pointer = output()->buildPointerCast(pointer, output()->repo().ref64);
-    output()->buildStore(unwrap(arg1), pointer);
+    output()->tagEnvAccess(output()->buildStore(unwrap(arg1), pointer));
 }
 
 void LLVMDisasContext::gen_sub_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2)
@@ -974,31 +1198,120 @@ LValue LLVMDisasContext::myhandleCallRet(void* func, TCGArg ret,
         argsV[i] = unwrap(reinterpret_cast<TCGCommonStruct*>(args[i]));
     }
     LValue retVal = output()->buildTcgHelperCall(reinterpret_cast<void*>(func), nargs, argsV);
+    // the call of an inlined helper is under the casts to the TCG type.
+    LValue call = retVal;
+    while (!llvmAPI->IsACallInst(call))
+        call = llvmAPI->GetOperand(call, 0);
+    recordHelperSync(call, func, nargs, args);
     return retVal;
 }
 
-void LLVMDisasContext::myhandleCallRetNone(void* func, int nargs, TCGArg* args)
+LValue LLVMDisasContext::myhandleCallRetNone(void* func, int nargs, TCGArg* args)
+{
+    LValue argsV[nargs];
+    for (int i = 0; i < nargs; ++i) {
+        argsV[i] = unwrap(reinterpret_cast<TCGCommonStruct*>(args[i]));
+    }
+    LValue call = output()->buildTcgHelperCallNotRet(func, nargs, argsV);
+    recordHelperSync(call, func, nargs, args);
+    return call;
+}
+
+bool LLVMDisasContext::lowerVectorHelper(void* func, TCGArg ret,
+    int nargs, TCGArg* args)
 {
     LValue argsV[nargs];
     for (int i = 0; i < nargs; ++i) {
         argsV[i] = unwrap(reinterpret_cast<TCGCommonStruct*>(args[i]));
     }
-    output()->buildTcgHelperCallNotRet(func, nargs, argsV);
+    LValue saturated;
+    LValue retVal = lowerNeonHelper(*output(), func, nargs, argsV, &saturated);
+    if (!retVal)
+        return false;
+    storeToTCG(retVal, reinterpret_cast<TCGv_ptr>(ret));
+    if (saturated) {
+        // SET_QC of the helper, through its env argument.
+        TCGv_ptr env = reinterpret_cast<TCGv_ptr>(args[0]);
+        tcg_target_long offset = offsetof(CPUARMState, vfp.xregs[ARM_VFP_FPSCR]);
+        TCGv_i32 fpscr = temp_new_i32();
+        gen_ld_i32(fpscr, env, offset);
+        LValue qc = output()->buildSelect(saturated, output()->constInt32(CPSR_Q), output()->repo().int32Zero);
+        storeToTCG(output()->buildOr(unwrap(fpscr), qc), fpscr);
+        gen_st_i32(fpscr, env, offset);
+        temp_free_i32(fpscr);
+    }
+    return true;
+}
+
+bool LLVMDisasContext::lowerFloatHelper(void* func, TCGArg ret,
+    int nargs, TCGArg* args)
+{
+    int statusArg;
+    if (!m_env || !isLoweredVfpHelper(func, &statusArg))
+        return false;
+    LValue argsV[nargs];
+    for (int i = 0; i < nargs; ++i) {
+        argsV[i] = unwrap(reinterpret_cast<TCGCommonStruct*>(args[i]));
+    }
+    if (statusArg >= 0 && !m_vfpStatusPointers.count(argsV[statusArg]))
+        return false;
+    tcg_target_long fpscrOffset = offsetof(CPUARMState, vfp.xregs[ARM_VFP_FPSCR]);
+    TCGv_i32 fpscr = temp_new_i32();
+    gen_ld_i32(fpscr, m_env, fpscrOffset);
+    // the native op must not run in the other modes, where its MXCSR
+    // flags would not be the helper's, so it is built past both checks.
+    LValue defaultMode = output()->buildICmp(LLVMIntEQ, output()->buildAnd(unwrap(fpscr), output()->constInt32(vfpNativeFpscrMask)), output()->repo().int32Zero);
+    LBasicBlock operands = output()->appendBasicBlock("vfpOperands");
+    LBasicBlock native = output()->appendBasicBlock("vfpNative");
+    LBasicBlock helper = output()->appendBasicBlock("vfpHelper");
+    LBasicBlock join = output()->appendBasicBlock("vfpJoin");
+    output()->buildCondBr(defaultMode, operands, helper);
+
+    output()->positionToBBEnd(operands);
+    output()->buildCondBr(checkVfpOperands(*output(), func, argsV), native, helper);
+
+    output()->positionToBBEnd(native);
+    VfpLowering lowering;
+    lowerVfpHelper(*output(), func, argsV, unwrap(fpscr), &lowering);
+    if (lowering.m_fpscr) {
+        storeToTCG(lowering.m_fpscr, fpscr);
+        gen_st_i32(fpscr, m_env, fpscrOffset);
+    }
+    output()->buildBr(join);
+
+    output()->positionToBBEnd(helper);
+    LValue helperValue = nullptr;
+    if (ret != TCG_CALL_DUMMY_ARG)
+        helperValue = myhandleCallRet(func, ret, nargs, args);
+    else
+        myhandleCallRetNone(func, nargs, args);
+    LBasicBlock helperEnd = output()->current();
+    output()->buildBr(join);
+
+    output()->positionToBBEnd(join);
+    if (ret != TCG_CALL_DUMMY_ARG) {
+        LValue phi = output()->buildPhi(output()->typeOf(lowering.m_value));
+        LValue values[] = { lowering.m_value, helperValue };
+        LBasicBlock blocks[] = { native, helperEnd };
+        llvmAPI->AddIncoming(phi, values, blocks, 2);
+        storeToTCG(phi, reinterpret_cast<TCGv_ptr>(ret));
+    }
+    temp_free_i32(fpscr);
+    return true;
 }
 
 void LLVMDisasContext::gen_callN(void* func, TCGArg ret,
     int nargs, TCGArg* args)
 {
+    if (ret != TCG_CALL_DUMMY_ARG && lowerVectorHelper(func, ret, nargs, args))
+        return;
+    if (lowerFloatHelper(func, ret, nargs, args))
+        return;
     if (ret != TCG_CALL_DUMMY_ARG) {
         LValue retVal = myhandleCallRet(func, ret, nargs, args);
         int size = reinterpret_cast<TCGCommonStruct*>(ret)->m_size;
-        if (size == 64) {
-            storeToTCG(retVal, reinterpret_cast<TCGv_ptr>(ret));
-        }
-        else {
-            retVal = output()->buildCast(LLVMTrunc, retVal, output()->repo().int32);
-            storeToTCG(retVal, reinterpret_cast<TCGv_ptr>(ret));
-        }
+        EMASSERT(output()->typeOf(retVal) == (size == 64 ? output()->repo().int64 : output()->repo().int32));
+        storeToTCG(retVal, reinterpret_cast<TCGv_ptr>(ret));
     }
     else {
         myhandleCallRetNone(func, nargs, args);
@@ -1014,4 +1327,269 @@ bool LLVMDisasContext::should_continue()
     return true;
 }
 
+void LLVMDisasContext::gen_insn_start(target_ulong pc, uint32_t condexec)
+{
+    m_insnPc = pc;
+    m_insnCondexec = condexec;
+    if (!m_dispDeopt || output()->currentBlockTerminated())
+        return;
+    auto range = m_speculations.equal_range(pc);
+    for (auto it = range.first; it != range.second; ++it) {
+        const Speculation& speculation = it->second;
+        TCGv_i32 actual = temp_new_i32();
+        TCGv_i32 expected = const_i32(speculation.m_value);
+        gen_ld_i32(actual, m_env, speculation.m_offset);
+        buildGuard(output()->buildICmp(LLVMIntEQ, unwrap(actual), unwrap(expected)));
+        // later uses see the constant, through the slot or store to load
+        // forwarding.
+        gen_st_i32(expected, m_env, speculation.m_offset);
+    }
+}
+
+void LLVMDisasContext::beginRegion(const RegionBlock* blocks, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        LBasicBlock bb = output()->appendBasicBlock("region");
+        auto result = m_regionBlocks.insert(std::make_pair(blocks[i].m_pc, bb));
+        EMASSERT(result.second);
+    }
+    // the entry may be a loop header, and the prologue can not be one.
+    output()->buildBr(m_regionBlocks[blocks[0].m_pc]);
+}
+
+void LLVMDisasContext::beginFunction(target_ulong pc)
+{
+    LBasicBlock bb = output()->appendBasicBlock("region");
+    m_regionBlocks.insert(std::make_pair(pc, bb));
+    m_blocksToTranslate.push_back(pc);
+    m_discoverBlocks = true;
+    output()->buildBr(bb);
+}
+
+bool LLVMDisasContext::nextFunctionBlock(target_ulong* pc)
+{
+    if (m_nextBlockToTranslate == m_blocksToTranslate.size())
+        return false;
+    *pc = m_blocksToTranslate[m_nextBlockToTranslate++];
+    return true;
+}
+
+void LLVMDisasContext::beginRegionBlock(target_ulong pc)
+{
+    auto found = m_regionBlocks.find(pc);
+    EMASSERT(found != m_regionBlocks.end());
+    output()->positionToBBEnd(found->second);
+    m_begunBlocks.insert(pc);
+}
+
+void LLVMDisasContext::enablePromotion()
+{
+    m_promote = true;
+    // the prologue gets the allocas and the initial loads when compiling.
+    m_body = output()->appendBasicBlock("body");
+    output()->positionToBBEnd(m_body);
+}
+
+size_t LLVMDisasContext::promotedSlot(intptr_t offset, int size, bool global)
+{
+    LType type = size == 64 ? output()->repo().int64 : output()->repo().int32;
+    auto found = m_slotIndex.find(offset);
+    if (found != m_slotIndex.end()) {
+        EMASSERT(m_slots[found->second].m_type == type);
+        return found->second;
+    }
+    PromotedSlot slot = { offset, type, output()->buildPrologueAlloca(type), global };
+    m_slotIndex.insert(std::make_pair(offset, m_slots.size()));
+    m_slots.push_back(slot);
+    return m_slots.size() - 1;
+}
+
+// the slot holding an env access, -1 if it goes to memory. The VFP
+// registers get 64 bit slots, single precision accesses use one half.
+int LLVMDisasContext::envSlot(TCGv_ptr base, tcg_target_long offset, int size)
+{
+    if (!m_promote || base != m_env)
+        return -1;
+    auto found = m_slotIndex.find(offset);
+    if (found != m_slotIndex.end() && m_slots[found->second].m_global) {
+        EMASSERT(m_slots[found->second].m_type == (size == 64 ? output()->repo().int64 : output()->repo().int32));
+        return found->second;
+    }
+    const intptr_t vfpStart = offsetof(CPUARMState, vfp.regs);
+    const intptr_t vfpEnd = vfpStart + sizeof(static_cast<CPUARMState*>(nullptr)->vfp.regs);
+    if (offset < vfpStart || offset >= vfpEnd)
+        return -1;
+    return promotedSlot(vfpStart + ((offset - vfpStart) & ~7), 64, false);
+}
+
+LValue LLVMDisasContext::loadSlot(size_t index, intptr_t offset, int size)
+{
+    const PromotedSlot& slot = m_slots[index];
+    LValue v = output()->buildLoad(slot.m_alloca);
+    if (size == 64 || slot.m_type == output()->repo().int32)
+        return v;
+    if (offset != slot.m_offset)
+        v = output()->buildLShr(v, output()->constInt64(32));
+    return output()->buildCast(LLVMTrunc, v, output()->repo().int32);
+}
+
+void LLVMDisasContext::storeSlot(size_t index, intptr_t offset, int size, LValue v)
+{
+    const PromotedSlot& slot = m_slots[index];
+    if (size == 64 || slot.m_type == output()->repo().int32) {
+        output()->buildStore(v, slot.m_alloca);
+        return;
+    }
+    bool high = offset != slot.m_offset;
+    LValue wide = output()->buildCast(LLVMZExt, v, output()->repo().int64);
+    if (high)
+        wide = output()->buildShl(wide, output()->constInt64(32));
+    LValue old = output()->buildLoad(slot.m_alloca);
+    old = output()->buildAnd(old, output()->constInt64(high ? 0xffffffffull : 0xffffffff00000000ull));
+    output()->buildStore(output()->buildOr(old, wide), slot.m_alloca);
+}
+
+LValue LLVMDisasContext::slotEnvAddress(const PromotedSlot& slot)
+{
+    LValue pointer = output()->buildPointerCast(output()->arg(), output()->repo().ref8);
+    pointer = output()->buildGEP(pointer, slot.m_offset);
+    return output()->buildPointerCast(pointer, slot.m_type == output()->repo().int64 ? output()->repo().ref64 : output()->repo().ref32);
+}
+
+void LLVMDisasContext::storeSlots(bool globals, bool env)
+{
+    for (const PromotedSlot& slot : m_slots) {
+        if (slot.m_global ? globals : env)
+            output()->tagEnvAccess(output()->buildStore(output()->buildLoad(slot.m_alloca), slotEnvAddress(slot)));
+    }
+}
+
+void LLVMDisasContext::reloadSlots(bool globals, bool env)
+{
+    for (const PromotedSlot& slot : m_slots) {
+        if (slot.m_global ? globals : env) {
+            LValue load = output()->buildLoad(slotEnvAddress(slot));
+            output()->tagEnvAccess(load);
+            output()->buildStore(load, slot.m_alloca);
+        }
+    }
+}
+
+void LLVMDisasContext::setIndirectProfile(const IndirectProfile* profile, bool thumb)
+{
+    m_indirectTargetCount = profile ? dominantTargets(*profile, m_indirectTargets) : 0;
+    m_thumb = thumb;
+}
+
+void LLVMDisasContext::setChainLookup(ChainLookup lookup, void* opaque)
+{
+    m_chainLookup = lookup;
+    m_chainOpaque = opaque;
+}
+
+void LLVMDisasContext::enableSpeculation(void* dispDeopt, const Speculation* speculations, size_t count, uint32_t codeStart, uint32_t codeEnd)
+{
+    m_dispDeopt = dispDeopt;
+    for (size_t i = 0; i < count; ++i) {
+        m_speculations.insert(std::make_pair(speculations[i].m_pc, speculations[i]));
+    }
+    m_codeStart = codeStart;
+    m_codeEnd = codeEnd;
+}
+
+// continue where ok holds, else leave with the guest state at the start of
+// the current instruction. translate.c updates registers after the stores
+// of an instruction, so replaying it from the start is exact.
+void LLVMDisasContext::buildGuard(LValue ok)
+{
+    LBasicBlock pass = output()->appendBasicBlock("speculated");
+    LBasicBlock fail = output()->appendBasicBlock("deopt");
+    output()->buildGuardBr(ok, pass, fail);
+    output()->positionToBBEnd(fail);
+    gen_st_i32(const_i32(m_insnPc), m_env, offsetof(CPUARMState, regs[15]));
+    gen_st_i32(const_i32(m_insnCondexec), m_env, offsetof(CPUARMState, condexec_bits));
+    LValue exit = output()->buildDeoptPatch();
+    recordSync(exit, SyncStoreGlobals | SyncStoreEnv);
+    output()->positionToBBEnd(pass);
+}
+
+void LLVMDisasContext::guardCodeStore(TCGv addr)
+{
+    if (!m_dispDeopt || m_codeStart == m_codeEnd)
+        return;
+    // addr is 64 bits wide on an x86-64 host, see gen_aa32_st.
+    LValue addrV = unwrap(addr);
+    LType type = jit::typeOf(addrV);
+    LValue offset = output()->buildSub(addrV, jit::constInt(type, m_codeStart));
+    buildGuard(output()->buildICmp(LLVMIntUGE, offset, jit::constInt(type, m_codeEnd - m_codeStart)));
+}
+
+// instruction sees env: exits, helper calls and later deopt points.
+void LLVMDisasContext::recordSync(LValue instruction, unsigned flags)
+{
+    if (m_promote)
+        m_syncPoints.push_back({ instruction, flags });
+}
+
+void LLVMDisasContext::recordHelperSync(LValue call, void* func, int nargs, TCGArg* args)
+{
+    if (!m_promote)
+        return;
+    unsigned flags = 0;
+    if (qemu::helperReadsGlobals(func))
+        flags |= SyncStoreGlobals;
+    if (qemu::helperWritesGlobals(func))
+        flags |= SyncReloadGlobals;
+    // only a helper given env can reach the VFP registers.
+    for (int i = 0; i < nargs; ++i) {
+        if (args[i] == reinterpret_cast<TCGArg>(m_env)) {
+            flags |= SyncStoreEnv | SyncReloadEnv;
+            break;
+        }
+    }
+    recordSync(call, flags);
+}
+
+// slots are synchronized with env only now, when every slot is known.
+void LLVMDisasContext::finalizePromotion()
+{
+    if (!m_promote)
+        return;
+    for (const SyncPoint& point : m_syncPoints) {
+        output()->positionBefore(point.m_instruction);
+        storeSlots(point.m_flags & SyncStoreGlobals, point.m_flags & SyncStoreEnv);
+        if (point.m_flags & (SyncReloadGlobals | SyncReloadEnv)) {
+            output()->positionBefore(llvmAPI->GetNextInstruction(point.m_instruction));
+            reloadSlots(point.m_flags & SyncReloadGlobals, point.m_flags & SyncReloadEnv);
+        }
+    }
+    output()->positionToBBEnd(output()->prologue());
+    reloadSlots(true, true);
+    // the pinned registers come in their host registers, which the code
+    // entry loads from env and a chained exit sets.
+    for (size_t i = 0; i < pinnedRegisterCount; ++i) {
+        auto found = m_slotIndex.find(offsetof(CPUARMState, regs) + pinnedGuestRegisters[i] * sizeof(uint32_t));
+        if (found != m_slotIndex.end())
+            output()->buildStore(output()->pinnedArg(i), m_slots[found->second].m_alloca);
+    }
+    output()->buildBr(m_body);
+}
+
+const uint8_t* LLVMDisasContext::guest_state_map()
+{
+    return nullptr;
+}
+
+void* LLVMDisasContext::code_entry()
+{
+    // the patched prologue in front of the function body.
+    return state()->m_codeSectionList.front();
+}
+
+void* LLVMDisasContext::chainEntry()
+{
+    // past the loads of the pinned registers.
+    return state()->m_codeSectionList.front() + pinnedLoadsSize;
+}
+
 }
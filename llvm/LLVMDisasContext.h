@@ -3,11 +3,17 @@
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include "cpu.h"
 #include "translate.h"
 #include "CompilerState.h"
 #include "Output.h"
 #include "DisasContextBase.h"
+#include "RegionFormer.h"
+#include "Speculation.h"
+#include "CompilePolicy.h"
+#include "ChainLookup.h"
+#include "CompileStats.h"
 
 namespace jit {
 
@@ -15,6 +21,48 @@ class LLVMDisasContext : public DisasContextBase {
 public:
     explicit LLVMDisasContext(ExecutableMemoryAllocator* allocator, void* dispDirect, void* dispInDirect);
     ~LLVMDisasContext();
+    // translate several blocks into this function: call beginRegion once,
+    // then beginRegionBlock before each block. Direct jumps between them
+    // become branches, blocks[0] is the entry.
+    void beginRegion(const RegionBlock* blocks, size_t count);
+    void beginRegionBlock(target_ulong pc);
+    // translate the guest function at pc: direct branch targets are added
+    // to the region as they are found, calls and indirect jumps exit.
+    // Translate every block nextFunctionBlock returns.
+    void beginFunction(target_ulong pc);
+    bool nextFunctionBlock(target_ulong* pc);
+    // keep the TCG globals and the VFP registers in allocas that mem2reg
+    // turns into SSA values. env is loaded once at entry and written back
+    // at exits and around helpers that may see it. Call before generating
+    // any code.
+    void enablePromotion();
+    // guard the speculations at the start of their instructions and the
+    // guest stores against [codeStart, codeEnd). Failed guards write the
+    // state of the instruction back to env, as an exit does, and leave
+    // through dispDeopt. Call before generating any code.
+    void enableSpeculation(void* dispDeopt, const Speculation* speculations, size_t count, uint32_t codeStart, uint32_t codeEnd);
+    // the indirect exits of the following blocks compare against the
+    // dominant targets of profile, null for none. thumb is the state the
+    // blocks run in, only targets in the same state may become branches.
+    void setIndirectProfile(const IndirectProfile* profile, bool thumb);
+    // the tb flags of the following blocks, the direct exits go to blocks
+    // with the same flags but for the thumb and IT state.
+    inline void setBlockFlags(uint64_t flags) { m_blockFlags = flags; }
+    // link asks lookup where the direct exits with a known target go, see
+    // ChainLookup.h. Null, the default, leaves them to the dispatcher.
+    void setChainLookup(ChainLookup lookup, void* opaque);
+    // passes and codegen level compile uses, OptLevel::Full by default.
+    inline void setOptLevel(OptLevel level) { m_optLevel = level; }
+    // whether a region branch closes a loop, final once all blocks are
+    // translated.
+    inline bool hasLoops() const { return m_hasLoops; }
+    // loads of CPUARMState left in the function after optimization, valid
+    // after compile.
+    inline unsigned envLoads() const { return m_envLoads; }
+    // where direct exits of LLVM translations enter this one, with the
+    // pinned guest registers in host registers, see PinnedRegisters.h.
+    // Valid after link.
+    void* chainEntry();
     inline Output* output() { return m_output.get(); }
     inline CompilerState* state() { return m_state.get(); }
     template <typename Type>
@@ -32,6 +80,10 @@ public:
     void storeToTCG(LValue v, TCGType ret);
 
     void extract_64_32(LValue my64, LValue thirtytwo, TCGv_i32 rl, TCGv_i32 rh);
+    // the sum and overflow bits of a + b + carryIn through the
+    // with.overflow intrinsics, which the backend turns into the host flags.
+    void buildAddWithFlags(LValue a, LValue b, LValue carryIn, LValue* sum, LValue* carryOut, LValue* overflow);
+    void storeFlags(LValue result, LValue carryOut, LValue overflow, TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf, TCGv_i32 vf, TCGv_i32 dest);
     LValue tcgPointerToLLVM(TCGMemOp op, TCGv pointer);
     LValue tcgMemCastTo32(TCGMemOp op, LValue val);
 
@@ -49,6 +101,10 @@ public:
 
     virtual void gen_add2_i32(TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
         TCGv_i32 ah, TCGv_i32 bl, TCGv_i32 bh) override;
+    virtual void gen_add_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry) override;
+    virtual void gen_sub_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry) override;
 
     virtual void gen_add_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
     virtual void gen_add_i64(TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2) override;
@@ -72,6 +128,10 @@ public:
         unsigned int len) override;
     virtual void gen_mov_i32(TCGv_i32 ret, TCGv_i32 arg) override;
     virtual void gen_exit_tb(int direct) override;
+    virtual void gen_goto_tb(target_ulong dest, bool link) override;
+    virtual void gen_exit_indirect() override;
+    virtual void begin_baseline_only() override;
+    virtual void end_baseline_only() override;
     virtual void gen_ext16s_i32(TCGv_i32 ret, TCGv_i32 arg) override;
     virtual void gen_ext16u_i32(TCGv_i32 ret, TCGv_i32 arg) override;
     virtual void gen_ext32u_i64(TCGv_i64 ret, TCGv_i64 arg) override;
@@ -140,11 +200,52 @@ public:
         int nargs, TCGArg* args) override;
     virtual void func_start() override;
     virtual bool should_continue() override;
+    virtual void gen_insn_start(target_ulong pc, uint32_t condexec) override;
+    virtual const uint8_t* guest_state_map() override;
+    virtual void* code_entry() override;
 
 private:
     LValue myhandleCallRet(void* func, TCGArg ret,
         int nargs, TCGArg* args);
-    void myhandleCallRetNone(void* func, int nargs, TCGArg* args);
+    LValue myhandleCallRetNone(void* func, int nargs, TCGArg* args);
+    // the NEON helpers NeonLowering knows become vector IR instead of a call.
+    bool lowerVectorHelper(void* func, TCGArg ret, int nargs, TCGArg* args);
+    // the VFP helpers VfpLowering knows become native floating point,
+    // with the helper on a side path for what it does differently.
+    bool lowerFloatHelper(void* func, TCGArg ret, int nargs, TCGArg* args);
+
+    struct PromotedSlot {
+        intptr_t m_offset;
+        LType m_type;
+        LValue m_alloca;
+        bool m_global;
+    };
+    enum SyncFlags {
+        SyncStoreGlobals = 1,
+        SyncReloadGlobals = 2,
+        SyncStoreEnv = 4,
+        SyncReloadEnv = 8,
+    };
+    struct SyncPoint {
+        LValue m_instruction;
+        unsigned m_flags;
+    };
+    size_t promotedSlot(intptr_t offset, int size, bool global);
+    int envSlot(TCGv_ptr base, tcg_target_long offset, int size);
+    LValue loadSlot(size_t index, intptr_t offset, int size);
+    void storeSlot(size_t index, intptr_t offset, int size, LValue v);
+    LValue slotEnvAddress(const PromotedSlot& slot);
+    void storeSlots(bool globals, bool env);
+    void reloadSlots(bool globals, bool env);
+    void recordSync(LValue instruction, unsigned flags);
+    void recordHelperSync(LValue call, void* func, int nargs, TCGArg* args);
+    void finalizePromotion();
+    void loadPinnedRegisters(LValue* values);
+    void buildDirectExit(bool hasTarget, target_ulong pc, bool thumb);
+    void countEnvLoads();
+    void countIR();
+    void buildGuard(LValue ok);
+    void guardCodeStore(TCGv addr);
     uint8_t* m_currentBufferPointer;
     uint8_t* m_currentBufferEnd;
     const static size_t allocate_unit = 4096 * 16;
@@ -155,8 +256,43 @@ private:
     typedef std::unordered_map<int, LBasicBlock> LabelMap;
     LabelMap m_labelMap;
     int m_labelCount;
+    std::unordered_map<target_ulong, LBasicBlock> m_regionBlocks;
+    const static size_t maxFunctionBlocks = 64;
+    bool m_discoverBlocks;
+    std::vector<target_ulong> m_blocksToTranslate;
+    size_t m_nextBlockToTranslate;
+    // region blocks translated so far, a branch to one of them closes a
+    // loop and gets the region the loop passes.
+    std::unordered_set<target_ulong> m_begunBlocks;
+    bool m_hasLoops;
+    OptLevel m_optLevel;
+    bool m_promote;
+    LBasicBlock m_body;
+    TCGv_ptr m_env;
+    // the pointers to vfp.fp_status get_fpstatus_ptr made, the native VFP
+    // lowering does not apply to the NEON standard_fp_status.
+    std::unordered_set<LValue> m_vfpStatusPointers;
+    std::vector<PromotedSlot> m_slots;
+    std::unordered_map<intptr_t, size_t> m_slotIndex;
+    std::vector<SyncPoint> m_syncPoints;
+    unsigned m_envLoads;
+    void* m_dispDeopt;
+    std::unordered_multimap<target_ulong, Speculation> m_speculations;
+    uint32_t m_codeStart;
+    uint32_t m_codeEnd;
+    target_ulong m_insnPc;
+    uint32_t m_insnCondexec;
+    uint32_t m_indirectTargets[IndirectProfile::maxTargets];
+    size_t m_indirectTargetCount;
+    bool m_thumb;
+    uint64_t m_blockFlags;
+    ChainLookup m_chainLookup;
+    void* m_chainOpaque;
     void* m_dispDirect;
     void* m_dispIndirect;
+    // this compilation, added to CompileStats by link.
+    CompileCounters m_counters;
+    double m_buildStart;
 };
 }
 #endif /* LLVMDISASCONTEXT_H */
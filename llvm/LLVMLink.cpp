@@ -4,6 +4,8 @@
 #include "CompilerState.h"
 #include "Abbreviations.h"
 #include "LLVMDisasContext.h"
+#include "PinnedRegisters.h"
+#include "CompileStats.h"
 #include "log.h"
 
 namespace jit {
@@ -12,77 +14,193 @@ struct LinkDesc {
     void* m_opaque;
     void* m_dispTcgDirect;
     void* m_dispTcgIndirect;
+    void* m_dispDeopt;
     void (*m_patchPrologue)(void* opaque, uint8_t* start);
-    void (*m_patchTcgDirect)(void* opaque, uint8_t* toFill, void*);
+    void (*m_patchTcgDirect)(void* opaque, uint8_t* toFill, void*, const StackMapReader::Record& record);
+    void (*m_chainTcgDirect)(void* opaque, uint8_t* toFill, void*, const StackMapReader::Record& record);
+    uintptr_t (*m_directJumpSite)(void* opaque, uint8_t* toFill);
     void (*m_patchTcgIndirect)(void* opaque, uint8_t* toFill, void*);
     uint8_t* (*m_patchMovRegToMem)(void* opaque, uint8_t* toFill);
     uint8_t* (*m_patchMovMemToMem)(void* opaque, uint8_t* toFill);
 };
 
+// the code entry loads the pinned registers, the chain entry after the
+// loads finds them in place.
+static void patchPinnedLoads(uint8_t* start)
+{
+    JSC::X86Assembler assembler(reinterpret_cast<char*>(start), pinnedLoadsSize);
+    for (size_t i = 0; i < pinnedRegisterCount; ++i) {
+        int offset = offsetof(CPUARMState, regs) + pinnedGuestRegisters[i] * sizeof(uint32_t);
+        EMASSERT(JSC::CAN_SIGN_EXTEND_8_32(offset));
+        assembler.movl_mr_disp8(offset, JSC::X86Registers::ebp, static_cast<JSC::X86Registers::RegisterID>(pinnedHostRegisters[i]));
+    }
+    EMASSERT(assembler.codeSize() == pinnedLoadsSize);
+}
+
+#if defined(__x86_64__)
+// the epilogue, movabsq and call of patchExit.
+static const size_t exitSize = 16;
+static const size_t epilogueSize = 4;
+// of the movabsq immediate in the direct jump.
+static const size_t directJumpImmOffset = 2;
+
+// env comes in %rbp, fastcc takes the first argument in %rdi on x86-64.
 static void patchProloge(void*, uint8_t* start)
 {
-    JSC::X86Assembler assembler(reinterpret_cast<char*>(start), 2);
+    patchPinnedLoads(start);
+    JSC::X86Assembler assembler(reinterpret_cast<char*>(start + pinnedLoadsSize), 3);
+    assembler.movq_rr(JSC::X86Registers::ebp, JSC::X86Registers::edi);
+}
+
+// the epilogue restores %rsp and env in %rbp, then the same movabsq and
+// call or jmp the baseline exits use, so patchDirectJump chains both.
+static void patchExit(uint8_t* p, void* entry, bool call)
+{
+    JSC::X86Assembler assembler(reinterpret_cast<char*>(p), exitSize);
+    assembler.movq_rr(JSC::X86Registers::ebp, JSC::X86Registers::esp);
+    assembler.pop_r(JSC::X86Registers::ebp);
+    assembler.movq_i64r(reinterpret_cast<intptr_t>(entry), JSC::X86Registers::eax);
+    if (call)
+        assembler.call(JSC::X86Registers::eax);
+    else
+        assembler.jmp_r(JSC::X86Registers::eax);
+}
+#else
+static const size_t exitSize = 10;
+static const size_t epilogueSize = 3;
+static const size_t directJumpImmOffset = 1;
+
+static void patchProloge(void*, uint8_t* start)
+{
+    patchPinnedLoads(start);
+    JSC::X86Assembler assembler(reinterpret_cast<char*>(start + pinnedLoadsSize), 2);
     assembler.movl_rr(JSC::X86Registers::ebp, JSC::X86Registers::ecx);
 }
 
-static void patchDirect(void*, uint8_t* p, void* entry)
+static void patchExit(uint8_t* p, void* entry, bool call)
 {
     // epilogue
-    JSC::X86Assembler assembler(reinterpret_cast<char*>(p), 10);
+    JSC::X86Assembler assembler(reinterpret_cast<char*>(p), exitSize);
     assembler.movl_rr(JSC::X86Registers::ebp, JSC::X86Registers::esp);
     assembler.pop_r(JSC::X86Registers::ebp);
-    assembler.movl_i32r(reinterpret_cast<int>(entry), JSC::X86Registers::eax);
-    assembler.call(JSC::X86Registers::eax);
+    assembler.movl_i32r(reinterpret_cast<intptr_t>(entry), JSC::X86Registers::eax);
+    if (call)
+        assembler.call(JSC::X86Registers::eax);
+    else
+        assembler.jmp_r(JSC::X86Registers::eax);
+}
+#endif
+
+// direct exits have room for up to this many nops before the epilogue,
+// which keep the immediate of the direct jump in one cache line, as
+// tcg-target.cpp does for exit_tb, so retargetDirectJump can rewrite it.
+static const size_t directJumpSlack = sizeof(uintptr_t) - 1;
+
+// where the exit of the direct exit patchpoint at p starts.
+static uint8_t* directExit(uint8_t* p)
+{
+    uint8_t* exit = p + pinnedMovesSize;
+    while (((reinterpret_cast<uintptr_t>(exit) + epilogueSize + directJumpImmOffset) & 63) > 64 - sizeof(uintptr_t))
+        exit++;
+    EMASSERT(static_cast<size_t>(exit - p) <= pinnedMovesSize + directJumpSlack);
+    return exit;
+}
+
+// the pinned registers go from where the stack map has them to their host
+// registers through the stack, as the two may overlap. The dispatcher
+// finds the direct jump before the return address of the call, the nops
+// after it are never run.
+static void patchPinnedExit(uint8_t* p, void* entry, const StackMapReader::Record& record, bool call)
+{
+    EMASSERT(record.numLocations == pinnedRegisterCount);
+    JSC::X86Assembler assembler(reinterpret_cast<char*>(p), pinnedMovesSize);
+    for (size_t i = 0; i < pinnedRegisterCount; ++i) {
+        StackMaps::Location location = record.location(i);
+        // anyregcc arguments are always in registers.
+        EMASSERT(location.kind == StackMaps::Location::Register);
+        assembler.push_r(static_cast<JSC::X86Registers::RegisterID>(location.dwarfReg.reg().val()));
+    }
+    for (size_t i = pinnedRegisterCount; i--;)
+        assembler.pop_r(static_cast<JSC::X86Registers::RegisterID>(pinnedHostRegisters[i]));
+    uint8_t* exit = directExit(p);
+    size_t moves = assembler.codeSize();
+    JSC::X86Assembler::fillNops(p + moves, exit - p - moves);
+    patchExit(exit, entry, call);
+    JSC::X86Assembler::fillNops(exit + exitSize, p + pinnedMovesSize + directJumpSlack - exit);
+}
+
+static void patchDirect(void*, uint8_t* p, void* entry, const StackMapReader::Record& record)
+{
+    patchPinnedExit(p, entry, record, true);
+}
+
+// jump straight to the successor, as patchDirectJump would.
+static void chainDirect(void*, uint8_t* p, void* entry, const StackMapReader::Record& record)
+{
+    patchPinnedExit(p, entry, record, false);
+}
+
+static uintptr_t directJumpSite(void*, uint8_t* p)
+{
+    return reinterpret_cast<uintptr_t>(directExit(p) + epilogueSize);
 }
 
 void patchIndirect(void*, uint8_t* p, void* entry)
 {
-    JSC::X86Assembler assembler(reinterpret_cast<char*>(p), 10);
-    assembler.movl_rr(JSC::X86Registers::ebp, JSC::X86Registers::esp);
-    assembler.pop_r(JSC::X86Registers::ebp);
-    assembler.movl_i32r(reinterpret_cast<int>(entry), JSC::X86Registers::eax);
-    assembler.jmp_r(JSC::X86Registers::eax);
+    patchExit(p, entry, false);
 }
 
 void LLVMDisasContext::link()
 {
-    StackMaps sm;
+    double linkStart = CompileStats::now();
     const LinkDesc desc = {
         nullptr,
         m_dispDirect,
         m_dispIndirect,
+        m_dispDeopt,
         patchProloge,
         patchDirect,
+        chainDirect,
+        directJumpSite,
         patchIndirect,
     };
-    DataView dv(state()->m_stackMapsSection->data());
-    sm.parse(&dv);
-    auto rm = sm.computeRecordMap();
+    EMASSERT(state()->m_stackMapsSection != nullptr);
     EMASSERT(state()->m_codeSectionList.size() == 1);
     uint8_t* prologue = state()->m_codeSectionList.front();
     uint8_t* body = static_cast<uint8_t*>(state()->m_entryPoint);
     desc.m_patchPrologue(desc.m_opaque, prologue);
-    for (auto& record : rm) {
-        auto found = state()->m_patchMap.find(record.first);
-        if (found == state()->m_patchMap.end()) {
-            // should be the tcg helpers.
-            continue;
-        }
+    // a patchpoint LLVM duplicated has a record per copy.
+    StackMapReader reader(state()->m_stackMapsSection);
+    StackMapReader::Record record;
+    while (reader.next(record)) {
+        // helpers are plain calls, every record is a dispatcher exit.
+        auto found = state()->m_patchMap.find(record.patchpointID);
+        EMASSERT(found != state()->m_patchMap.end());
         PatchDesc& patchDesc = found->second;
+        uint8_t* site = body + record.instructionOffset;
         switch (patchDesc.m_type) {
         case PatchType::TcgDirect: {
-            for (auto& recordUnit : record.second) {
-                desc.m_patchTcgDirect(desc.m_opaque, body + recordUnit.instructionOffset, desc.m_dispTcgDirect);
-            }
-        } break;
-        case PatchType::TcgIndirect: {
-            for (auto& recordUnit : record.second) {
-                desc.m_patchTcgIndirect(desc.m_opaque, body + recordUnit.instructionOffset, desc.m_dispTcgIndirect);
-            }
+            void* successor = nullptr;
+            if (patchDesc.m_hasTarget && m_chainLookup)
+                successor = m_chainLookup(m_chainOpaque, patchDesc.m_targetPc, patchDesc.m_targetFlags, desc.m_directJumpSite(desc.m_opaque, site));
+            if (successor)
+                desc.m_chainTcgDirect(desc.m_opaque, site, successor, record);
+            else
+                desc.m_patchTcgDirect(desc.m_opaque, site, desc.m_dispTcgDirect, record);
         } break;
+        case PatchType::TcgIndirect:
+            desc.m_patchTcgIndirect(desc.m_opaque, site, desc.m_dispTcgIndirect);
+            break;
+        case PatchType::Deopt:
+            desc.m_patchTcgIndirect(desc.m_opaque, site, desc.m_dispDeopt);
+            break;
         default:
             EMUNREACHABLE();
         }
     }
+    m_counters.m_seconds[static_cast<int>(CompilePhase::Link)] = CompileStats::now() - linkStart;
+    m_counters.m_codeBytes = state()->m_codeSize;
+    m_counters.m_compilations = 1;
+    CompileStats::current().record(m_counters);
 }
 }
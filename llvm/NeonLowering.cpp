@@ -0,0 +1,386 @@
+#include <pthread.h>
+#include <unordered_map>
+#include "log.h"
+#include "LLVMAPI.h"
+#include "Output.h"
+#include "QEMUDisasContext.h"
+#include "NeonLowering.h"
+
+namespace jit {
+namespace {
+enum class NeonKind {
+    Add,
+    Sub,
+    Mul,
+    Min,
+    Max,
+    Abd,
+    Hadd,
+    Rhadd,
+    Hsub,
+    Cgt,
+    Cge,
+    Ceq,
+    Tst,
+    Qadd,
+    Qsub,
+    Abs,
+    Shl,
+    Widen,
+    Narrow,
+    NarrowHigh,
+    AddLong,
+    SubLong,
+};
+
+struct NeonOp {
+    const char* m_name;
+    NeonKind m_kind;
+    unsigned m_laneBits;
+    bool m_signed;
+};
+
+const NeonOp neonOps[] = {
+    { "neon_add_u8", NeonKind::Add, 8, false },
+    { "neon_add_u16", NeonKind::Add, 16, false },
+    { "neon_sub_u8", NeonKind::Sub, 8, false },
+    { "neon_sub_u16", NeonKind::Sub, 16, false },
+    { "neon_mul_u8", NeonKind::Mul, 8, false },
+    { "neon_mul_u16", NeonKind::Mul, 16, false },
+    { "neon_min_u8", NeonKind::Min, 8, false },
+    { "neon_min_s8", NeonKind::Min, 8, true },
+    { "neon_min_u16", NeonKind::Min, 16, false },
+    { "neon_min_s16", NeonKind::Min, 16, true },
+    { "neon_min_u32", NeonKind::Min, 32, false },
+    { "neon_min_s32", NeonKind::Min, 32, true },
+    { "neon_max_u8", NeonKind::Max, 8, false },
+    { "neon_max_s8", NeonKind::Max, 8, true },
+    { "neon_max_u16", NeonKind::Max, 16, false },
+    { "neon_max_s16", NeonKind::Max, 16, true },
+    { "neon_max_u32", NeonKind::Max, 32, false },
+    { "neon_max_s32", NeonKind::Max, 32, true },
+    { "neon_abd_u8", NeonKind::Abd, 8, false },
+    { "neon_abd_s8", NeonKind::Abd, 8, true },
+    { "neon_abd_u16", NeonKind::Abd, 16, false },
+    { "neon_abd_s16", NeonKind::Abd, 16, true },
+    { "neon_abd_u32", NeonKind::Abd, 32, false },
+    { "neon_abd_s32", NeonKind::Abd, 32, true },
+    { "neon_hadd_u8", NeonKind::Hadd, 8, false },
+    { "neon_hadd_s8", NeonKind::Hadd, 8, true },
+    { "neon_hadd_u16", NeonKind::Hadd, 16, false },
+    { "neon_hadd_s16", NeonKind::Hadd, 16, true },
+    { "neon_rhadd_u8", NeonKind::Rhadd, 8, false },
+    { "neon_rhadd_s8", NeonKind::Rhadd, 8, true },
+    { "neon_rhadd_u16", NeonKind::Rhadd, 16, false },
+    { "neon_rhadd_s16", NeonKind::Rhadd, 16, true },
+    { "neon_hsub_u8", NeonKind::Hsub, 8, false },
+    { "neon_hsub_s8", NeonKind::Hsub, 8, true },
+    { "neon_hsub_u16", NeonKind::Hsub, 16, false },
+    { "neon_hsub_s16", NeonKind::Hsub, 16, true },
+    { "neon_cgt_u8", NeonKind::Cgt, 8, false },
+    { "neon_cgt_s8", NeonKind::Cgt, 8, true },
+    { "neon_cgt_u16", NeonKind::Cgt, 16, false },
+    { "neon_cgt_s16", NeonKind::Cgt, 16, true },
+    { "neon_cgt_u32", NeonKind::Cgt, 32, false },
+    { "neon_cgt_s32", NeonKind::Cgt, 32, true },
+    { "neon_cge_u8", NeonKind::Cge, 8, false },
+    { "neon_cge_s8", NeonKind::Cge, 8, true },
+    { "neon_cge_u16", NeonKind::Cge, 16, false },
+    { "neon_cge_s16", NeonKind::Cge, 16, true },
+    { "neon_cge_u32", NeonKind::Cge, 32, false },
+    { "neon_cge_s32", NeonKind::Cge, 32, true },
+    { "neon_ceq_u8", NeonKind::Ceq, 8, false },
+    { "neon_ceq_u16", NeonKind::Ceq, 16, false },
+    { "neon_ceq_u32", NeonKind::Ceq, 32, false },
+    { "neon_tst_u8", NeonKind::Tst, 8, false },
+    { "neon_tst_u16", NeonKind::Tst, 16, false },
+    { "neon_tst_u32", NeonKind::Tst, 32, false },
+    { "neon_qadd_u8", NeonKind::Qadd, 8, false },
+    { "neon_qadd_s8", NeonKind::Qadd, 8, true },
+    { "neon_qadd_u16", NeonKind::Qadd, 16, false },
+    { "neon_qadd_s16", NeonKind::Qadd, 16, true },
+    { "neon_qadd_u32", NeonKind::Qadd, 32, false },
+    { "neon_qadd_s32", NeonKind::Qadd, 32, true },
+    { "neon_qsub_u8", NeonKind::Qsub, 8, false },
+    { "neon_qsub_s8", NeonKind::Qsub, 8, true },
+    { "neon_qsub_u16", NeonKind::Qsub, 16, false },
+    { "neon_qsub_s16", NeonKind::Qsub, 16, true },
+    { "neon_qsub_u32", NeonKind::Qsub, 32, false },
+    { "neon_qsub_s32", NeonKind::Qsub, 32, true },
+    { "neon_abs_s8", NeonKind::Abs, 8, true },
+    { "neon_abs_s16", NeonKind::Abs, 16, true },
+    { "neon_shl_u8", NeonKind::Shl, 8, false },
+    { "neon_shl_s8", NeonKind::Shl, 8, true },
+    { "neon_shl_u16", NeonKind::Shl, 16, false },
+    { "neon_shl_s16", NeonKind::Shl, 16, true },
+    { "neon_widen_u8", NeonKind::Widen, 8, false },
+    { "neon_widen_s8", NeonKind::Widen, 8, true },
+    { "neon_widen_u16", NeonKind::Widen, 16, false },
+    { "neon_widen_s16", NeonKind::Widen, 16, true },
+    { "neon_narrow_u8", NeonKind::Narrow, 8, false },
+    { "neon_narrow_u16", NeonKind::Narrow, 16, false },
+    { "neon_narrow_high_u8", NeonKind::NarrowHigh, 8, false },
+    { "neon_narrow_high_u16", NeonKind::NarrowHigh, 16, false },
+    { "neon_addl_u16", NeonKind::AddLong, 16, false },
+    { "neon_addl_u32", NeonKind::AddLong, 32, false },
+    { "neon_subl_u16", NeonKind::SubLong, 16, false },
+    { "neon_subl_u32", NeonKind::SubLong, 32, false },
+};
+
+pthread_once_t neonOpsOnce = PTHREAD_ONCE_INIT;
+std::unordered_map<void*, const NeonOp*>* neonOpsByHelper;
+
+void initNeonOps()
+{
+    neonOpsByHelper = new std::unordered_map<void*, const NeonOp*>();
+    for (const NeonOp& op : neonOps) {
+        void* func = qemu::helperByName(op.m_name);
+        EMASSERT(func != nullptr);
+        neonOpsByHelper->insert(std::make_pair(func, &op));
+    }
+}
+
+// builds one lowering on the vector type of a helper operand.
+class Builder {
+public:
+    Builder(Output& output, const NeonOp& op)
+        : m_output(output)
+        , m_op(op)
+    {
+    }
+
+    LValue lower(const LValue* operands, LValue* saturated);
+
+private:
+    LType laneType(unsigned bits) const;
+    LValue splat(LType vectorType, unsigned long long value) const;
+    // the integer v as lanes of bits each.
+    LValue lanes(LValue v, unsigned bits) const;
+    LValue toInteger(LValue v, unsigned width) const;
+    LValue extend(LValue v, LType type) const;
+    // a lane-wise comparison as the NEON all ones or all zeros lanes.
+    LValue mask(LValue cond, LType type) const;
+    LValue saturatingAddSub(LValue a, LValue b, LValue* saturated);
+    LValue shift(LValue a, LValue amount);
+
+    Output& m_output;
+    const NeonOp& m_op;
+};
+
+LType Builder::laneType(unsigned bits) const
+{
+    switch (bits) {
+    case 8:
+        return m_output.repo().int8;
+    case 16:
+        return m_output.repo().int16;
+    case 32:
+        return m_output.repo().int32;
+    default:
+        EMASSERT(bits == 64);
+        return m_output.repo().int64;
+    }
+}
+
+LValue Builder::splat(LType vectorType, unsigned long long value) const
+{
+    unsigned count = llvmAPI->GetVectorSize(vectorType);
+    LValue element = constInt(llvmAPI->GetElementType(vectorType), value);
+    LValue elements[count];
+    for (unsigned i = 0; i < count; ++i)
+        elements[i] = element;
+    return llvmAPI->ConstVector(elements, count);
+}
+
+LValue Builder::lanes(LValue v, unsigned bits) const
+{
+    unsigned width = llvmAPI->GetIntTypeWidth(typeOf(v));
+    return m_output.buildBitCast(v, vectorType(laneType(bits), width / bits));
+}
+
+LValue Builder::toInteger(LValue v, unsigned width) const
+{
+    return m_output.buildBitCast(v, laneType(width));
+}
+
+LValue Builder::extend(LValue v, LType type) const
+{
+    return m_output.buildCast(m_op.m_signed ? LLVMSExt : LLVMZExt, v, type);
+}
+
+LValue Builder::mask(LValue cond, LType type) const
+{
+    return m_output.buildCast(LLVMSExt, cond, type);
+}
+
+LValue Builder::saturatingAddSub(LValue a, LValue b, LValue* saturated)
+{
+    // in lanes of twice the width nothing wraps, clamp and narrow back.
+    LType type = typeOf(a);
+    unsigned count = llvmAPI->GetVectorSize(type);
+    unsigned bits = m_op.m_laneBits;
+    LType wide = vectorType(laneType(bits * 2), count);
+    LValue wa = extend(a, wide);
+    LValue wb = extend(b, wide);
+    LValue r = m_op.m_kind == NeonKind::Qadd ? m_output.buildAdd(wa, wb) : m_output.buildSub(wa, wb);
+    LValue max, min, above, below;
+    if (m_op.m_signed) {
+        max = splat(wide, (1ULL << (bits - 1)) - 1);
+        min = splat(wide, -(1ULL << (bits - 1)));
+        above = m_output.buildICmp(LLVMIntSGT, r, max);
+        below = m_output.buildICmp(LLVMIntSLT, r, min);
+    }
+    else {
+        max = splat(wide, (1ULL << bits) - 1);
+        min = splat(wide, 0);
+        above = m_output.buildICmp(LLVMIntSGT, r, max);
+        below = m_output.buildICmp(LLVMIntSLT, r, min);
+    }
+    r = m_output.buildSelect(above, max, m_output.buildSelect(below, min, r));
+    LValue clamped = m_output.buildOr(mask(above, type), mask(below, type));
+    *saturated = m_output.buildICmp(LLVMIntNE, toInteger(clamped, bits * count), constInt(laneType(bits * count), 0));
+    return m_output.buildCast(LLVMTrunc, r, type);
+}
+
+LValue Builder::shift(LValue a, LValue amount)
+{
+    // only a shift by a constant that is the same in every lane and within
+    // the lane, the helper sorts out the rest.
+    if (!llvmAPI->IsAConstantInt(amount))
+        return nullptr;
+    unsigned bits = m_op.m_laneBits;
+    unsigned long long value = llvmAPI->ConstIntGetZExtValue(amount);
+    int8_t count = static_cast<int8_t>(value);
+    for (unsigned i = bits; i < 32; i += bits) {
+        if (static_cast<int8_t>(value >> i) != count)
+            return nullptr;
+    }
+    if (count >= static_cast<int>(bits) || count <= -static_cast<int>(bits))
+        return nullptr;
+    LType type = typeOf(a);
+    if (count >= 0)
+        return m_output.buildShl(a, splat(type, count));
+    if (m_op.m_signed)
+        return m_output.buildAShr(a, splat(type, -count));
+    return m_output.buildLShr(a, splat(type, -count));
+}
+
+LValue Builder::lower(const LValue* operands, LValue* saturated)
+{
+    unsigned bits = m_op.m_laneBits;
+    LValue a = operands[0];
+    unsigned width = llvmAPI->GetIntTypeWidth(typeOf(a));
+    LValue va = lanes(a, bits);
+    LType type = typeOf(va);
+    unsigned count = width / bits;
+    LIntPredicate greater = m_op.m_signed ? LLVMIntSGT : LLVMIntUGT;
+    LIntPredicate less = m_op.m_signed ? LLVMIntSLT : LLVMIntULT;
+    LValue r;
+    switch (m_op.m_kind) {
+    case NeonKind::Abs: {
+        LValue negative = m_output.buildICmp(LLVMIntSLT, va, splat(type, 0));
+        r = m_output.buildSelect(negative, m_output.buildNeg(va), va);
+        return toInteger(r, width);
+    }
+    case NeonKind::Widen: {
+        LType wide = vectorType(laneType(bits * 2), count);
+        return toInteger(extend(va, wide), width * 2);
+    }
+    case NeonKind::Narrow:
+    case NeonKind::NarrowHigh: {
+        // the operand holds the wide lanes.
+        LValue wide = lanes(a, bits * 2);
+        if (m_op.m_kind == NeonKind::NarrowHigh)
+            wide = m_output.buildLShr(wide, splat(typeOf(wide), bits));
+        r = m_output.buildCast(LLVMTrunc, wide, vectorType(laneType(bits), width / bits / 2));
+        return toInteger(r, width / 2);
+    }
+    default:
+        break;
+    }
+
+    LValue vb = lanes(operands[1], bits);
+    switch (m_op.m_kind) {
+    case NeonKind::Add:
+    case NeonKind::AddLong:
+        r = m_output.buildAdd(va, vb);
+        break;
+    case NeonKind::Sub:
+    case NeonKind::SubLong:
+        r = m_output.buildSub(va, vb);
+        break;
+    case NeonKind::Mul:
+        r = m_output.buildMul(va, vb);
+        break;
+    case NeonKind::Min:
+        r = m_output.buildSelect(m_output.buildICmp(less, va, vb), va, vb);
+        break;
+    case NeonKind::Max:
+        r = m_output.buildSelect(m_output.buildICmp(greater, va, vb), va, vb);
+        break;
+    case NeonKind::Abd:
+        r = m_output.buildSelect(m_output.buildICmp(greater, va, vb), m_output.buildSub(va, vb), m_output.buildSub(vb, va));
+        break;
+    case NeonKind::Hadd:
+    case NeonKind::Rhadd:
+    case NeonKind::Hsub: {
+        LType wide = vectorType(laneType(bits * 2), count);
+        LValue wa = extend(va, wide);
+        LValue wb = extend(vb, wide);
+        LValue w = m_op.m_kind == NeonKind::Hsub ? m_output.buildSub(wa, wb) : m_output.buildAdd(wa, wb);
+        if (m_op.m_kind == NeonKind::Rhadd)
+            w = m_output.buildAdd(w, splat(wide, 1));
+        w = m_op.m_signed ? m_output.buildAShr(w, splat(wide, 1)) : m_output.buildLShr(w, splat(wide, 1));
+        r = m_output.buildCast(LLVMTrunc, w, type);
+        break;
+    }
+    case NeonKind::Cgt:
+        r = mask(m_output.buildICmp(greater, va, vb), type);
+        break;
+    case NeonKind::Cge:
+        r = mask(m_output.buildICmp(m_op.m_signed ? LLVMIntSGE : LLVMIntUGE, va, vb), type);
+        break;
+    case NeonKind::Ceq:
+        r = mask(m_output.buildICmp(LLVMIntEQ, va, vb), type);
+        break;
+    case NeonKind::Tst:
+        r = mask(m_output.buildICmp(LLVMIntNE, m_output.buildAnd(va, vb), splat(type, 0)), type);
+        break;
+    case NeonKind::Qadd:
+    case NeonKind::Qsub:
+        r = saturatingAddSub(va, vb, saturated);
+        break;
+    case NeonKind::Shl:
+        r = shift(va, operands[1]);
+        if (!r)
+            return nullptr;
+        break;
+    default:
+        EMUNREACHABLE();
+    }
+    return toInteger(r, width);
+}
+}
+
+LValue lowerNeonHelper(Output& output, void* func, int nargs, const LValue* args, LValue* saturated)
+{
+    *saturated = nullptr;
+    pthread_once(&neonOpsOnce, initNeonOps);
+    auto found = neonOpsByHelper->find(func);
+    if (found == neonOpsByHelper->end())
+        return nullptr;
+    const NeonOp& op = *found->second;
+    // the saturating helpers take env first.
+    const LValue* operands = args;
+    if (op.m_kind == NeonKind::Qadd || op.m_kind == NeonKind::Qsub) {
+        EMASSERT(nargs == 3);
+        operands++;
+    }
+    Builder builder(output, op);
+    LValue saturatedLanes = nullptr;
+    LValue result = builder.lower(operands, &saturatedLanes);
+    if (result)
+        *saturated = saturatedLanes;
+    return result;
+}
+}
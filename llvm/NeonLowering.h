@@ -0,0 +1,20 @@
+#ifndef NEONLOWERING_H
+#define NEONLOWERING_H
+#include "AbbreviatedTypes.h"
+namespace jit {
+class Output;
+
+// translate.c hands NEON to the backends as helper calls on 32 or 64 bit
+// pieces of a D or Q register, each lane packed into an integer. For the
+// common lane-wise helpers this builds the same operation on an LLVM
+// vector such as <4 x i8> or <2 x i32>, bitcast from and back to the
+// integer, so the backend selects SSE2/SSSE3 and the SLP vectorizer may
+// join the pieces of a Q register. Other helpers stay calls.
+//
+// Returns the value of the helper at func on args, or null if it is not
+// lowered. saturated is set for the saturating helpers to an i1 that is
+// true when a lane saturated, the caller then sets FPSCR.QC through the
+// env argument; it is null for the others.
+LValue lowerNeonHelper(Output& output, void* func, int nargs, const LValue* args, LValue* saturated);
+}
+#endif /* NEONLOWERING_H */
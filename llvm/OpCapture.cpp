@@ -0,0 +1,174 @@
+#include <string.h>
+#include "log.h"
+#include "QEMUDisasContext.h"
+#include "OpCapture.h"
+
+namespace jit {
+static const char captureMagic[4] = { 'T', 'C', 'G', 'C' };
+static const uint32_t captureVersion = 2;
+// a string or table longer than this is a corrupt file.
+static const uint32_t maxCount = 1 << 24;
+
+template <typename Type>
+static void put(std::vector<uint8_t>& out, Type value)
+{
+    for (size_t i = 0; i < sizeof(Type); ++i)
+        out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+}
+
+static void putString(std::vector<uint8_t>& out, const char* s)
+{
+    uint32_t length = strlen(s);
+    put(out, length);
+    out.insert(out.end(), s, s + length);
+}
+
+template <typename Type>
+static bool get(FILE* file, Type* value)
+{
+    uint8_t bytes[sizeof(Type)];
+    if (fread(bytes, 1, sizeof(Type), file) != sizeof(Type))
+        return false;
+    uint64_t v = 0;
+    for (size_t i = 0; i < sizeof(Type); ++i)
+        v |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+    *value = static_cast<Type>(v);
+    return true;
+}
+
+CaptureWriter::CaptureWriter()
+    : m_file(nullptr)
+{
+    pthread_mutex_init(&m_lock, nullptr);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    if (m_file)
+        fclose(m_file);
+    pthread_mutex_destroy(&m_lock);
+}
+
+bool CaptureWriter::open(const char* path)
+{
+    EMASSERT(m_file == nullptr);
+    m_file = fopen(path, "wb");
+    if (!m_file) {
+        LOGE("%s: fails to open %s.\n", __FUNCTION__, path);
+        return false;
+    }
+    std::vector<uint8_t> header(captureMagic, captureMagic + sizeof(captureMagic));
+    put(header, captureVersion);
+    put(header, static_cast<uint32_t>(sizeof(void*)));
+    fwrite(header.data(), 1, header.size(), m_file);
+    return true;
+}
+
+void CaptureWriter::append(const OpRecording& recording)
+{
+    std::vector<uint8_t> out;
+    put(out, static_cast<uint32_t>(recording.m_pc));
+    put(out, recording.m_flags);
+    put(out, recording.m_size);
+    put(out, recording.m_icount);
+    put(out, recording.m_valueCount);
+    put(out, recording.m_labelCount);
+    put(out, static_cast<uint32_t>(recording.m_names.size()));
+    for (const char* name : recording.m_names)
+        putString(out, name);
+    put(out, static_cast<uint32_t>(recording.m_helpers.size()));
+    for (void* helper : recording.m_helpers) {
+        const char* name = qemu::helperName(helper);
+        EMASSERT(name != nullptr);
+        putString(out, name);
+    }
+    put(out, static_cast<uint32_t>(recording.m_words.size()));
+    for (uint32_t word : recording.m_words)
+        put(out, word);
+    pthread_mutex_lock(&m_lock);
+    fwrite(out.data(), 1, out.size(), m_file);
+    pthread_mutex_unlock(&m_lock);
+}
+
+CaptureReader::CaptureReader()
+    : m_file(nullptr)
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+bool CaptureReader::open(const char* path)
+{
+    EMASSERT(m_file == nullptr);
+    m_file = fopen(path, "rb");
+    if (!m_file) {
+        LOGE("%s: fails to open %s.\n", __FUNCTION__, path);
+        return false;
+    }
+    char magic[sizeof(captureMagic)];
+    uint32_t version, pointerSize;
+    if (fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) || memcmp(magic, captureMagic, sizeof(magic)) != 0
+        || !get(m_file, &version) || version != captureVersion || !get(m_file, &pointerSize)) {
+        LOGE("%s: %s is not a capture file of version %u.\n", __FUNCTION__, path, captureVersion);
+        return false;
+    }
+    if (pointerSize != sizeof(void*)) {
+        LOGE("%s: %s was captured on a host with %u byte pointers.\n", __FUNCTION__, path, pointerSize);
+        return false;
+    }
+    return true;
+}
+
+bool CaptureReader::readString(std::string& s)
+{
+    uint32_t length;
+    if (!get(m_file, &length) || length > maxCount)
+        return false;
+    s.resize(length);
+    return length == 0 || fread(&s[0], 1, length, m_file) == length;
+}
+
+bool CaptureReader::next(OpRecording& recording)
+{
+    recording.clear();
+    uint32_t pc, count;
+    if (!get(m_file, &pc))
+        return false;
+    recording.m_pc = pc;
+    if (!get(m_file, &recording.m_flags) || !get(m_file, &recording.m_size) || !get(m_file, &recording.m_icount)
+        || !get(m_file, &recording.m_valueCount) || !get(m_file, &recording.m_labelCount))
+        return false;
+    std::string s;
+    if (!get(m_file, &count) || count > maxCount)
+        return false;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!readString(s))
+            return false;
+        recording.m_names.push_back(m_names.insert(s).first->c_str());
+    }
+    if (!get(m_file, &count) || count > maxCount)
+        return false;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!readString(s))
+            return false;
+        void* helper = qemu::helperByName(s.c_str());
+        if (!helper) {
+            LOGE("%s: unknown helper %s.\n", __FUNCTION__, s.c_str());
+            return false;
+        }
+        recording.m_helpers.push_back(helper);
+    }
+    if (!get(m_file, &count) || count > maxCount)
+        return false;
+    recording.m_words.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!get(m_file, &recording.m_words[i]))
+            return false;
+    }
+    return true;
+}
+}
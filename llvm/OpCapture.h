@@ -0,0 +1,58 @@
+#ifndef OPCAPTURE_H
+#define OPCAPTURE_H
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_set>
+#include "RecordingDisasContext.h"
+namespace jit {
+
+// A capture file holds the OpRecordings of many blocks, so the backends
+// can be benchmarked without the decoder, a cpu or guest code. All
+// integers are little endian:
+//
+//   "TCGC", u32 version, u32 pointer size
+//   per block:
+//     u32 pc, u64 flags, u16 size, u32 icount,
+//     u32 value count, u32 label count,
+//     u32 name count, per name u32 length and the bytes,
+//     u32 helper count, per helper the name it is registered under,
+//     u32 word count, the words.
+//
+// Helpers are stored by name and resolved in the reading process. Pointer
+// constants keep their value, which only matters to code that runs, and
+// take words as on the capturing host, so readers check the pointer size.
+class CaptureWriter {
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+    bool open(const char* path);
+    // safe to call from several translating threads.
+    void append(const OpRecording& recording);
+
+private:
+    pthread_mutex_t m_lock;
+    FILE* m_file;
+};
+
+class CaptureReader {
+public:
+    CaptureReader();
+    ~CaptureReader();
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+    bool open(const char* path);
+    // false at the end of the file or on a malformed block. The names of
+    // the recording stay valid as long as the reader.
+    bool next(OpRecording& recording);
+
+private:
+    bool readString(std::string& s);
+    FILE* m_file;
+    std::unordered_set<std::string> m_names;
+};
+}
+#endif /* OPCAPTURE_H */
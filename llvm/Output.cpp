@@ -2,26 +2,48 @@
 #include <vector>
 #include <llvm/IR/IRBuilder.h>
 #include "CompilerState.h"
+#include "HelperLibrary.h"
 #include "Output.h"
+#include "PinnedRegisters.h"
+#include "QEMUDisasContext.h"
 #include "log.h"
 
 namespace jit {
+// AttributeSet::FunctionIndex, attributes of the callee itself.
+static const unsigned functionAttributeIndex = ~0U;
+
 Output::Output(CompilerState& state)
     : m_state(state)
     , m_repo(state.m_context, state.m_module)
     , m_builder(nullptr)
     , m_stackMapsId(1)
+    , m_tbaaKind(0)
+    , m_tbaaEnv(nullptr)
+    , m_tbaaGuest(nullptr)
     , m_currentBlockTerminated(false)
 {
-    m_argType = pointerType(arrayType(repo().intPtr, state.m_platformDesc.m_contextSize / sizeof(intptr_t)));
+    // CPUARMState as 32 bit words, the granularity of the guest registers
+    // on either host.
+    m_argType = pointerType(arrayType(repo().int32, state.m_platformDesc.m_contextSize / sizeof(uint32_t)));
+    // env, then the pinned guest registers.
+    std::vector<LType> paramTypes(1 + pinnedRegisterCount, repo().int32);
+    paramTypes[0] = m_argType;
     state.m_function = addFunction(
-        state.m_module, "main", functionType(repo().voidType, m_argType));
+        state.m_module, "main", functionType(repo().voidType, paramTypes.data(), paramTypes.size(), NotVariadic));
     llvmAPI->SetFunctionCallConv(state.m_function, LLVMFastCallConv);
+#if defined(__x86_64__)
+    // translations are jumped to, not called, with whatever alignment the
+    // dispatcher or the baseline left: alignstack(16) realigns the frame,
+    // which the exits drop through %rbp anyway. The attribute keeps
+    // log2(alignment) + 1 in the LLVMStackAlignment bits.
+    llvmAPI->AddFunctionAttr(state.m_function, static_cast<LLVMAttribute>((4 + 1) << 26));
+#endif
     m_builder = llvmAPI->CreateBuilderInContext(state.m_context);
 
     m_prologue = appendBasicBlock("Prologue");
     positionToBBEnd(m_prologue);
     buildGetArg();
+    buildTbaaTags();
 }
 
 Output::~Output()
@@ -266,78 +288,163 @@ void Output::buildGetArg()
     m_arg = llvmAPI->GetParam(m_state.m_function, 0);
 }
 
-void Output::buildTcgDirectPatch(void)
+LValue Output::pinnedArg(size_t index)
+{
+    EMASSERT(index < pinnedRegisterCount);
+    return llvmAPI->GetParam(m_state.m_function, 1 + index);
+}
+
+// anyregcc puts the arguments in registers, the stack map tells link
+// which.
+LValue Output::buildExitPatch(const PatchDesc& desc, const LValue* args, unsigned numArgs)
 {
-    PatchDesc desc = { PatchType::TcgDirect };
-    LValue call = buildCall(repo().patchpointVoidIntrinsic(), constInt64(m_stackMapsId), constInt32(m_state.m_platformDesc.m_tcgSize), constNull(repo().ref8), constInt32(0));
+    std::vector<LValue> operands = { constInt64(m_stackMapsId), constInt32(m_state.m_platformDesc.m_tcgSize), constNull(repo().ref8), constInt32(numArgs) };
+    operands.insert(operands.end(), args, args + numArgs);
+    LValue call = buildCall(repo().patchpointVoidIntrinsic(), operands.data(), operands.size());
     llvmAPI->SetInstructionCallConv(call, LLVMAnyRegCallConv);
     buildUnreachable(m_builder);
     // record the stack map info
     auto result = m_state.m_patchMap.insert(std::make_pair(m_stackMapsId++, desc));
     EMASSERT(result.second == true);
     m_currentBlockTerminated = true;
+    return call;
+}
+
+LValue Output::buildTcgDirectPatch(const LValue* pinned, bool hasTarget, uint32_t targetPc, uint64_t targetFlags)
+{
+    PatchDesc desc = { PatchType::TcgDirect, nullptr, hasTarget, targetPc, targetFlags };
+    return buildExitPatch(desc, pinned, pinnedRegisterCount);
 }
 
-void Output::buildTcgIndirectPatch(void)
+LValue Output::buildTcgIndirectPatch(void)
 {
     PatchDesc desc = { PatchType::TcgIndirect };
-    LValue call = buildCall(repo().patchpointVoidIntrinsic(), constInt64(m_stackMapsId), constInt32(m_state.m_platformDesc.m_tcgSize), constNull(repo().ref8), constInt32(0));
-    llvmAPI->SetInstructionCallConv(call, LLVMAnyRegCallConv);
-    buildUnreachable(m_builder);
-    // record the stack map info
-    auto result = m_state.m_patchMap.insert(std::make_pair(m_stackMapsId++, desc));
-    EMASSERT(result.second == true);
-    m_currentBlockTerminated = true;
+    return buildExitPatch(desc, nullptr, 0);
 }
 
-LValue Output::buildTcgHelperCallNotRet(void* func, int num, LValue* param)
+LValue Output::buildDeoptPatch(void)
 {
-    LValue funcVal = constIntPtr(reinterpret_cast<uintptr_t>(func));
-    funcVal = buildCast(LLVMIntToPtr, funcVal, repo().ref8);
-    LValue params[4 + num];
-    params[0] = constInt64(m_stackMapsId);
-    params[1] = repo().int32Eight;
-    params[2] = funcVal;
-    params[3] = constInt32(num);
-    for (int i = 4; i < num + 4; ++i) {
-        LValue p = param[i - 4];
-        params[i] = p;
+    PatchDesc desc = { PatchType::Deopt };
+    return buildExitPatch(desc, nullptr, 0);
+}
+
+LValue Output::buildGuardBr(LValue ok, LBasicBlock pass, LBasicBlock fail)
+{
+    LValue br = buildCondBr(ok, pass, fail);
+    LValue weights[] = { repo().branchWeights, constInt32(1 << 20), constInt32(1) };
+    setMetadata(br, mdKindID(m_state.m_context, "prof"), mdNode(m_state.m_context, weights, 3));
+    return br;
+}
+
+// TCG values are integers or pointers, helper parameters of other types
+// travel in integers of the same width.
+LValue Output::buildHelperValueCast(LValue value, LType type)
+{
+    LType from = typeOf(value);
+    if (from == type)
+        return value;
+    LLVMTypeKind fromKind = llvmAPI->GetTypeKind(from);
+    LLVMTypeKind toKind = llvmAPI->GetTypeKind(type);
+    if (fromKind == LLVMPointerTypeKind && toKind == LLVMPointerTypeKind)
+        return buildBitCast(value, type);
+    if (toKind == LLVMPointerTypeKind)
+        return buildCast(LLVMIntToPtr, value, type);
+    if (fromKind == LLVMPointerTypeKind)
+        return buildCast(LLVMPtrToInt, value, type);
+    if (fromKind == LLVMIntegerTypeKind && toKind == LLVMIntegerTypeKind) {
+        bool widen = llvmAPI->GetIntTypeWidth(from) < llvmAPI->GetIntTypeWidth(type);
+        return buildCast(widen ? LLVMZExt : LLVMTrunc, value, type);
     }
-    LValue call = buildCall(repo().patchpointVoidIntrinsic(), params, 4 + num);
-    // record the stack map info
-    m_stackMapsId++;
+    return buildBitCast(value, type);
+}
+
+// a direct call of the body the helper library has for func, which the
+// inliner then expands. Null if there is none.
+LValue Output::buildInlinedHelperCall(void* func, int num, LValue* param)
+{
+    if (!m_state.m_helperLibrary)
+        return nullptr;
+    LValue callee = m_state.m_helperLibrary->cloneInto(m_state.m_module, func);
+    if (!callee)
+        return nullptr;
+    LType type = llvmAPI->GetElementType(typeOf(callee));
+    if (llvmAPI->CountParamTypes(type) != static_cast<unsigned>(num))
+        return nullptr;
+    LType paramTypes[num + 1];
+    llvmAPI->GetParamTypes(type, paramTypes);
+    LValue args[num + 1];
+    for (int i = 0; i < num; ++i) {
+        args[i] = buildHelperValueCast(param[i], paramTypes[i]);
+    }
+    LValue call = buildCall(callee, args, num);
+    llvmAPI->SetInstructionCallConv(call, llvmAPI->GetFunctionCallConv(callee));
     return call;
 }
 
-LValue Output::buildTcgHelperCall(void* func, int num, LValue* param)
-{
-    LValue params[4 + num];
-    LValue funcVal = constIntPtr(reinterpret_cast<intptr_t>(func));
-    funcVal = buildCast(LLVMIntToPtr, funcVal, repo().ref8);
-    params[0] = constInt64(m_stackMapsId);
-    params[1] = constInt32(7);
-    params[2] = funcVal;
-    params[3] = constInt32(num);
-    for (int i = 4; i < num + 4; ++i) {
-        LValue p = param[i - 4];
-        params[i] = p;
+// a plain call of the helper at its address, typed by the sizemask it is
+// registered with: i64 where it says 64 bits, i32 elsewhere. The stack
+// maps only carry the dispatcher exits.
+LValue Output::buildHelperCall(void* func, int num, LValue* param, bool hasRet)
+{
+    LType retType = repo().voidType;
+    if (hasRet)
+        retType = qemu::helperIs64Bit(func, 0) ? repo().int64 : repo().int32;
+    if (LValue call = buildInlinedHelperCall(func, num, param)) {
+        if (!hasRet)
+            return call;
+        switch (llvmAPI->GetTypeKind(typeOf(call))) {
+        case LLVMFloatTypeKind:
+            return buildHelperValueCast(buildBitCast(call, repo().int32), retType);
+        case LLVMDoubleTypeKind:
+            return buildHelperValueCast(buildBitCast(call, repo().int64), retType);
+        default:
+            return buildHelperValueCast(call, retType);
+        }
+    }
+    LType paramTypes[num + 1];
+    LValue args[num + 1];
+    for (int i = 0; i < num; ++i) {
+        paramTypes[i] = qemu::helperIs64Bit(func, i + 1) ? repo().int64 : repo().int32;
+        args[i] = buildHelperValueCast(param[i], paramTypes[i]);
+    }
+    LType type = functionType(retType, paramTypes, num, NotVariadic);
+    LValue callee = buildCast(LLVMIntToPtr, constIntPtr(reinterpret_cast<uintptr_t>(func)), pointerType(type));
+    LValue call = buildCall(callee, args, num);
+
+    llvmAPI->AddInstrAttribute(call, functionAttributeIndex, LLVMNoUnwindAttribute);
+    if (!qemu::helperHasSideEffects(func)) {
+        if (!qemu::helperReadsGlobals(func))
+            llvmAPI->AddInstrAttribute(call, functionAttributeIndex, LLVMReadNoneAttribute);
+        else if (!qemu::helperWritesGlobals(func))
+            llvmAPI->AddInstrAttribute(call, functionAttributeIndex, LLVMReadOnlyAttribute);
     }
-    LValue call = buildCall(repo().patchpointInt64Intrinsic(), params, 4 + num);
-    // record the stack map info
-    m_stackMapsId++;
     return call;
 }
 
+LValue Output::buildTcgHelperCallNotRet(void* func, int num, LValue* param)
+{
+    return buildHelperCall(func, num, param, false);
+}
+
+LValue Output::buildTcgHelperCall(void* func, int num, LValue* param)
+{
+    return buildHelperCall(func, num, param, true);
+}
+
 LValue Output::buildLoadArgIndex(int index)
 {
     LValue constIndex[] = { constInt32(0), constInt32(index) };
-    return buildLoad(llvmAPI->BuildInBoundsGEP(m_builder, m_arg, constIndex, 2, ""));
+    LValue load = buildLoad(llvmAPI->BuildInBoundsGEP(m_builder, m_arg, constIndex, 2, ""));
+    tagEnvAccess(load);
+    return load;
 }
 
 LValue Output::buildStoreArgIndex(LValue val, int index)
 {
     LValue constIndex[] = { constInt32(0), constInt32(index) };
-    return buildStore(val, llvmAPI->BuildInBoundsGEP(m_builder, m_arg, constIndex, 2, ""));
+    LValue store = buildStore(val, llvmAPI->BuildInBoundsGEP(m_builder, m_arg, constIndex, 2, ""));
+    tagEnvAccess(store);
+    return store;
 }
 
 LValue Output::buildSelect(LValue condition, LValue taken, LValue notTaken)
@@ -345,11 +452,21 @@ LValue Output::buildSelect(LValue condition, LValue taken, LValue notTaken)
     return jit::buildSelect(m_builder, condition, taken, notTaken);
 }
 
+LValue Output::buildExtractValue(LValue aggVal, unsigned index)
+{
+    return jit::buildExtractValue(m_builder, aggVal, index);
+}
+
 LValue Output::buildICmp(LIntPredicate cond, LValue left, LValue right)
 {
     return jit::buildICmp(m_builder, cond, left, right);
 }
 
+LValue Output::buildFCmp(LRealPredicate cond, LValue left, LValue right)
+{
+    return jit::buildFCmp(m_builder, cond, left, right);
+}
+
 LValue Output::buildAtomicCmpXchg(LValue addr, LValue cmp, LValue val)
 {
     llvm::IRBuilder<>* builder = llvm::unwrap(m_builder);
@@ -362,6 +479,55 @@ LValue Output::buildAlloca(LType type)
     return llvmAPI->BuildAlloca(m_builder, type, "");
 }
 
+LValue Output::buildPrologueAlloca(LType type)
+{
+    llvmAPI->PositionBuilderAtEnd(m_builder, m_prologue);
+    LValue result = buildAlloca(type);
+    llvmAPI->PositionBuilderAtEnd(m_builder, m_current);
+    return result;
+}
+
+void Output::positionBefore(LValue instruction)
+{
+    m_current = llvmAPI->GetInstructionParent(instruction);
+    llvmAPI->PositionBuilderBefore(m_builder, instruction);
+}
+
+// struct-path TBAA: a scalar type per class under one root, and an access
+// tag !{type, type, 0} for each.
+void Output::buildTbaaTags()
+{
+    LContext context = m_state.m_context;
+    m_tbaaKind = mdKindID(context, "tbaa");
+    LValue rootOperands[] = { mdString(context, "qemu arm tbaa") };
+    LValue root = mdNode(context, rootOperands, 1);
+
+    LValue envTypeOperands[] = { mdString(context, "CPUARMState"), root, constInt64(0) };
+    LValue envType = mdNode(context, envTypeOperands, 3);
+    LValue envTagOperands[] = { envType, envType, constInt64(0) };
+    m_tbaaEnv = mdNode(context, envTagOperands, 3);
+
+    LValue guestTypeOperands[] = { mdString(context, "guest memory"), root, constInt64(0) };
+    LValue guestType = mdNode(context, guestTypeOperands, 3);
+    LValue guestTagOperands[] = { guestType, guestType, constInt64(0) };
+    m_tbaaGuest = mdNode(context, guestTagOperands, 3);
+}
+
+void Output::tagEnvAccess(LValue access)
+{
+    setMetadata(access, m_tbaaKind, m_tbaaEnv);
+}
+
+void Output::tagGuestAccess(LValue access)
+{
+    setMetadata(access, m_tbaaKind, m_tbaaGuest);
+}
+
+bool Output::isEnvAccess(LValue access)
+{
+    return llvmAPI->GetMetadata(access, m_tbaaKind) == m_tbaaEnv;
+}
+
 LType Output::typeOf(LValue val)
 {
     return llvmAPI->TypeOf(val);
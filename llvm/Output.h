@@ -3,6 +3,7 @@
 #include "IntrinsicRepository.h"
 namespace jit {
 class CompilerState;
+enum class PatchType;
 class Output {
 public:
     Output(CompilerState& state);
@@ -52,9 +53,19 @@ public:
     LValue buildLoadArgIndex(int index);
     LValue buildStoreArgIndex(LValue val, int index);
     LValue buildSelect(LValue condition, LValue taken, LValue notTaken);
+    LValue buildExtractValue(LValue aggVal, unsigned index);
     LValue buildICmp(LIntPredicate cond, LValue left, LValue right);
+    LValue buildFCmp(LRealPredicate cond, LValue left, LValue right);
     LValue buildAtomicCmpXchg(LValue addr, LValue cmp, LValue val);
     LValue buildAlloca(LType type);
+    // an alloca in the prologue, keeping the current position.
+    LValue buildPrologueAlloca(LType type);
+    void positionBefore(LValue instruction);
+    // TBAA tags for the alias analysis in the pipeline: accesses to
+    // CPUARMState and to guest memory never alias each other.
+    void tagEnvAccess(LValue access);
+    void tagGuestAccess(LValue access);
+    bool isEnvAccess(LValue access);
 
     inline LValue buildCall(LValue function, const LValue* args, unsigned numArgs)
     {
@@ -86,8 +97,15 @@ public:
     LValue buildBitCast(LLVMValueRef Val, LLVMTypeRef DestTy);
     LValue buildPhi(LType type);
 
-    void buildTcgDirectPatch(void);
-    void buildTcgIndirectPatch(void);
+    // pinned holds the pinnedRegisterCount guest registers the exit leaves
+    // in their host registers, see PinnedRegisters.h. The exit goes to the
+    // block at targetPc and targetFlags if hasTarget, link may chain it.
+    LValue buildTcgDirectPatch(const LValue* pinned, bool hasTarget, uint32_t targetPc, uint64_t targetFlags);
+    LValue buildTcgIndirectPatch(void);
+    // an exit to the deopt dispatcher, patched like an indirect exit.
+    LValue buildDeoptPatch(void);
+    // a branch to fail the profile says is almost never taken.
+    LValue buildGuardBr(LValue ok, LBasicBlock pass, LBasicBlock fail);
     LValue buildTcgHelperCallNotRet(void* func, int num, LValue* param);
     LValue buildTcgHelperCall(void* func, int num, LValue* param);
 
@@ -96,12 +114,20 @@ public:
     inline LBasicBlock prologue() const { return m_prologue; }
     inline LBasicBlock current() const { return m_current; }
     inline LValue arg() const { return m_arg; }
+    // the guest register pinnedGuestRegisters[index] at the chain entry.
+    LValue pinnedArg(size_t index);
     LType typeOf(LValue val) __attribute__((pure));
     inline bool currentBlockTerminated() const { return m_currentBlockTerminated; }
+    inline void setCurrentBlockTerminated() { m_currentBlockTerminated = true; }
 
 private:
     void buildGetArg();
     void buildPatchCommon(LValue where, const struct PatchDesc& desc, size_t patchSize);
+    LValue buildExitPatch(const struct PatchDesc& desc, const LValue* args, unsigned numArgs);
+    void buildTbaaTags();
+    LValue buildHelperCall(void* func, int num, LValue* param, bool hasRet);
+    LValue buildInlinedHelperCall(void* func, int num, LValue* param);
+    LValue buildHelperValueCast(LValue value, LType type);
 
     CompilerState& m_state;
     IntrinsicRepository m_repo;
@@ -111,6 +137,9 @@ private:
     LBasicBlock m_current;
     LValue m_arg;
     uint32_t m_stackMapsId;
+    unsigned m_tbaaKind;
+    LValue m_tbaaEnv;
+    LValue m_tbaaGuest;
     bool m_currentBlockTerminated;
 };
 }
@@ -0,0 +1,32 @@
+#ifndef PINNEDREGISTERS_H
+#define PINNEDREGISTERS_H
+#include <stddef.h>
+#include <stdint.h>
+#include "Registers.h"
+namespace jit {
+
+// How LLVM translations hand guest registers to each other. Besides env
+// in %ebp/%rbp, a direct exit leaves pinnedGuestRegisters[i] in
+// pinnedHostRegisters[i], the fastcc argument registers that follow env.
+// The chain entry of a translation takes them from there, the code entry
+// loads them from env first. Exits still write them to env, the chained
+// target may be a baseline block.
+#if defined(__x86_64__)
+// the argument registers, which loops and leaf calls keep busy, and sp.
+static const int pinnedGuestRegisters[] = { 0, 1, 2, 3, 13 };
+static const AMD64 pinnedHostRegisters[] = { RSI, RDX, RCX, R8, R9 };
+// movl disp8(%rbp), reg for each, r8d and r9d take a REX prefix.
+static const size_t pinnedLoadsSize = 3 * 3 + 2 * 4;
+// a push and a pop for each, at most 2 bytes.
+static const size_t pinnedMovesSize = 5 * 2 + 3 * 1 + 2 * 2;
+#else
+// fastcc has only %ecx and %edx, and env takes %ecx.
+static const int pinnedGuestRegisters[] = { 0 };
+static const AMD64 pinnedHostRegisters[] = { RDX };
+static const size_t pinnedLoadsSize = 3;
+static const size_t pinnedMovesSize = 2;
+#endif
+static const size_t pinnedRegisterCount = sizeof(pinnedGuestRegisters) / sizeof(pinnedGuestRegisters[0]);
+static_assert(sizeof(pinnedHostRegisters) / sizeof(pinnedHostRegisters[0]) == pinnedRegisterCount, "a host register for each pinned guest register");
+}
+#endif /* PINNEDREGISTERS_H */
@@ -0,0 +1,960 @@
+#include <string.h>
+#include "log.h"
+#include "tb.h"
+#include "RecordingDisasContext.h"
+
+namespace jit {
+
+// ops with a result and two operands of the same type.
+#define FOR_EACH_BINARY_OP(macro) \
+    macro(add_i32, TCGv_i32)      \
+    macro(add_i64, TCGv_i64)      \
+    macro(andc_i32, TCGv_i32)     \
+    macro(and_i32, TCGv_i32)      \
+    macro(and_i64, TCGv_i64)      \
+    macro(mul_i32, TCGv_i32)      \
+    macro(orc_i32, TCGv_i32)      \
+    macro(or_i32, TCGv_i32)       \
+    macro(or_i64, TCGv_i64)       \
+    macro(rotr_i32, TCGv_i32)     \
+    macro(sar_i32, TCGv_i32)      \
+    macro(shl_i32, TCGv_i32)      \
+    macro(shr_i32, TCGv_i32)      \
+    macro(sub_i32, TCGv_i32)      \
+    macro(sub_i64, TCGv_i64)      \
+    macro(xor_i32, TCGv_i32)      \
+    macro(xor_i64, TCGv_i64)
+
+// ops with a result, an operand of the same type and an immediate.
+#define FOR_EACH_IMMEDIATE_OP(macro)        \
+    macro(addi_i32, TCGv_i32, int32_t)      \
+    macro(addi_ptr, TCGv_ptr, int32_t)      \
+    macro(addi_i64, TCGv_i64, int64_t)      \
+    macro(andi_i32, TCGv_i32, uint32_t)     \
+    macro(andi_i64, TCGv_i64, int64_t)      \
+    macro(ori_i32, TCGv_i32, int32_t)       \
+    macro(rotri_i32, TCGv_i32, int32_t)     \
+    macro(sari_i32, TCGv_i32, int32_t)      \
+    macro(shli_i32, TCGv_i32, int32_t)      \
+    macro(shli_i64, TCGv_i64, int64_t)      \
+    macro(shri_i32, TCGv_i32, int32_t)      \
+    macro(shri_i64, TCGv_i64, int64_t)      \
+    macro(subi_i32, TCGv_i32, int32_t)      \
+    macro(xori_i32, TCGv_i32, int32_t)
+
+// ops with a result and one operand.
+#define FOR_EACH_UNARY_OP(macro)                \
+    macro(bswap16_i32, TCGv_i32, TCGv_i32)      \
+    macro(bswap32_i32, TCGv_i32, TCGv_i32)      \
+    macro(ext16s_i32, TCGv_i32, TCGv_i32)       \
+    macro(ext16u_i32, TCGv_i32, TCGv_i32)       \
+    macro(ext32u_i64, TCGv_i64, TCGv_i64)       \
+    macro(ext8s_i32, TCGv_i32, TCGv_i32)        \
+    macro(ext8u_i32, TCGv_i32, TCGv_i32)        \
+    macro(ext_i32_i64, TCGv_i64, TCGv_i32)      \
+    macro(extu_i32_i64, TCGv_i64, TCGv_i32)     \
+    macro(mov_i32, TCGv_i32, TCGv_i32)          \
+    macro(mov_i64, TCGv_i64, TCGv_i64)          \
+    macro(neg_i32, TCGv_i32, TCGv_i32)          \
+    macro(neg_i64, TCGv_i64, TCGv_i64)          \
+    macro(not_i32, TCGv_i32, TCGv_i32)          \
+    macro(trunc_i64_i32, TCGv_i32, TCGv_i64)
+
+// guest memory accesses.
+#define FOR_EACH_QEMU_MEMORY_OP(macro) \
+    macro(qemu_ld_i32, TCGv_i32)       \
+    macro(qemu_ld_i64, TCGv_i64)       \
+    macro(qemu_st_i32, TCGv_i32)       \
+    macro(qemu_st_i64, TCGv_i64)
+
+// env accesses.
+#define FOR_EACH_MEMORY_OP(macro)                \
+    macro(ld_i32, TCGv_i32, tcg_target_long)     \
+    macro(ld_i64, TCGv_i64, target_long)         \
+    macro(st_i32, TCGv_i32, tcg_target_long)     \
+    macro(st_i64, TCGv_i64, target_long)
+
+namespace {
+enum Op {
+#define OP_ENUM(name, ...) Op_##name,
+    FOR_EACH_BINARY_OP(OP_ENUM)
+    FOR_EACH_IMMEDIATE_OP(OP_ENUM)
+    FOR_EACH_UNARY_OP(OP_ENUM)
+    FOR_EACH_QEMU_MEMORY_OP(OP_ENUM)
+    FOR_EACH_MEMORY_OP(OP_ENUM)
+#undef OP_ENUM
+    Op_new_label,
+    Op_set_label,
+    Op_global_mem_new_i32,
+    Op_global_mem_new_i64,
+    Op_global_reg_new_ptr,
+    Op_const_i32,
+    Op_const_ptr,
+    Op_const_i64,
+    Op_temp_local_new_i32,
+    Op_temp_new_i32,
+    Op_temp_new_ptr,
+    Op_temp_new_i64,
+    Op_temp_free_i32,
+    Op_temp_free_i64,
+    Op_temp_free_ptr,
+    Op_add2_i32,
+    Op_add_cc_i32,
+    Op_sub_cc_i32,
+    Op_muls2_i32,
+    Op_mulu2_i32,
+    Op_brcondi_i32,
+    Op_concat_i32_i64,
+    Op_deposit_i32,
+    Op_movcond_i32,
+    Op_movcond_i64,
+    Op_movi_i32,
+    Op_movi_i64,
+    Op_setcond_i32,
+    Op_exit_tb,
+    Op_goto_tb,
+    Op_exit_indirect,
+    Op_callN,
+    Op_func_start,
+    Op_insn_start,
+};
+}
+
+// an immediate takes one word per 32 bits.
+template <typename Type>
+static inline size_t immediateWords()
+{
+    return (sizeof(Type) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+}
+
+// handles are pointers, or TCGArg integers in helper calls.
+template <typename Handle>
+static inline uintptr_t handleBits(Handle handle)
+{
+    return (uintptr_t)handle;
+}
+
+class OpRecording::Reader {
+public:
+    Reader(const OpRecording& recording)
+        : m_recording(recording)
+        , m_current(recording.m_words.data())
+        , m_end(recording.m_words.data() + recording.m_words.size())
+        , m_values(recording.m_valueCount)
+        , m_labels(recording.m_labelCount)
+    {
+    }
+    inline bool done() const { return m_current == m_end; }
+    inline uint32_t word()
+    {
+        EMASSERT(m_current < m_end);
+        return *m_current++;
+    }
+    template <typename Type>
+    Type immediate()
+    {
+        uint32_t words[2] = { 0, 0 };
+        for (size_t i = 0; i < immediateWords<Type>(); ++i)
+            words[i] = word();
+        Type value;
+        memcpy(&value, words, sizeof(Type));
+        return value;
+    }
+    template <typename Handle>
+    Handle value()
+    {
+        uint32_t index = word();
+        EMASSERT(index < m_values.size());
+        return (Handle)m_values[index];
+    }
+    template <typename Handle>
+    Handle define(Handle handle)
+    {
+        uint32_t index = word();
+        EMASSERT(index < m_values.size());
+        m_values[index] = handleBits(handle);
+        return handle;
+    }
+    inline const char* name()
+    {
+        uint32_t index = word();
+        EMASSERT(index < m_recording.m_names.size());
+        return m_recording.m_names[index];
+    }
+    inline void* helper()
+    {
+        uint32_t index = word();
+        EMASSERT(index < m_recording.m_helpers.size());
+        return m_recording.m_helpers[index];
+    }
+    inline int label()
+    {
+        uint32_t index = word();
+        EMASSERT(index < m_labels.size());
+        return m_labels[index];
+    }
+    inline void defineLabel(int label)
+    {
+        uint32_t index = word();
+        EMASSERT(index < m_labels.size());
+        m_labels[index] = label;
+    }
+
+private:
+    const OpRecording& m_recording;
+    const uint32_t* m_current;
+    const uint32_t* m_end;
+    std::vector<uintptr_t> m_values;
+    std::vector<int> m_labels;
+};
+
+OpRecording::OpRecording()
+{
+    clear();
+}
+
+void OpRecording::clear()
+{
+    m_words.clear();
+    m_names.clear();
+    m_helpers.clear();
+    m_valueCount = 0;
+    m_labelCount = 0;
+    m_pc = 0;
+    m_flags = 0;
+    m_size = 0;
+    m_icount = 0;
+}
+
+void OpRecording::replay(DisasContextBase& target, TranslationBlock* tb) const
+{
+    Reader r(*this);
+    while (!r.done()) {
+        switch (r.word()) {
+#define REPLAY_BINARY(name, Type)           \
+    case Op_##name: {                       \
+        Type ret = r.value<Type>();         \
+        Type arg1 = r.value<Type>();        \
+        Type arg2 = r.value<Type>();        \
+        target.gen_##name(ret, arg1, arg2); \
+        break;                              \
+    }
+            FOR_EACH_BINARY_OP(REPLAY_BINARY)
+#undef REPLAY_BINARY
+#define REPLAY_IMMEDIATE(name, Type, ImmediateType)         \
+    case Op_##name: {                                       \
+        Type ret = r.value<Type>();                         \
+        Type arg1 = r.value<Type>();                        \
+        ImmediateType arg2 = r.immediate<ImmediateType>();  \
+        target.gen_##name(ret, arg1, arg2);                 \
+        break;                                              \
+    }
+            FOR_EACH_IMMEDIATE_OP(REPLAY_IMMEDIATE)
+#undef REPLAY_IMMEDIATE
+#define REPLAY_UNARY(name, Type, ArgType) \
+    case Op_##name: {                     \
+        Type ret = r.value<Type>();       \
+        ArgType arg = r.value<ArgType>(); \
+        target.gen_##name(ret, arg);      \
+        break;                            \
+    }
+            FOR_EACH_UNARY_OP(REPLAY_UNARY)
+#undef REPLAY_UNARY
+#define REPLAY_QEMU_MEMORY(name, Type)                                    \
+    case Op_##name: {                                                     \
+        Type val = r.value<Type>();                                       \
+        TCGv addr = r.value<TCGv>();                                      \
+        TCGArg idx = r.immediate<TCGArg>();                               \
+        TCGMemOp memop = static_cast<TCGMemOp>(r.word());                 \
+        target.gen_##name(val, addr, idx, memop);                         \
+        break;                                                            \
+    }
+            FOR_EACH_QEMU_MEMORY_OP(REPLAY_QEMU_MEMORY)
+#undef REPLAY_QEMU_MEMORY
+#define REPLAY_MEMORY(name, Type, OffsetType)                \
+    case Op_##name: {                                        \
+        Type val = r.value<Type>();                          \
+        TCGv_ptr base = r.value<TCGv_ptr>();                 \
+        OffsetType offset = r.immediate<OffsetType>();       \
+        target.gen_##name(val, base, offset);                \
+        break;                                               \
+    }
+            FOR_EACH_MEMORY_OP(REPLAY_MEMORY)
+#undef REPLAY_MEMORY
+        case Op_new_label:
+            r.defineLabel(target.gen_new_label());
+            break;
+        case Op_set_label:
+            target.gen_set_label(r.label());
+            break;
+        case Op_global_mem_new_i32: {
+            int reg = r.immediate<int>();
+            intptr_t offset = r.immediate<intptr_t>();
+            const char* name = r.name();
+            r.define(target.global_mem_new_i32(reg, offset, name));
+            break;
+        }
+        case Op_global_mem_new_i64: {
+            int reg = r.immediate<int>();
+            intptr_t offset = r.immediate<intptr_t>();
+            const char* name = r.name();
+            r.define(target.global_mem_new_i64(reg, offset, name));
+            break;
+        }
+        case Op_global_reg_new_ptr: {
+            int reg = r.immediate<int>();
+            const char* name = r.name();
+            r.define(target.global_reg_new_ptr(reg, name));
+            break;
+        }
+        case Op_const_i32: {
+            int32_t val = r.immediate<int32_t>();
+            r.define(target.const_i32(val));
+            break;
+        }
+        case Op_const_ptr: {
+            const void* val = r.immediate<const void*>();
+            r.define(target.const_ptr(val));
+            break;
+        }
+        case Op_const_i64: {
+            int64_t val = r.immediate<int64_t>();
+            r.define(target.const_i64(val));
+            break;
+        }
+        case Op_temp_local_new_i32:
+            r.define(target.temp_local_new_i32());
+            break;
+        case Op_temp_new_i32:
+            r.define(target.temp_new_i32());
+            break;
+        case Op_temp_new_ptr:
+            r.define(target.temp_new_ptr());
+            break;
+        case Op_temp_new_i64:
+            r.define(target.temp_new_i64());
+            break;
+        case Op_temp_free_i32:
+            target.temp_free_i32(r.value<TCGv_i32>());
+            break;
+        case Op_temp_free_i64:
+            target.temp_free_i64(r.value<TCGv_i64>());
+            break;
+        case Op_temp_free_ptr:
+            target.temp_free_ptr(r.value<TCGv_ptr>());
+            break;
+        case Op_add2_i32: {
+            TCGv_i32 v[6];
+            for (int i = 0; i < 6; ++i)
+                v[i] = r.value<TCGv_i32>();
+            target.gen_add2_i32(v[0], v[1], v[2], v[3], v[4], v[5]);
+            break;
+        }
+        case Op_add_cc_i32: {
+            TCGv_i32 v[7];
+            for (int i = 0; i < 7; ++i)
+                v[i] = r.value<TCGv_i32>();
+            target.gen_add_cc_i32(v[0], v[1], v[2], v[3], v[4], v[5], v[6], r.word());
+            break;
+        }
+        case Op_sub_cc_i32: {
+            TCGv_i32 v[7];
+            for (int i = 0; i < 7; ++i)
+                v[i] = r.value<TCGv_i32>();
+            target.gen_sub_cc_i32(v[0], v[1], v[2], v[3], v[4], v[5], v[6], r.word());
+            break;
+        }
+        case Op_muls2_i32: {
+            TCGv_i32 v[4];
+            for (int i = 0; i < 4; ++i)
+                v[i] = r.value<TCGv_i32>();
+            target.gen_muls2_i32(v[0], v[1], v[2], v[3]);
+            break;
+        }
+        case Op_mulu2_i32: {
+            TCGv_i32 v[4];
+            for (int i = 0; i < 4; ++i)
+                v[i] = r.value<TCGv_i32>();
+            target.gen_mulu2_i32(v[0], v[1], v[2], v[3]);
+            break;
+        }
+        case Op_brcondi_i32: {
+            TCGCond cond = static_cast<TCGCond>(r.word());
+            TCGv_i32 arg1 = r.value<TCGv_i32>();
+            int32_t arg2 = r.immediate<int32_t>();
+            target.gen_brcondi_i32(cond, arg1, arg2, r.label());
+            break;
+        }
+        case Op_concat_i32_i64: {
+            TCGv_i64 dest = r.value<TCGv_i64>();
+            TCGv_i32 low = r.value<TCGv_i32>();
+            TCGv_i32 high = r.value<TCGv_i32>();
+            target.gen_concat_i32_i64(dest, low, high);
+            break;
+        }
+        case Op_deposit_i32: {
+            TCGv_i32 ret = r.value<TCGv_i32>();
+            TCGv_i32 arg1 = r.value<TCGv_i32>();
+            TCGv_i32 arg2 = r.value<TCGv_i32>();
+            unsigned ofs = r.word();
+            unsigned len = r.word();
+            target.gen_deposit_i32(ret, arg1, arg2, ofs, len);
+            break;
+        }
+        case Op_movcond_i32: {
+            TCGCond cond = static_cast<TCGCond>(r.word());
+            TCGv_i32 v[5];
+            for (int i = 0; i < 5; ++i)
+                v[i] = r.value<TCGv_i32>();
+            target.gen_movcond_i32(cond, v[0], v[1], v[2], v[3], v[4]);
+            break;
+        }
+        case Op_movcond_i64: {
+            TCGCond cond = static_cast<TCGCond>(r.word());
+            TCGv_i64 v[5];
+            for (int i = 0; i < 5; ++i)
+                v[i] = r.value<TCGv_i64>();
+            target.gen_movcond_i64(cond, v[0], v[1], v[2], v[3], v[4]);
+            break;
+        }
+        case Op_movi_i32: {
+            TCGv_i32 ret = r.value<TCGv_i32>();
+            target.gen_movi_i32(ret, r.immediate<int32_t>());
+            break;
+        }
+        case Op_movi_i64: {
+            TCGv_i64 ret = r.value<TCGv_i64>();
+            target.gen_movi_i64(ret, r.immediate<int64_t>());
+            break;
+        }
+        case Op_setcond_i32: {
+            TCGCond cond = static_cast<TCGCond>(r.word());
+            TCGv_i32 ret = r.value<TCGv_i32>();
+            TCGv_i32 arg1 = r.value<TCGv_i32>();
+            TCGv_i32 arg2 = r.value<TCGv_i32>();
+            target.gen_setcond_i32(cond, ret, arg1, arg2);
+            break;
+        }
+        case Op_exit_tb:
+            target.gen_exit_tb(r.immediate<int>());
+            break;
+        case Op_goto_tb: {
+            target_ulong dest = r.immediate<target_ulong>();
+            target.gen_goto_tb(dest, r.immediate<bool>());
+            break;
+        }
+        case Op_exit_indirect:
+            target.gen_exit_indirect();
+            break;
+        case Op_callN: {
+            void* func = r.helper();
+            bool hasRet = r.immediate<bool>();
+            TCGArg ret = hasRet ? r.value<TCGArg>() : TCG_CALL_DUMMY_ARG;
+            int nargs = r.immediate<int>();
+            std::vector<TCGArg> args(nargs);
+            for (int i = 0; i < nargs; ++i)
+                args[i] = r.value<TCGArg>();
+            target.gen_callN(func, ret, nargs, args.data());
+            break;
+        }
+        case Op_func_start:
+            target.func_start();
+            break;
+        case Op_insn_start: {
+            target_ulong pc = r.immediate<target_ulong>();
+            target.gen_insn_start(pc, r.immediate<uint32_t>());
+            break;
+        }
+        default:
+            EMUNREACHABLE();
+        }
+    }
+    tb->size = m_size;
+    tb->icount = m_icount;
+}
+
+RecordingDisasContext::RecordingDisasContext(DisasContextBase& inner, OpRecording& recording)
+    : m_inner(inner)
+    , m_recording(recording)
+    , m_words(&recording.m_words)
+{
+    m_recording.clear();
+}
+
+void RecordingDisasContext::finish(const TranslationBlock& tb)
+{
+    m_recording.m_pc = tb.pc;
+    m_recording.m_flags = tb.flags;
+    m_recording.m_size = tb.size;
+    m_recording.m_icount = tb.icount;
+}
+
+void RecordingDisasContext::emit(int op)
+{
+    m_words->push_back(op);
+}
+
+template <typename Type>
+void RecordingDisasContext::immediate(Type value)
+{
+    uint32_t words[2] = { 0, 0 };
+    memcpy(words, &value, sizeof(Type));
+    for (size_t i = 0; i < immediateWords<Type>(); ++i)
+        m_words->push_back(words[i]);
+}
+
+// inner may hand out a freed handle again, the new value takes its key.
+template <typename Handle>
+void RecordingDisasContext::define(Handle handle)
+{
+    uint32_t index = m_recording.m_valueCount++;
+    m_values[handleBits(handle)] = index;
+    m_words->push_back(index);
+}
+
+template <typename Handle>
+void RecordingDisasContext::use(Handle handle)
+{
+    auto found = m_values.find(handleBits(handle));
+    EMASSERT(found != m_values.end());
+    m_words->push_back(found->second);
+}
+
+// the index of p in table, added on first use.
+template <typename Pointer>
+uint32_t RecordingDisasContext::intern(std::vector<Pointer>& table, std::unordered_map<const void*, uint32_t>& index, Pointer p)
+{
+    auto result = index.insert(std::make_pair(p, static_cast<uint32_t>(table.size())));
+    if (result.second)
+        table.push_back(p);
+    return result.first->second;
+}
+
+void RecordingDisasContext::label(int inner)
+{
+    auto found = m_labels.find(inner);
+    EMASSERT(found != m_labels.end());
+    m_words->push_back(found->second);
+}
+
+void RecordingDisasContext::compile()
+{
+    m_inner.compile();
+}
+
+void RecordingDisasContext::link()
+{
+    m_inner.link();
+}
+
+int RecordingDisasContext::gen_new_label()
+{
+    int n = m_inner.gen_new_label();
+    emit(Op_new_label);
+    uint32_t index = m_recording.m_labelCount++;
+    m_labels[n] = index;
+    m_words->push_back(index);
+    return n;
+}
+
+void RecordingDisasContext::gen_set_label(int n)
+{
+    m_inner.gen_set_label(n);
+    emit(Op_set_label);
+    label(n);
+}
+
+TCGv_i64 RecordingDisasContext::global_mem_new_i64(int reg, intptr_t offset, const char* name)
+{
+    TCGv_i64 v = m_inner.global_mem_new_i64(reg, offset, name);
+    emit(Op_global_mem_new_i64);
+    immediate(reg);
+    immediate(offset);
+    m_words->push_back(intern(m_recording.m_names, m_nameIndex, name));
+    define(v);
+    return v;
+}
+
+TCGv_i32 RecordingDisasContext::global_mem_new_i32(int reg, intptr_t offset, const char* name)
+{
+    TCGv_i32 v = m_inner.global_mem_new_i32(reg, offset, name);
+    emit(Op_global_mem_new_i32);
+    immediate(reg);
+    immediate(offset);
+    m_words->push_back(intern(m_recording.m_names, m_nameIndex, name));
+    define(v);
+    return v;
+}
+
+TCGv_ptr RecordingDisasContext::global_reg_new_ptr(int reg, const char* name)
+{
+    TCGv_ptr v = m_inner.global_reg_new_ptr(reg, name);
+    emit(Op_global_reg_new_ptr);
+    immediate(reg);
+    m_words->push_back(intern(m_recording.m_names, m_nameIndex, name));
+    define(v);
+    return v;
+}
+
+TCGv_i32 RecordingDisasContext::const_i32(int32_t val)
+{
+    TCGv_i32 v = m_inner.const_i32(val);
+    emit(Op_const_i32);
+    immediate(val);
+    define(v);
+    return v;
+}
+
+TCGv_ptr RecordingDisasContext::const_ptr(const void* val)
+{
+    TCGv_ptr v = m_inner.const_ptr(val);
+    emit(Op_const_ptr);
+    immediate(val);
+    define(v);
+    return v;
+}
+
+TCGv_i64 RecordingDisasContext::const_i64(int64_t val)
+{
+    TCGv_i64 v = m_inner.const_i64(val);
+    emit(Op_const_i64);
+    immediate(val);
+    define(v);
+    return v;
+}
+
+#define RECORD_BINARY(name, Type)                                               \
+    void RecordingDisasContext::gen_##name(Type ret, Type arg1, Type arg2)     \
+    {                                                                           \
+        m_inner.gen_##name(ret, arg1, arg2);                                    \
+        emit(Op_##name);                                                        \
+        use(ret);                                                               \
+        use(arg1);                                                              \
+        use(arg2);                                                              \
+    }
+FOR_EACH_BINARY_OP(RECORD_BINARY)
+#undef RECORD_BINARY
+
+#define RECORD_IMMEDIATE(name, Type, ImmediateType)                                     \
+    void RecordingDisasContext::gen_##name(Type ret, Type arg1, ImmediateType arg2)    \
+    {                                                                                   \
+        m_inner.gen_##name(ret, arg1, arg2);                                            \
+        emit(Op_##name);                                                                \
+        use(ret);                                                                       \
+        use(arg1);                                                                      \
+        immediate(arg2);                                                                \
+    }
+FOR_EACH_IMMEDIATE_OP(RECORD_IMMEDIATE)
+#undef RECORD_IMMEDIATE
+
+#define RECORD_UNARY(name, Type, ArgType)                             \
+    void RecordingDisasContext::gen_##name(Type ret, ArgType arg)    \
+    {                                                                 \
+        m_inner.gen_##name(ret, arg);                                 \
+        emit(Op_##name);                                              \
+        use(ret);                                                     \
+        use(arg);                                                     \
+    }
+FOR_EACH_UNARY_OP(RECORD_UNARY)
+#undef RECORD_UNARY
+
+#define RECORD_QEMU_MEMORY(name, Type)                                                          \
+    void RecordingDisasContext::gen_##name(Type val, TCGv addr, TCGArg idx, TCGMemOp memop)    \
+    {                                                                                           \
+        m_inner.gen_##name(val, addr, idx, memop);                                              \
+        emit(Op_##name);                                                                        \
+        use(val);                                                                               \
+        use(addr);                                                                              \
+        immediate(idx);                                                                         \
+        m_words->push_back(memop);                                                   \
+    }
+FOR_EACH_QEMU_MEMORY_OP(RECORD_QEMU_MEMORY)
+#undef RECORD_QEMU_MEMORY
+
+#define RECORD_MEMORY(name, Type, OffsetType)                                         \
+    void RecordingDisasContext::gen_##name(Type val, TCGv_ptr base, OffsetType offset) \
+    {                                                                                 \
+        m_inner.gen_##name(val, base, offset);                                        \
+        emit(Op_##name);                                                              \
+        use(val);                                                                     \
+        use(base);                                                                    \
+        immediate(offset);                                                            \
+    }
+FOR_EACH_MEMORY_OP(RECORD_MEMORY)
+#undef RECORD_MEMORY
+
+void RecordingDisasContext::gen_add2_i32(TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
+    TCGv_i32 ah, TCGv_i32 bl, TCGv_i32 bh)
+{
+    m_inner.gen_add2_i32(rl, rh, al, ah, bl, bh);
+    emit(Op_add2_i32);
+    use(rl);
+    use(rh);
+    use(al);
+    use(ah);
+    use(bl);
+    use(bh);
+}
+
+#define RECORD_CC(name)                                                           \
+    void RecordingDisasContext::gen_##name(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf, \
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry)         \
+    {                                                                             \
+        m_inner.gen_##name(nf, zf, cf, vf, dest, t0, t1, carry);                  \
+        emit(Op_##name);                                                          \
+        use(nf);                                                                  \
+        use(zf);                                                                  \
+        use(cf);                                                                  \
+        use(vf);                                                                  \
+        use(dest);                                                                \
+        use(t0);                                                                  \
+        use(t1);                                                                  \
+        m_words->push_back(carry);                                                \
+    }
+RECORD_CC(add_cc_i32)
+RECORD_CC(sub_cc_i32)
+#undef RECORD_CC
+
+void RecordingDisasContext::gen_muls2_i32(TCGv_i32 rl, TCGv_i32 rh,
+    TCGv_i32 arg1, TCGv_i32 arg2)
+{
+    m_inner.gen_muls2_i32(rl, rh, arg1, arg2);
+    emit(Op_muls2_i32);
+    use(rl);
+    use(rh);
+    use(arg1);
+    use(arg2);
+}
+
+void RecordingDisasContext::gen_mulu2_i32(TCGv_i32 rl, TCGv_i32 rh,
+    TCGv_i32 arg1, TCGv_i32 arg2)
+{
+    m_inner.gen_mulu2_i32(rl, rh, arg1, arg2);
+    emit(Op_mulu2_i32);
+    use(rl);
+    use(rh);
+    use(arg1);
+    use(arg2);
+}
+
+void RecordingDisasContext::gen_brcondi_i32(TCGCond cond, TCGv_i32 arg1,
+    int32_t arg2, int label_index)
+{
+    m_inner.gen_brcondi_i32(cond, arg1, arg2, label_index);
+    emit(Op_brcondi_i32);
+    m_words->push_back(cond);
+    use(arg1);
+    immediate(arg2);
+    label(label_index);
+}
+
+void RecordingDisasContext::gen_concat_i32_i64(TCGv_i64 dest, TCGv_i32 low,
+    TCGv_i32 high)
+{
+    m_inner.gen_concat_i32_i64(dest, low, high);
+    emit(Op_concat_i32_i64);
+    use(dest);
+    use(low);
+    use(high);
+}
+
+void RecordingDisasContext::gen_deposit_i32(TCGv_i32 ret, TCGv_i32 arg1,
+    TCGv_i32 arg2, unsigned int ofs,
+    unsigned int len)
+{
+    m_inner.gen_deposit_i32(ret, arg1, arg2, ofs, len);
+    emit(Op_deposit_i32);
+    use(ret);
+    use(arg1);
+    use(arg2);
+    m_words->push_back(ofs);
+    m_words->push_back(len);
+}
+
+void RecordingDisasContext::gen_exit_tb(int direct)
+{
+    m_inner.gen_exit_tb(direct);
+    emit(Op_exit_tb);
+    immediate(direct);
+}
+
+void RecordingDisasContext::gen_goto_tb(target_ulong dest, bool link)
+{
+    m_inner.gen_goto_tb(dest, link);
+    emit(Op_goto_tb);
+    immediate(dest);
+    immediate(link);
+}
+
+void RecordingDisasContext::gen_exit_indirect()
+{
+    m_inner.gen_exit_indirect();
+    emit(Op_exit_indirect);
+}
+
+void RecordingDisasContext::gen_movcond_i32(TCGCond cond, TCGv_i32 ret,
+    TCGv_i32 c1, TCGv_i32 c2,
+    TCGv_i32 v1, TCGv_i32 v2)
+{
+    m_inner.gen_movcond_i32(cond, ret, c1, c2, v1, v2);
+    emit(Op_movcond_i32);
+    m_words->push_back(cond);
+    use(ret);
+    use(c1);
+    use(c2);
+    use(v1);
+    use(v2);
+}
+
+void RecordingDisasContext::gen_movcond_i64(TCGCond cond, TCGv_i64 ret,
+    TCGv_i64 c1, TCGv_i64 c2,
+    TCGv_i64 v1, TCGv_i64 v2)
+{
+    m_inner.gen_movcond_i64(cond, ret, c1, c2, v1, v2);
+    emit(Op_movcond_i64);
+    m_words->push_back(cond);
+    use(ret);
+    use(c1);
+    use(c2);
+    use(v1);
+    use(v2);
+}
+
+void RecordingDisasContext::gen_movi_i32(TCGv_i32 ret, int32_t arg)
+{
+    m_inner.gen_movi_i32(ret, arg);
+    emit(Op_movi_i32);
+    use(ret);
+    immediate(arg);
+}
+
+void RecordingDisasContext::gen_movi_i64(TCGv_i64 ret, int64_t arg)
+{
+    m_inner.gen_movi_i64(ret, arg);
+    emit(Op_movi_i64);
+    use(ret);
+    immediate(arg);
+}
+
+void RecordingDisasContext::gen_setcond_i32(TCGCond cond, TCGv_i32 ret,
+    TCGv_i32 arg1, TCGv_i32 arg2)
+{
+    m_inner.gen_setcond_i32(cond, ret, arg1, arg2);
+    emit(Op_setcond_i32);
+    m_words->push_back(cond);
+    use(ret);
+    use(arg1);
+    use(arg2);
+}
+
+TCGv_i32 RecordingDisasContext::temp_local_new_i32()
+{
+    TCGv_i32 v = m_inner.temp_local_new_i32();
+    emit(Op_temp_local_new_i32);
+    define(v);
+    return v;
+}
+
+TCGv_i32 RecordingDisasContext::temp_new_i32()
+{
+    TCGv_i32 v = m_inner.temp_new_i32();
+    emit(Op_temp_new_i32);
+    define(v);
+    return v;
+}
+
+TCGv_ptr RecordingDisasContext::temp_new_ptr()
+{
+    TCGv_ptr v = m_inner.temp_new_ptr();
+    emit(Op_temp_new_ptr);
+    define(v);
+    return v;
+}
+
+TCGv_i64 RecordingDisasContext::temp_new_i64()
+{
+    TCGv_i64 v = m_inner.temp_new_i64();
+    emit(Op_temp_new_i64);
+    define(v);
+    return v;
+}
+
+void RecordingDisasContext::temp_free_i32(TCGv_i32 a)
+{
+    m_inner.temp_free_i32(a);
+    emit(Op_temp_free_i32);
+    use(a);
+}
+
+void RecordingDisasContext::temp_free_i64(TCGv_i64 a)
+{
+    m_inner.temp_free_i64(a);
+    emit(Op_temp_free_i64);
+    use(a);
+}
+
+void RecordingDisasContext::temp_free_ptr(TCGv_ptr a)
+{
+    m_inner.temp_free_ptr(a);
+    emit(Op_temp_free_ptr);
+    use(a);
+}
+
+void RecordingDisasContext::gen_callN(void* func, TCGArg ret,
+    int nargs, TCGArg* args)
+{
+    m_inner.gen_callN(func, ret, nargs, args);
+    emit(Op_callN);
+    m_words->push_back(intern(m_recording.m_helpers, m_helperIndex, func));
+    immediate(ret != TCG_CALL_DUMMY_ARG);
+    if (ret != TCG_CALL_DUMMY_ARG)
+        use(ret);
+    immediate(nargs);
+    for (int i = 0; i < nargs; ++i)
+        use(args[i]);
+}
+
+// the calls still go to inner, and values defined meanwhile keep their
+// numbers, which replay never sees defined nor used.
+void RecordingDisasContext::begin_baseline_only()
+{
+    m_inner.begin_baseline_only();
+    m_words = &m_skipped;
+}
+
+void RecordingDisasContext::end_baseline_only()
+{
+    m_inner.end_baseline_only();
+    m_skipped.clear();
+    m_words = &m_recording.m_words;
+}
+
+void RecordingDisasContext::func_start()
+{
+    m_inner.func_start();
+    emit(Op_func_start);
+}
+
+bool RecordingDisasContext::should_continue()
+{
+    return m_inner.should_continue();
+}
+
+void RecordingDisasContext::gen_insn_start(target_ulong pc, uint32_t condexec)
+{
+    m_inner.gen_insn_start(pc, condexec);
+    emit(Op_insn_start);
+    immediate(pc);
+    immediate(condexec);
+}
+
+const uint8_t* RecordingDisasContext::guest_state_map()
+{
+    return m_inner.guest_state_map();
+}
+
+void* RecordingDisasContext::code_entry()
+{
+    return m_inner.code_entry();
+}
+}
@@ -0,0 +1,197 @@
+#ifndef RECORDINGDISASCONTEXT_H
+#define RECORDINGDISASCONTEXT_H
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "DisasContextBase.h"
+namespace jit {
+
+// The gen_* calls translate.c made for one block, in a word stream.
+// Temps, constants and globals are numbered in creation order, labels
+// likewise, so any DisasContextBase can generate the block again without
+// decoding the guest code, which may have changed since. Global names and
+// helpers are indices into side tables, which is what lets OpCapture
+// store a recording outside the process.
+class OpRecording {
+public:
+    OpRecording();
+    void clear();
+    inline bool empty() const { return m_words.empty(); }
+    // whether this is the block translate would decode at pc with flags.
+    inline bool matches(target_ulong pc, uint64_t flags) const { return !empty() && m_pc == pc && m_flags == flags; }
+    inline target_ulong pc() const { return m_pc; }
+    inline uint64_t flags() const { return m_flags; }
+    inline uint32_t icount() const { return m_icount; }
+    // make the calls on target and set size and icount of tb as decoding
+    // the block would.
+    void replay(DisasContextBase& target, TranslationBlock* tb) const;
+
+private:
+    friend class RecordingDisasContext;
+    friend class CaptureWriter;
+    friend class CaptureReader;
+    class Reader;
+    std::vector<uint32_t> m_words;
+    std::vector<const char*> m_names;
+    std::vector<void*> m_helpers;
+    uint32_t m_valueCount;
+    uint32_t m_labelCount;
+    target_ulong m_pc;
+    uint64_t m_flags;
+    uint16_t m_size;
+    uint32_t m_icount;
+};
+
+// Passes every call on to inner and records it into an OpRecording, so
+// the baseline pays for decoding once and keeps the stream for the LLVM
+// tier. Queries such as should_continue are answered by inner, which
+// therefore decides where the block ends.
+class RecordingDisasContext : public DisasContextBase {
+public:
+    RecordingDisasContext(DisasContextBase& inner, OpRecording& recording);
+    // store the block description once translate.c is done with tb.
+    void finish(const TranslationBlock& tb);
+
+    virtual void compile() override;
+    virtual void link() override;
+
+    virtual int gen_new_label() override;
+    virtual void gen_set_label(int n) override;
+    virtual TCGv_i64 global_mem_new_i64(int reg, intptr_t offset, const char* name) override;
+    virtual TCGv_i32 global_mem_new_i32(int reg, intptr_t offset, const char* name) override;
+    virtual TCGv_ptr global_reg_new_ptr(int reg, const char* name) override;
+
+    virtual TCGv_i32 const_i32(int32_t val) override;
+    virtual TCGv_ptr const_ptr(const void* val) override;
+    virtual TCGv_i64 const_i64(int64_t val) override;
+
+    virtual void gen_add2_i32(TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
+        TCGv_i32 ah, TCGv_i32 bl, TCGv_i32 bh) override;
+    virtual void gen_add_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry) override;
+    virtual void gen_sub_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry) override;
+
+    virtual void gen_add_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_add_i64(TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2) override;
+    virtual void gen_addi_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2) override;
+    virtual void gen_addi_ptr(TCGv_ptr ret, TCGv_ptr arg1, int32_t arg2) override;
+    virtual void gen_addi_i64(TCGv_i64 ret, TCGv_i64 arg1, int64_t arg2) override;
+    virtual void gen_andc_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_and_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_and_i64(TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2) override;
+    virtual void gen_andi_i32(TCGv_i32 ret, TCGv_i32 arg1, uint32_t arg2) override;
+    virtual void gen_andi_i64(TCGv_i64 ret, TCGv_i64 arg1, int64_t arg2) override;
+    virtual void gen_brcondi_i32(TCGCond cond, TCGv_i32 arg1,
+        int32_t arg2, int label_index) override;
+    virtual void gen_bswap16_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_bswap32_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_concat_i32_i64(TCGv_i64 dest, TCGv_i32 low,
+        TCGv_i32 high) override;
+
+    virtual void gen_deposit_i32(TCGv_i32 ret, TCGv_i32 arg1,
+        TCGv_i32 arg2, unsigned int ofs,
+        unsigned int len) override;
+    virtual void gen_mov_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_exit_tb(int direct) override;
+    virtual void gen_goto_tb(target_ulong dest, bool link) override;
+    virtual void gen_exit_indirect() override;
+    virtual void begin_baseline_only() override;
+    virtual void end_baseline_only() override;
+    virtual void gen_ext16s_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_ext16u_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_ext32u_i64(TCGv_i64 ret, TCGv_i64 arg) override;
+    virtual void gen_ext8s_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_ext8u_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_ext_i32_i64(TCGv_i64 ret, TCGv_i32 arg) override;
+    virtual void gen_extu_i32_i64(TCGv_i64 ret, TCGv_i32 arg) override;
+    virtual void gen_ld_i32(TCGv_i32 ret, TCGv_ptr arg2, tcg_target_long offset) override;
+    virtual void gen_ld_i64(TCGv_i64 ret, TCGv_ptr arg2,
+        target_long offset) override;
+    virtual void gen_movcond_i32(TCGCond cond, TCGv_i32 ret,
+        TCGv_i32 c1, TCGv_i32 c2,
+        TCGv_i32 v1, TCGv_i32 v2) override;
+    virtual void gen_movcond_i64(TCGCond cond, TCGv_i64 ret,
+        TCGv_i64 c1, TCGv_i64 c2,
+        TCGv_i64 v1, TCGv_i64 v2) override;
+    virtual void gen_mov_i64(TCGv_i64 ret, TCGv_i64 arg) override;
+    virtual void gen_movi_i32(TCGv_i32 ret, int32_t arg) override;
+    virtual void gen_movi_i64(TCGv_i64 ret, int64_t arg) override;
+    virtual void gen_mul_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_muls2_i32(TCGv_i32 rl, TCGv_i32 rh,
+        TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_mulu2_i32(TCGv_i32 rl, TCGv_i32 rh,
+        TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_neg_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_neg_i64(TCGv_i64 ret, TCGv_i64 arg) override;
+    virtual void gen_not_i32(TCGv_i32 ret, TCGv_i32 arg) override;
+    virtual void gen_orc_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_or_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_or_i64(TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2) override;
+    virtual void gen_ori_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2) override;
+    virtual void gen_qemu_ld_i32(TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop) override;
+    virtual void gen_qemu_ld_i64(TCGv_i64 val, TCGv addr, TCGArg idx, TCGMemOp memop) override;
+    virtual void gen_qemu_st_i32(TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop) override;
+    virtual void gen_qemu_st_i64(TCGv_i64 val, TCGv addr, TCGArg idx, TCGMemOp memop) override;
+    virtual void gen_rotr_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_rotri_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2) override;
+    virtual void gen_sar_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_sari_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2) override;
+    virtual void gen_setcond_i32(TCGCond cond, TCGv_i32 ret,
+        TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_shl_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_shli_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2) override;
+    virtual void gen_shli_i64(TCGv_i64 ret, TCGv_i64 arg1, int64_t arg2) override;
+    virtual void gen_shr_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_shri_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2) override;
+    virtual void gen_shri_i64(TCGv_i64 ret, TCGv_i64 arg1, int64_t arg2) override;
+    virtual void gen_st_i32(TCGv_i32 arg1, TCGv_ptr arg2, tcg_target_long offset) override;
+    virtual void gen_st_i64(TCGv_i64 arg1, TCGv_ptr arg2,
+        target_long offset) override;
+    virtual void gen_sub_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_sub_i64(TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2) override;
+    virtual void gen_subi_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2) override;
+    virtual void gen_trunc_i64_i32(TCGv_i32 ret, TCGv_i64 arg) override;
+    virtual void gen_xor_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
+    virtual void gen_xor_i64(TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2) override;
+    virtual void gen_xori_i32(TCGv_i32 ret, TCGv_i32 arg1, int32_t arg2) override;
+    virtual TCGv_i32 temp_local_new_i32() override;
+    virtual TCGv_i32 temp_new_i32() override;
+    virtual TCGv_ptr temp_new_ptr() override;
+    virtual TCGv_i64 temp_new_i64() override;
+    virtual void temp_free_i32(TCGv_i32 a) override;
+    virtual void temp_free_i64(TCGv_i64 a) override;
+    virtual void temp_free_ptr(TCGv_ptr a) override;
+    virtual void gen_callN(void* func, TCGArg ret,
+        int nargs, TCGArg* args) override;
+    virtual void func_start() override;
+    virtual bool should_continue() override;
+    virtual void gen_insn_start(target_ulong pc, uint32_t condexec) override;
+    virtual const uint8_t* guest_state_map() override;
+    virtual void* code_entry() override;
+
+private:
+    void emit(int op);
+    template <typename Type>
+    void immediate(Type value);
+    template <typename Handle>
+    void define(Handle handle);
+    template <typename Handle>
+    void use(Handle handle);
+    void label(int inner);
+    template <typename Pointer>
+    uint32_t intern(std::vector<Pointer>& table, std::unordered_map<const void*, uint32_t>& index, Pointer p);
+
+    DisasContextBase& m_inner;
+    OpRecording& m_recording;
+    // where the calls are recorded, m_skipped inside baseline only code.
+    std::vector<uint32_t>* m_words;
+    std::vector<uint32_t> m_skipped;
+    // handles and labels of inner to their numbers in the recording.
+    std::unordered_map<uintptr_t, uint32_t> m_values;
+    std::unordered_map<int, uint32_t> m_labels;
+    std::unordered_map<const void*, uint32_t> m_nameIndex;
+    std::unordered_map<const void*, uint32_t> m_helperIndex;
+};
+}
+#endif /* RECORDINGDISASCONTEXT_H */
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include "cpu.h"
+#include "RegionFormer.h"
+
+namespace jit {
+static const size_t maxTraceBlocks = 16;
+
+static bool inTrace(const std::vector<RegionBlock>& trace, uint32_t pc)
+{
+    return std::any_of(trace.begin(), trace.end(), [pc](const RegionBlock& b) { return b.m_pc == pc; });
+}
+
+size_t dominantTargets(const IndirectProfile& profile, uint32_t targets[IndirectProfile::maxTargets])
+{
+    // the counters may move under us.
+    IndirectProfile copy = profile;
+    uint64_t total = copy.m_others;
+    for (int i = 0; i < IndirectProfile::maxTargets; ++i)
+        total += copy.m_counts[i];
+    size_t count = 0;
+    while (count < IndirectProfile::maxTargets) {
+        int best = -1;
+        for (int i = 0; i < IndirectProfile::maxTargets; ++i) {
+            if (copy.m_counts[i] && (best < 0 || copy.m_counts[i] > copy.m_counts[best]))
+                best = i;
+        }
+        if (best < 0 || static_cast<uint64_t>(copy.m_counts[best]) * 8 < total)
+            break;
+        targets[count++] = copy.m_targets[best];
+        copy.m_counts[best] = 0;
+    }
+    return count;
+}
+
+// the indirect target taken by most executions of its block, 0 if none.
+static uint32_t dominantIndirectTarget(const IndirectProfile& profile, uint32_t executions)
+{
+    uint32_t targets[IndirectProfile::maxTargets];
+    if (!dominantTargets(profile, targets))
+        return 0;
+    for (int i = 0; i < IndirectProfile::maxTargets; ++i) {
+        if (profile.m_targets[i] == targets[0] && static_cast<uint64_t>(profile.m_counts[i]) * 2 > executions)
+            return targets[0];
+    }
+    return 0;
+}
+
+void formTrace(const BlockProfile& entry, ProfileLookup lookup, void* opaque, std::vector<RegionBlock>& trace)
+{
+    trace.clear();
+    trace.push_back({ entry.m_pc, entry.m_flags });
+    // every block of the trace is entered with the flags of the entry,
+    // which therefore must not be inside an IT block.
+    if (ARM_TBFLAG_CONDEXEC(entry.m_flags))
+        return;
+    const BlockProfile* current = &entry;
+    while (trace.size() < maxTraceBlocks) {
+        int hot = current->m_edgeCounts[0] >= current->m_edgeCounts[1] ? 0 : 1;
+        uint32_t next = current->m_successors[hot];
+        // follow the edge only if it carries most executions of the block.
+        if (!next || static_cast<uint64_t>(current->m_edgeCounts[hot]) * 2 <= current->m_executions) {
+            next = dominantIndirectTarget(current->m_indirect, current->m_executions);
+            if (!next || (next & 1) != ARM_TBFLAG_THUMB(entry.m_flags))
+                break;
+            next &= ~1u;
+        }
+        if (inTrace(trace, next))
+            break;
+        const BlockProfile* profile = lookup(opaque, next);
+        if (!profile || profile->m_flags != entry.m_flags)
+            break;
+        trace.push_back({ profile->m_pc, profile->m_flags });
+        current = profile;
+    }
+}
+}
@@ -0,0 +1,48 @@
+#ifndef REGIONFORMER_H
+#define REGIONFORMER_H
+#include <stdint.h>
+#include <vector>
+namespace jit {
+
+// A block of a region, pc and tb flags as cpu_get_tb_cpu_state returns.
+struct RegionBlock {
+    uint32_t m_pc;
+    uint64_t m_flags;
+};
+
+// The targets the indirect exit of a baseline block went to, counted by
+// the block itself, see TranslateDesc::m_indirectProfile. A target is the
+// pc with the thumb bit in bit 0, the first maxTargets distinct targets
+// get a slot and the rest are only counted in m_others. The counters are
+// updated without locking, they are a hint.
+struct IndirectProfile {
+    enum { maxTargets = 4 };
+    uint32_t m_targets[maxTargets];
+    uint32_t m_counts[maxTargets];
+    uint32_t m_others;
+};
+
+// What the embedder recorded for a baseline block: how often it ran and
+// how often each of its two direct exits was taken. A successor pc of 0
+// means the exit does not exist or has not been taken.
+struct BlockProfile {
+    uint32_t m_pc;
+    uint64_t m_flags;
+    uint32_t m_executions;
+    uint32_t m_successors[2];
+    uint32_t m_edgeCounts[2];
+    IndirectProfile m_indirect;
+};
+
+typedef const BlockProfile* (*ProfileLookup)(void* opaque, uint32_t pc);
+
+// Grow a single entry, multiple exit trace from entry by following the
+// dominant recorded edge of each block, direct or indirect. The trace
+// stops at a block it already contains, so a hot loop closes on its entry.
+void formTrace(const BlockProfile& entry, ProfileLookup lookup, void* opaque, std::vector<RegionBlock>& trace);
+
+// store the targets of profile that took at least an eighth of its
+// executions into targets, most frequent first, and return their number.
+size_t dominantTargets(const IndirectProfile& profile, uint32_t targets[IndirectProfile::maxTargets]);
+}
+#endif /* REGIONFORMER_H */
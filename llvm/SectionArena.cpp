@@ -0,0 +1,101 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include "log.h"
+#include "SectionArena.h"
+
+namespace jit {
+namespace {
+struct ThreadArenas {
+    SectionArena m_link;
+    SectionArena m_code;
+    ~ThreadArenas()
+    {
+        m_code.leak();
+    }
+};
+
+pthread_key_t arenasKey;
+pthread_once_t arenasKeyOnce = PTHREAD_ONCE_INIT;
+
+void destroyArenas(void* p)
+{
+    delete static_cast<ThreadArenas*>(p);
+}
+
+void createArenasKey()
+{
+    pthread_key_create(&arenasKey, destroyArenas);
+}
+
+ThreadArenas& currentArenas()
+{
+    pthread_once(&arenasKeyOnce, createArenasKey);
+    ThreadArenas* arenas = static_cast<ThreadArenas*>(pthread_getspecific(arenasKey));
+    if (!arenas) {
+        arenas = new ThreadArenas;
+        pthread_setspecific(arenasKey, arenas);
+    }
+    return *arenas;
+}
+}
+
+SectionArena::SectionArena()
+    : m_current(0)
+    , m_used(0)
+{
+}
+
+SectionArena::~SectionArena()
+{
+    for (Chunk& chunk : m_chunks)
+        free(chunk.m_base);
+}
+
+uint8_t* SectionArena::allocate(size_t size, unsigned alignment)
+{
+    if (alignment == 0)
+        alignment = 1;
+    EMASSERT((alignment & (alignment - 1)) == 0);
+    for (; m_current < m_chunks.size(); ++m_current, m_used = 0) {
+        Chunk& chunk = m_chunks[m_current];
+        uintptr_t start = (reinterpret_cast<uintptr_t>(chunk.m_base) + m_used + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        size_t offset = start - reinterpret_cast<uintptr_t>(chunk.m_base);
+        if (offset + size <= chunk.m_size) {
+            m_used = offset + size;
+            return chunk.m_base + offset;
+        }
+    }
+    size_t chunkSize = minChunkSize;
+    while (chunkSize < size + alignment)
+        chunkSize *= 2;
+    void* base;
+    if (posix_memalign(&base, alignment < sizeof(void*) ? sizeof(void*) : alignment, chunkSize))
+        EMASSERT(false);
+    m_chunks.push_back({ static_cast<uint8_t*>(base), chunkSize });
+    m_current = m_chunks.size() - 1;
+    m_used = size;
+    return static_cast<uint8_t*>(base);
+}
+
+void SectionArena::reset()
+{
+    m_current = 0;
+    m_used = 0;
+}
+
+void SectionArena::leak()
+{
+    m_chunks.clear();
+    reset();
+}
+
+SectionArena& SectionArena::linkSections()
+{
+    return currentArenas().m_link;
+}
+
+SectionArena& SectionArena::codeSections()
+{
+    return currentArenas().m_code;
+}
+}
@@ -0,0 +1,44 @@
+#ifndef SECTIONARENA_H
+#define SECTIONARENA_H
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+namespace jit {
+
+// Bump allocator for the data sections MCJIT asks for. Memory comes from
+// chunks that reset() hands out again, so a thread compiling many
+// regions stops allocating once its chunks are big enough.
+class SectionArena {
+public:
+    SectionArena();
+    ~SectionArena();
+    SectionArena(const SectionArena&) = delete;
+    SectionArena& operator=(const SectionArena&) = delete;
+
+    uint8_t* allocate(size_t size, unsigned alignment);
+    // everything allocated so far may be handed out again.
+    void reset();
+    // give up the chunks without freeing them, for memory translations
+    // keep pointing at.
+    void leak();
+
+    // the sections only link reads, such as .llvm_stackmaps, reset by
+    // every compilation on this thread.
+    static SectionArena& linkSections();
+    // the sections the code reads, constant pools mostly. Translations
+    // have no destruction hook, so these are never reused or freed.
+    static SectionArena& codeSections();
+
+private:
+    struct Chunk {
+        uint8_t* m_base;
+        size_t m_size;
+    };
+    static const size_t minChunkSize = 16 * 1024;
+    std::vector<Chunk> m_chunks;
+    // the chunk allocate bumps in, and its first free byte.
+    size_t m_current;
+    size_t m_used;
+};
+}
+#endif /* SECTIONARENA_H */
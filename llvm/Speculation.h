@@ -0,0 +1,17 @@
+#ifndef SPECULATION_H
+#define SPECULATION_H
+#include <stdint.h>
+namespace jit {
+
+// A guess from the profile of the embedder that the LLVM tier compiles in
+// behind a guard: the CPUARMState field at m_offset, one of the TCG
+// globals such as a core register or a flag, holds m_value whenever the
+// guest instruction at m_pc starts. A failed guard leaves through the
+// deopt exit with the guest state of that instruction.
+struct Speculation {
+    uint32_t m_pc;
+    uint32_t m_offset;
+    uint32_t m_value;
+};
+}
+#endif /* SPECULATION_H */
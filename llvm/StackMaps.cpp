@@ -3,7 +3,14 @@ namespace jit {
 
 Reg DWARFRegister::reg() const
 {
-#if __i386__ || __x86_64__
+#if __i386__
+    // the i386 DWARF numbers of eax..edi are their encodings.
+    if (m_dwarfRegNum >= 0 && m_dwarfRegNum < 8)
+        return static_cast<Reg>(m_dwarfRegNum);
+    if (m_dwarfRegNum >= 21 && m_dwarfRegNum <= 28)
+        return static_cast<FPRReg>(m_dwarfRegNum - 21);
+    return Reg();
+#elif __x86_64__
     if (m_dwarfRegNum >= 0 && m_dwarfRegNum < 16) {
         switch (dwarfRegNum()) {
         case 0:
@@ -204,4 +211,86 @@ unsigned StackMaps::stackSize() const
 
     return stackSizes[0].size;
 }
+
+// the encoded size of T, as far as its parse reads, so the strides of
+// StackMapReader follow the parsers. The same in versions 0 and 1.
+template <typename T>
+static unsigned encodedSize()
+{
+    static const uint8_t zeros[16] = {};
+    DataView view(zeros);
+    StackMaps::ParseContext context = { 1, &view, 0 };
+    readObject<T>(context);
+    return context.offset;
+}
+
+static const unsigned locationSize = encodedSize<StackMaps::Location>();
+static const unsigned liveOutSize = encodedSize<StackMaps::LiveOut>();
+
+StackMapReader::StackMapReader(const uint8_t* section)
+    : m_view(section)
+    , m_offset(0)
+{
+    m_version = m_view.read<uint8_t>(m_offset, true);
+    m_offset += 3; // Reserved
+    uint32_t numFunctions = m_view.read<uint32_t>(m_offset, true);
+    uint32_t numConstants = 0;
+    if (m_version >= 1) {
+        numConstants = m_view.read<uint32_t>(m_offset, true);
+        m_recordsLeft = m_view.read<uint32_t>(m_offset, true);
+    }
+    // the stack sizes and constants are not needed, skip them.
+    m_offset += numFunctions * (m_version >= 1 ? 16 : 8);
+    if (!m_version)
+        numConstants = m_view.read<uint32_t>(m_offset, true);
+    m_offset += numConstants * 8;
+    if (!m_version)
+        m_recordsLeft = m_view.read<uint32_t>(m_offset, true);
+}
+
+bool StackMapReader::next(Record& record)
+{
+    if (!m_recordsLeft)
+        return false;
+    m_recordsLeft--;
+    int64_t id = m_view.read<int64_t>(m_offset, true);
+    EMASSERT(static_cast<int32_t>(id) == id);
+    record.patchpointID = static_cast<uint32_t>(id);
+    // as in Record::parse, LLVM signals a failed compilation.
+    if (static_cast<int32_t>(record.patchpointID) < 0) {
+        m_recordsLeft = 0;
+        return false;
+    }
+    record.instructionOffset = m_view.read<uint32_t>(m_offset, true);
+    record.flags = m_view.read<uint16_t>(m_offset, true);
+    record.numLocations = m_view.read<uint16_t>(m_offset, true);
+    record.locations = m_view.at(m_offset);
+    m_offset += record.numLocations * locationSize;
+    if (m_version >= 1)
+        m_offset += 2; // padding
+    record.numLiveOuts = m_view.read<uint16_t>(m_offset, true);
+    record.liveOuts = m_view.at(m_offset);
+    m_offset += record.numLiveOuts * liveOutSize;
+    if (m_version >= 1 && (m_offset & 7)) {
+        EMASSERT(!(m_offset & 3));
+        m_offset += 4; // padding
+    }
+    return true;
+}
+
+StackMaps::Location StackMapReader::Record::location(unsigned index) const
+{
+    EMASSERT(index < numLocations);
+    DataView view(locations);
+    StackMaps::ParseContext context = { 0, &view, index * locationSize };
+    return readObject<StackMaps::Location>(context);
+}
+
+StackMaps::LiveOut StackMapReader::Record::liveOut(unsigned index) const
+{
+    EMASSERT(index < numLiveOuts);
+    DataView view(liveOuts);
+    StackMaps::ParseContext context = { 0, &view, index * liveOutSize };
+    return readObject<StackMaps::LiveOut>(context);
+}
 }
@@ -22,6 +22,7 @@ public:
         off += sizeof(T);
         return t;
     }
+    const uint8_t* at(unsigned off) const { return m_data + off; }
 
 private:
     const uint8_t* m_data;
@@ -108,5 +109,35 @@ struct StackMaps {
 
     unsigned stackSize() const;
 };
+
+// Walks the records of a .llvm_stackmaps section in place, for link,
+// which visits every record once and needs no StackMaps copy of them.
+class StackMapReader {
+public:
+    struct Record {
+        uint32_t patchpointID;
+        uint32_t instructionOffset;
+        uint16_t flags;
+        uint16_t numLocations;
+        uint16_t numLiveOuts;
+        // point into the section.
+        const uint8_t* locations;
+        const uint8_t* liveOuts;
+
+        StackMaps::Location location(unsigned index) const;
+        StackMaps::LiveOut liveOut(unsigned index) const;
+    };
+
+    explicit StackMapReader(const uint8_t* section);
+    // false after the last record, and at a record with a negative
+    // patchpoint ID, where StackMaps::parse fails too.
+    bool next(Record& record);
+
+private:
+    DataView m_view;
+    unsigned m_version;
+    unsigned m_offset;
+    uint32_t m_recordsLeft;
+};
 }
 #endif /* STACKMAPS_H */
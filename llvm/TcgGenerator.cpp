@@ -1,3 +1,4 @@
+#include <time.h>
 #include <unordered_map>
 #include <vector>
 #include <memory>
@@ -5,12 +6,16 @@
 #include "Registers.h"
 #include "TcgGenerator.h"
 #include "QEMUDisasContext.h"
+#include "LLVMDisasContext.h"
 #include "X86Assembler.h"
 #include "cpu.h"
 #include "tb.h"
 #include "translate.h"
 #include "log.h"
 #include "DisasContextBase.h"
+#include "GuestStateMap.h"
+#include "CompilePipeline.h"
+#include "OpCapture.h"
 
 using namespace jit;
 namespace {
@@ -92,41 +97,300 @@ static inline void cpu_get_tb_cpu_state(CPUARMState* env, target_ulong* pc,
 }
 }
 namespace jit {
+static std::unique_ptr<CaptureWriter> captureWriter;
+
+static void prepareExits(LLVMDisasContext& ctx, const TranslateDesc& desc, target_ulong pc, uint64_t flags)
+{
+    const BlockProfile* profile = desc.m_profileLookup ? desc.m_profileLookup(desc.m_profileOpaque, pc) : nullptr;
+    ctx.setIndirectProfile(profile ? &profile->m_indirect : nullptr, ARM_TBFLAG_THUMB(flags));
+    ctx.setBlockFlags(flags);
+}
+
+// what CompilePolicy::choose needs, before any IR is built. A replayed
+// recording knows its guest instructions, other blocks count as
+// estimatedBlockInsns each. A region loops if the profile saw one of its
+// blocks branch back to itself or to an earlier one, a function is
+// assumed not to.
+static const uint32_t estimatedBlockInsns = 8;
+static const uint32_t estimatedFunctionBlocks = 8;
+
+static void estimateTranslation(const TranslateDesc& desc, target_ulong pc, uint64_t flags, uint32_t* guestInsns, bool* loops)
+{
+    *loops = false;
+    if (desc.m_regionSize > 1) {
+        *guestInsns = desc.m_regionSize * estimatedBlockInsns;
+        if (!desc.m_profileLookup)
+            return;
+        for (size_t i = 0; i < desc.m_regionSize && !*loops; ++i) {
+            const BlockProfile* profile = desc.m_profileLookup(desc.m_profileOpaque, desc.m_region[i].m_pc);
+            if (!profile)
+                continue;
+            for (size_t j = 0; j <= i && !*loops; ++j) {
+                for (int k = 0; k < 2; ++k) {
+                    if (profile->m_edgeCounts[k] && profile->m_successors[k] == desc.m_region[j].m_pc)
+                        *loops = true;
+                }
+            }
+        }
+    }
+    else if (desc.m_function && !ARM_TBFLAG_CONDEXEC(flags))
+        *guestInsns = estimatedFunctionBlocks * estimatedBlockInsns;
+    else if (desc.m_recording && desc.m_recording->matches(pc, flags))
+        *guestInsns = desc.m_recording->icount();
+    else
+        *guestInsns = estimatedBlockInsns;
+}
 
 void translate(CPUARMState* env, TranslateDesc& desc)
 {
     std::unique_ptr<DisasContextBase> ctxptr;
     if (desc.m_optimal) {
+        LLVMDisasContext* llvmCtx = new LLVMDisasContext(desc.m_executableMemAllocator, desc.m_dispDirect, desc.m_dispIndirect);
+        if (desc.m_promoteRegisters)
+            llvmCtx->enablePromotion();
+        if (desc.m_dispDeopt)
+            llvmCtx->enableSpeculation(desc.m_dispDeopt, desc.m_speculations, desc.m_speculationCount, desc.m_codeStart, desc.m_codeEnd);
+        if (desc.m_chainLookup)
+            llvmCtx->setChainLookup(desc.m_chainLookup, desc.m_chainOpaque);
+        ctxptr.reset(llvmCtx);
     }
     else {
         ctxptr.reset(new qemu::QEMUDisasContext(desc.m_executableMemAllocator, desc.m_dispDirect, desc.m_dispIndirect, reinterpret_cast<void*>(desc.m_dispHot), desc.m_hotObject));
     }
-    DisasContextBase& ctx = *ctxptr;
+    std::unique_ptr<RecordingDisasContext> recorder;
+    OpRecording captured;
+    if (!desc.m_optimal && (desc.m_recording || captureWriter))
+        recorder.reset(new RecordingDisasContext(*ctxptr, desc.m_recording ? *desc.m_recording : captured));
+    DisasContextBase& ctx = recorder ? *recorder : *ctxptr;
     ARMCPU* cpu = arm_env_get_cpu(env);
     target_ulong pc;
     uint64_t flags;
     cpu_get_tb_cpu_state(env, &pc, &flags);
     TranslationBlock tb = { pc, flags };
+    uint32_t guestInsns = 0;
+    if (!desc.m_optimal && desc.m_dispHot && desc.m_hotCounter && desc.m_hotThreshold) {
+        *desc.m_hotCounter = desc.m_hotThreshold;
+        tb.hot_counter = desc.m_hotCounter;
+        tb.disp_hot = reinterpret_cast<void*>(desc.m_dispHot);
+        tb.hot_object = desc.m_hotObject;
+    }
+    if (!desc.m_optimal)
+        tb.indirect_profile = desc.m_indirectProfile;
+    else {
+        // a deferred compilation should not pay for lowering the blocks.
+        uint32_t estimatedInsns;
+        bool loops;
+        estimateTranslation(desc, pc, flags, &estimatedInsns, &loops);
+        if (!CompilePolicy::current().choose(estimatedInsns, desc.m_executions, loops, &desc.m_optLevel)) {
+            if (desc.m_mayDefer) {
+                desc.m_guestExtents = 0;
+                desc.m_code = nullptr;
+                desc.m_chainEntry = nullptr;
+                desc.m_guestStateMap = nullptr;
+                desc.m_guestInsns = 0;
+                desc.m_envLoads = 0;
+                return;
+            }
+            desc.m_optLevel = OptLevel::Fast;
+        }
+        static_cast<LLVMDisasContext&>(ctx).setOptLevel(desc.m_optLevel);
+    }
 
-    gen_intermediate_code_internal(cpu, &tb, &ctx);
+    if (desc.m_optimal && desc.m_regionSize > 1) {
+        LLVMDisasContext& llvmCtx = static_cast<LLVMDisasContext&>(ctx);
+        EMASSERT(desc.m_region[0].m_pc == pc && desc.m_region[0].m_flags == flags);
+        llvmCtx.beginRegion(desc.m_region, desc.m_regionSize);
+        for (size_t i = 0; i < desc.m_regionSize; ++i) {
+            TranslationBlock regionTb = { desc.m_region[i].m_pc, desc.m_region[i].m_flags };
+            llvmCtx.beginRegionBlock(regionTb.pc);
+            prepareExits(llvmCtx, desc, regionTb.pc, regionTb.flags);
+            gen_intermediate_code_internal(cpu, &regionTb, &ctx);
+            guestInsns += regionTb.icount;
+            if (i == 0)
+                tb.size = regionTb.size;
+        }
+    }
+    else if (desc.m_optimal && desc.m_function && !ARM_TBFLAG_CONDEXEC(flags)) {
+        // the blocks found are entered with the flags of the entry.
+        LLVMDisasContext& llvmCtx = static_cast<LLVMDisasContext&>(ctx);
+        llvmCtx.beginFunction(pc);
+        target_ulong blockPc;
+        while (llvmCtx.nextFunctionBlock(&blockPc)) {
+            TranslationBlock functionTb = { blockPc, flags };
+            llvmCtx.beginRegionBlock(blockPc);
+            prepareExits(llvmCtx, desc, blockPc, flags);
+            gen_intermediate_code_internal(cpu, &functionTb, &ctx);
+            guestInsns += functionTb.icount;
+            if (blockPc == pc)
+                tb.size = functionTb.size;
+        }
+    }
+    else if (desc.m_optimal && desc.m_recording && desc.m_recording->matches(pc, flags)) {
+        prepareExits(static_cast<LLVMDisasContext&>(ctx), desc, pc, flags);
+        desc.m_recording->replay(ctx, &tb);
+        guestInsns = tb.icount;
+    }
+    else {
+        if (desc.m_optimal)
+            prepareExits(static_cast<LLVMDisasContext&>(ctx), desc, pc, flags);
+        gen_intermediate_code_internal(cpu, &tb, &ctx);
+        guestInsns = tb.icount;
+        if (recorder) {
+            recorder->finish(tb);
+            if (captureWriter)
+                captureWriter->append(desc.m_recording ? *desc.m_recording : captured);
+        }
+    }
+    struct timespec compileStart, compileEnd;
+    clock_gettime(CLOCK_MONOTONIC, &compileStart);
     ctx.compile();
     ctx.link();
+    clock_gettime(CLOCK_MONOTONIC, &compileEnd);
+    desc.m_compileSeconds = compileEnd.tv_sec - compileStart.tv_sec;
+    desc.m_compileSeconds += static_cast<double>(compileEnd.tv_nsec - compileStart.tv_nsec) / 1e9;
+    if (desc.m_optimal)
+        CompilePolicy::current().record(pc, desc.m_optLevel, desc.m_compileSeconds, guestInsns, desc.m_executions);
     desc.m_guestExtents = tb.size;
+    desc.m_guestStateMap = ctx.guest_state_map();
+    desc.m_code = ctx.code_entry();
+    desc.m_chainEntry = desc.m_optimal ? static_cast<LLVMDisasContext&>(ctx).chainEntry() : desc.m_code;
+    desc.m_guestInsns = guestInsns;
+    desc.m_envLoads = desc.m_optimal ? static_cast<LLVMDisasContext&>(ctx).envLoads() : 0;
 }
 
-void patchDirectJump(uintptr_t from, uintptr_t to)
+void getBlockState(CPUARMState* env, uint32_t* pc, uint64_t* flags)
+{
+    target_ulong blockPc;
+    cpu_get_tb_cpu_state(env, &blockPc, flags);
+    *pc = blockPc;
+}
+
+void setLLVMPipelineRecycleLimit(unsigned limit)
+{
+    CompilePipeline::setRecycleLimit(limit);
+}
+
+bool startOpCapture(const char* path)
+{
+    std::unique_ptr<CaptureWriter> writer(new CaptureWriter);
+    if (!writer->open(path))
+        return false;
+    captureWriter = std::move(writer);
+    return true;
+}
+
+void setLLVMCompileBudget(double fraction)
+{
+    CompilePolicy::current().setBudget(fraction);
+}
+
+void recordLLVMSpeedup(uint32_t pc, double speedup)
+{
+    CompilePolicy::current().recordSpeedup(pc, speedup);
+}
+
+void dumpLLVMCompilePolicy()
+{
+    CompilePolicy::current().dump();
+}
+
+void getLLVMCompileStats(CompileCounters* stats)
+{
+    CompileStats::snapshot(stats);
+}
+
+void dumpLLVMCompileStats()
+{
+    CompileStats::dump();
+}
+
+void setLLVMCompileStatsInterval(double seconds)
+{
+    CompileStats::setDumpInterval(seconds);
+}
+
+void setLLVMPassTiming(bool enable)
+{
+    CompileStats::setPassTiming(enable);
+}
+
+bool restoreGuestState(CPUARMState* env, const uint8_t* guestStateMap, uint32_t hostOffset)
 {
-    JSC::X86Assembler assembler(reinterpret_cast<char*>(from), 7);
+    GuestState state;
+    if (!guestStateMap || !decodeGuestState(guestStateMap, hostOffset, &state))
+        return false;
+    env->regs[15] = state.m_pc;
+    env->condexec_bits = state.m_condexec;
+    return true;
+}
+
+// a direct jump site is movl $imm32, %eax or, on x86-64, movabsq $imm64,
+// %rax, followed by call *%eax before and jmp *%eax after chaining.
+#if defined(__x86_64__)
+static const unsigned directJumpSize = 12;
+static const unsigned directJumpImmOffset = 2;
+#else
+static const unsigned directJumpSize = 7;
+static const unsigned directJumpImmOffset = 1;
+#endif
+
+static void emitDirectJumpTarget(JSC::X86Assembler& assembler, uintptr_t to)
+{
+#if defined(__x86_64__)
+    assembler.movq_i64r(to, JSC::X86Registers::eax);
+#else
     assembler.movl_i32r(to, JSC::X86Registers::eax);
+#endif
+}
+
+void patchDirectJump(uintptr_t from, uintptr_t to)
+{
+    JSC::X86Assembler assembler(reinterpret_cast<char*>(from), directJumpSize);
+    emitDirectJumpTarget(assembler, to);
     assembler.jmp_r(JSC::X86Registers::eax);
 }
 
 void unpatchDirectJump(uintptr_t from, uintptr_t to)
 {
-    JSC::X86Assembler assembler(reinterpret_cast<char*>(from), 7);
-    assembler.movl_i32r(to, JSC::X86Registers::eax);
+    JSC::X86Assembler assembler(reinterpret_cast<char*>(from), directJumpSize);
+    emitDirectJumpTarget(assembler, to);
     assembler.call(JSC::X86Registers::eax);
 }
+
+void retargetDirectJump(uintptr_t from, uintptr_t to)
+{
+    // Only the immediate changes, and x86 stores it atomically as long as
+    // it does not cross a cache line.
+    const uint8_t* code = reinterpret_cast<const uint8_t*>(from);
+    EMASSERT(code[directJumpImmOffset - 1] == 0xb8 && code[directJumpSize - 2] == 0xff && code[directJumpSize - 1] == 0xe0);
+    EMASSERT(((from + directJumpImmOffset) & ~63) == ((from + directJumpSize - 3) & ~63));
+    __atomic_store_n(reinterpret_cast<uintptr_t*>(from + directJumpImmOffset), to, __ATOMIC_RELEASE);
+}
+}
+
+extern "C" {
+void helper_dispatch_hot(CPUARMState* env, void* dispHot, void* hotObject);
+void helper_profile_indirect(CPUARMState* env, void* profile);
+}
+
+void helper_dispatch_hot(CPUARMState* env, void* dispHot, void* hotObject)
+{
+    reinterpret_cast<void (*)(CPUARMState*, void*)>(dispHot)(env, hotObject);
+}
+
+void helper_profile_indirect(CPUARMState* env, void* p)
+{
+    jit::IndirectProfile* profile = static_cast<jit::IndirectProfile*>(p);
+    uint32_t target = env->regs[15] | env->thumb;
+    for (int i = 0; i < jit::IndirectProfile::maxTargets; ++i) {
+        if (profile->m_counts[i] == 0)
+            profile->m_targets[i] = target;
+        if (profile->m_targets[i] == target) {
+            profile->m_counts[i]++;
+            return;
+        }
+    }
+    profile->m_others++;
 }
 #ifdef ENABLE_ASAN
 extern "C" {
@@ -231,6 +495,18 @@ void tcg_gen_add2_i32(DisasContext* s, TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
         ah, bl, bh);
 }
 
+void tcg_gen_add_cc_i32(DisasContext* s, TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+    TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, int carry)
+{
+    static_cast<DisasContextBase*>(s)->gen_add_cc_i32(nf, zf, cf, vf, dest, t0, t1, carry);
+}
+
+void tcg_gen_sub_cc_i32(DisasContext* s, TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+    TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, int carry)
+{
+    static_cast<DisasContextBase*>(s)->gen_sub_cc_i32(nf, zf, cf, vf, dest, t0, t1, carry);
+}
+
 void tcg_gen_add_i32(DisasContext* s, TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2)
 {
     static_cast<DisasContextBase*>(s)->gen_add_i32(ret, arg1, arg2);
@@ -324,6 +600,26 @@ void tcg_gen_exit_tb(DisasContext* s, int direct)
     static_cast<DisasContextBase*>(s)->gen_exit_tb(direct);
 }
 
+void tcg_gen_goto_tb(DisasContext* s, target_ulong dest, int link)
+{
+    static_cast<DisasContextBase*>(s)->gen_goto_tb(dest, link);
+}
+
+void tcg_gen_exit_indirect(DisasContext* s)
+{
+    static_cast<DisasContextBase*>(s)->gen_exit_indirect();
+}
+
+void tcg_begin_baseline_only(DisasContext* s)
+{
+    static_cast<DisasContextBase*>(s)->begin_baseline_only();
+}
+
+void tcg_end_baseline_only(DisasContext* s)
+{
+    static_cast<DisasContextBase*>(s)->end_baseline_only();
+}
+
 void tcg_gen_ext16s_i32(DisasContext* s, TCGv_i32 ret, TCGv_i32 arg)
 {
     static_cast<DisasContextBase*>(s)->gen_ext16s_i32(ret, arg);
@@ -665,3 +961,8 @@ bool tcg_should_continue(DisasContext* s)
 {
     return static_cast<DisasContextBase*>(s)->should_continue();
 }
+
+void tcg_gen_insn_start(DisasContext* s, target_ulong pc, uint32_t condexec)
+{
+    static_cast<DisasContextBase*>(s)->gen_insn_start(pc, condexec);
+}
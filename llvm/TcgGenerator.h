@@ -2,6 +2,12 @@
 #define TCGGENERATOR_H
 #include "tcg_functions.h"
 #include "cpu.h"
+#include "RegionFormer.h"
+#include "Speculation.h"
+#include "CompilePolicy.h"
+#include "CompileStats.h"
+#include "RecordingDisasContext.h"
+#include "ChainLookup.h"
 namespace jit {
 class ExecutableMemoryAllocator;
 struct TranslateDesc {
@@ -11,11 +17,116 @@ struct TranslateDesc {
     void* m_hotObject;
     ExecutableMemoryAllocator* m_executableMemAllocator;
     bool m_optimal;
+    // baseline blocks decrement *m_hotCounter on entry and call
+    // m_dispHot(env, m_hotObject) when it reaches zero. translate stores
+    // m_hotThreshold into it, so m_hotThreshold - *m_hotCounter is the
+    // execution count. Null or a zero threshold disables the counter.
+    int32_t* m_hotCounter;
+    uint32_t m_hotThreshold;
+    // LLVM tier only: translate these blocks into one function, see
+    // formTrace. m_region[0] is the block at the pc of env. The output
+    // describes the entry block.
+    const RegionBlock* m_region;
+    size_t m_regionSize;
+    // LLVM tier only: translate the whole guest function at the pc of env,
+    // typically a hot BL target, instead of a single block.
+    bool m_function;
+    // LLVM tier only: keep guest registers in SSA values inside the
+    // translation, see LLVMDisasContext::enablePromotion.
+    bool m_promoteRegisters;
+    // LLVM tier only: failed speculation guards write the state of the
+    // guest instruction back to env and leave through m_dispDeopt, the
+    // embedder resumes at env's pc in the baseline tier. Null disables
+    // speculation. m_speculations are guarded values, and guest stores
+    // into [m_codeStart, m_codeEnd) deopt before they happen, so the
+    // translation may assume its code is not modified behind it.
+    void* m_dispDeopt;
+    const Speculation* m_speculations;
+    size_t m_speculationCount;
+    uint32_t m_codeStart;
+    uint32_t m_codeEnd;
+    // baseline only: a block ending in an indirect branch counts its
+    // targets into *m_indirectProfile. Null disables the profile.
+    IndirectProfile* m_indirectProfile;
+    // LLVM tier only: the recorded profile of each translated block. The
+    // indirect exits compare against the dominant targets before going to
+    // m_dispIndirect, hits branch inside the translation or take a direct
+    // exit. Called on the compiling thread. Null disables it.
+    ProfileLookup m_profileLookup;
+    void* m_profileOpaque;
+    // LLVM tier only: direct exits whose successor m_chainLookup returns
+    // jump there when linked instead of going through m_dispDirect, see
+    // ChainLookup.h. Called on the compiling thread. Null disables it.
+    ChainLookup m_chainLookup;
+    void* m_chainOpaque;
+    // baseline: the gen_* calls of the block are recorded here. LLVM tier:
+    // a recording of the block at the pc and flags of env is replayed
+    // instead of decoding the guest code again, other blocks of a region
+    // are decoded. Null disables both.
+    OpRecording* m_recording;
+    // LLVM tier only: how often the baseline block ran, 0 if unknown.
+    // CompilePolicy picks the opt level from it and the region size.
+    uint32_t m_executions;
+    // LLVM tier only: when CompilePolicy finds the compile budget spent,
+    // return with a null m_code instead of compiling at the lowest level.
+    // The level is picked before the guest code is decoded, so a deferred
+    // translation costs no lowering.
+    bool m_mayDefer;
     // output is here
     size_t m_guestExtents;
+    // see GuestStateMap.h, null if the backend does not produce one.
+    const uint8_t* m_guestStateMap;
+    void* m_code;
+    // where a direct exit of an LLVM translation chains to: past the loads
+    // of the pinned guest registers for the LLVM tier, see
+    // PinnedRegisters.h, m_code for the baseline. Other exits and the
+    // dispatcher enter at m_code. An embedder chaining through the
+    // dispatcher tells the two kinds of site apart by the translation the
+    // return address is in.
+    void* m_chainEntry;
+    // guest instructions translated and, for the LLVM tier, the loads of
+    // CPUARMState left after optimization. Their ratio tracks how well
+    // the optimizer keeps guest registers out of memory.
+    uint32_t m_guestInsns;
+    uint32_t m_envLoads;
+    // LLVM tier only: the level CompilePolicy picked and the seconds
+    // compile and link took.
+    OptLevel m_optLevel;
+    double m_compileSeconds;
 };
 void translate(CPUARMState* env, TranslateDesc& desc);
+// the pc and tb flags of the block env is about to run, what RegionBlock
+// and BlockProfile key blocks by.
+void getBlockState(CPUARMState* env, uint32_t* pc, uint64_t* flags);
+// set pc and condexec bits of env to the guest instruction containing
+// hostOffset of a translation, the replacement of search_pc.
+bool restoreGuestState(CPUARMState* env, const uint8_t* guestStateMap, uint32_t hostOffset);
+// the LLVM tier reuses its context, target machine and pass manager for
+// this many compilations per thread, 1 builds them for every compilation.
+void setLLVMPipelineRecycleLimit(unsigned limit);
+// append the op stream of every baseline block translated from now on to
+// the capture file at path, see OpCapture.h.
+bool startOpCapture(const char* path);
+// let LLVM compilations take at most this fraction of wall time, lowering
+// the opt level to stay within it. 0, the default, is no limit.
+void setLLVMCompileBudget(double fraction);
+// the embedder measured the LLVM translation at pc to run speedup times as
+// fast as the baseline, kept next to its compile cost for tuning.
+void recordLLVMSpeedup(uint32_t pc, double speedup);
+// log compile cost and speedup per opt level.
+void dumpLLVMCompilePolicy();
+// the time of each LLVM compile phase and the size of what was compiled,
+// summed over all threads, see CompileStats.h.
+void getLLVMCompileStats(CompileCounters* stats);
+void dumpLLVMCompileStats();
+// log them every this many seconds, 0 stops.
+void setLLVMCompileStatsInterval(double seconds);
+// time each LLVM pass, the dumps then add LLVM's report.
+void setLLVMPassTiming(bool enable);
 void patchDirectJump(uintptr_t from, uintptr_t to);
 void unpatchDirectJump(uintptr_t from, uintptr_t to);
+// atomically point a site already chained by patchDirectJump to another
+// translation, safe while other threads run through it.
+void retargetDirectJump(uintptr_t from, uintptr_t to);
 }
 #endif /* TCGGENERATOR_H */
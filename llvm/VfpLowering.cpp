@@ -0,0 +1,193 @@
+#include <pthread.h>
+#include <unordered_map>
+#include "log.h"
+#include "LLVMAPI.h"
+#include "Output.h"
+#include "QEMUDisasContext.h"
+#include "VfpLowering.h"
+
+namespace jit {
+namespace {
+enum class VfpKind {
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Compare,
+    Extend,
+    Truncate,
+    FromUnsigned,
+    FromSigned,
+    ToUnsignedZero,
+    ToSignedZero,
+};
+
+struct VfpOp {
+    const char* m_name;
+    VfpKind m_kind;
+    bool m_double;
+    int m_statusArg;
+};
+
+const VfpOp vfpOps[] = {
+    { "vfp_adds", VfpKind::Add, false, 2 },
+    { "vfp_addd", VfpKind::Add, true, 2 },
+    { "vfp_subs", VfpKind::Sub, false, 2 },
+    { "vfp_subd", VfpKind::Sub, true, 2 },
+    { "vfp_muls", VfpKind::Mul, false, 2 },
+    { "vfp_muld", VfpKind::Mul, true, 2 },
+    { "vfp_divs", VfpKind::Div, false, 2 },
+    { "vfp_divd", VfpKind::Div, true, 2 },
+    // the signalling compares differ only for NaNs, which the helper does.
+    { "vfp_cmps", VfpKind::Compare, false, -1 },
+    { "vfp_cmpd", VfpKind::Compare, true, -1 },
+    { "vfp_cmpes", VfpKind::Compare, false, -1 },
+    { "vfp_cmped", VfpKind::Compare, true, -1 },
+    { "vfp_fcvtds", VfpKind::Extend, false, -1 },
+    { "vfp_fcvtsd", VfpKind::Truncate, true, -1 },
+    { "vfp_uitos", VfpKind::FromUnsigned, false, 1 },
+    { "vfp_uitod", VfpKind::FromUnsigned, true, 1 },
+    { "vfp_sitos", VfpKind::FromSigned, false, 1 },
+    { "vfp_sitod", VfpKind::FromSigned, true, 1 },
+    { "vfp_touizs", VfpKind::ToUnsignedZero, false, 1 },
+    { "vfp_touizd", VfpKind::ToUnsignedZero, true, 1 },
+    { "vfp_tosizs", VfpKind::ToSignedZero, false, 1 },
+    { "vfp_tosizd", VfpKind::ToSignedZero, true, 1 },
+};
+
+pthread_once_t vfpOpsOnce = PTHREAD_ONCE_INIT;
+std::unordered_map<void*, const VfpOp*>* vfpOpsByHelper;
+
+void initVfpOps()
+{
+    vfpOpsByHelper = new std::unordered_map<void*, const VfpOp*>();
+    for (const VfpOp& op : vfpOps) {
+        void* func = qemu::helperByName(op.m_name);
+        EMASSERT(func != nullptr);
+        vfpOpsByHelper->insert(std::make_pair(func, &op));
+    }
+}
+
+const VfpOp* findVfpOp(void* func)
+{
+    pthread_once(&vfpOpsOnce, initVfpOps);
+    auto found = vfpOpsByHelper->find(func);
+    return found == vfpOpsByHelper->end() ? nullptr : found->second;
+}
+}
+
+bool isLoweredVfpHelper(void* func, int* statusArg)
+{
+    const VfpOp* op = findVfpOp(func);
+    if (!op)
+        return false;
+    *statusArg = op->m_statusArg;
+    return true;
+}
+
+LValue checkVfpOperands(Output& output, void* func, const LValue* args)
+{
+    const VfpOp* op = findVfpOp(func);
+    EMASSERT(op != nullptr);
+    const CommonValues& repo = output.repo();
+    LType floatType = op->m_double ? repo.doubleType : repo.floatType;
+    switch (op->m_kind) {
+    case VfpKind::Add:
+    case VfpKind::Sub:
+    case VfpKind::Mul:
+    case VfpKind::Div:
+    case VfpKind::Compare: {
+        LValue a = output.buildBitCast(args[0], floatType);
+        LValue b = output.buildBitCast(args[1], floatType);
+        return output.buildFCmp(LLVMRealORD, a, b);
+    }
+    case VfpKind::Extend:
+    case VfpKind::Truncate: {
+        LValue a = output.buildBitCast(args[0], floatType);
+        return output.buildFCmp(LLVMRealORD, a, a);
+    }
+    case VfpKind::FromUnsigned:
+    case VfpKind::FromSigned:
+        return repo.booleanTrue;
+    case VfpKind::ToUnsignedZero:
+    case VfpKind::ToSignedZero: {
+        // the helper saturates, fptoui and fptosi are undefined out of range.
+        LValue a = output.buildBitCast(args[0], floatType);
+        bool isSigned = op->m_kind == VfpKind::ToSignedZero;
+        LValue low = constReal(floatType, isSigned ? -2147483648.0 : -1.0);
+        LValue high = constReal(floatType, isSigned ? 2147483648.0 : 4294967296.0);
+        LValue aboveLow = output.buildFCmp(isSigned ? LLVMRealOGE : LLVMRealOGT, a, low);
+        LValue belowHigh = output.buildFCmp(LLVMRealOLT, a, high);
+        return output.buildAnd(aboveLow, belowHigh);
+    }
+    }
+    EMUNREACHABLE();
+}
+
+void lowerVfpHelper(Output& output, void* func, const LValue* args, LValue fpscr, VfpLowering* lowering)
+{
+    const VfpOp* op = findVfpOp(func);
+    EMASSERT(op != nullptr);
+    const CommonValues& repo = output.repo();
+    LType floatType = op->m_double ? repo.doubleType : repo.floatType;
+    LType intType = op->m_double ? repo.int64 : repo.int32;
+    lowering->m_value = nullptr;
+    lowering->m_fpscr = nullptr;
+    switch (op->m_kind) {
+    case VfpKind::Add:
+    case VfpKind::Sub:
+    case VfpKind::Mul:
+    case VfpKind::Div: {
+        LValue a = output.buildBitCast(args[0], floatType);
+        LValue b = output.buildBitCast(args[1], floatType);
+        LValue r;
+        if (op->m_kind == VfpKind::Add)
+            r = output.buildFAdd(a, b);
+        else if (op->m_kind == VfpKind::Sub)
+            r = output.buildFSub(a, b);
+        else if (op->m_kind == VfpKind::Mul)
+            r = output.buildFMul(a, b);
+        else
+            r = output.buildFDiv(a, b);
+        // an invalid op of ordered operands gives the ARM default NaN,
+        // x86 sets the sign of its own.
+        LValue defaultNaN = op->m_double ? output.constInt64(0x7ff8000000000000LL) : output.constInt32(0x7fc00000);
+        lowering->m_value = output.buildSelect(output.buildFCmp(LLVMRealORD, r, r), output.buildBitCast(r, intType), defaultNaN);
+        break;
+    }
+    case VfpKind::Compare: {
+        LValue a = output.buildBitCast(args[0], floatType);
+        LValue b = output.buildBitCast(args[1], floatType);
+        LValue less = output.buildFCmp(LLVMRealOLT, a, b);
+        LValue equal = output.buildFCmp(LLVMRealOEQ, a, b);
+        LValue flags = output.buildSelect(less, output.constInt32(0x8), output.buildSelect(equal, output.constInt32(0x6), output.constInt32(0x2)));
+        LValue rest = output.buildAnd(fpscr, output.constInt32(0x0fffffff));
+        lowering->m_fpscr = output.buildOr(rest, output.buildShl(flags, output.constInt32(28)));
+        break;
+    }
+    case VfpKind::Extend: {
+        LValue a = output.buildBitCast(args[0], repo.floatType);
+        lowering->m_value = output.buildBitCast(output.buildCast(LLVMFPExt, a, repo.doubleType), repo.int64);
+        break;
+    }
+    case VfpKind::Truncate: {
+        LValue a = output.buildBitCast(args[0], repo.doubleType);
+        lowering->m_value = output.buildBitCast(output.buildCast(LLVMFPTrunc, a, repo.floatType), repo.int32);
+        break;
+    }
+    case VfpKind::FromUnsigned:
+    case VfpKind::FromSigned: {
+        LLVMOpcode opcode = op->m_kind == VfpKind::FromSigned ? LLVMSIToFP : LLVMUIToFP;
+        lowering->m_value = output.buildBitCast(output.buildCast(opcode, args[0], floatType), intType);
+        break;
+    }
+    case VfpKind::ToUnsignedZero:
+    case VfpKind::ToSignedZero: {
+        LValue a = output.buildBitCast(args[0], floatType);
+        bool isSigned = op->m_kind == VfpKind::ToSignedZero;
+        lowering->m_value = output.buildCast(isSigned ? LLVMFPToSI : LLVMFPToUI, a, repo.int32);
+        break;
+    }
+    }
+}
+}
@@ -0,0 +1,38 @@
+#ifndef VFPLOWERING_H
+#define VFPLOWERING_H
+#include "AbbreviatedTypes.h"
+namespace jit {
+class Output;
+
+// Native IR for the softfloat VFP helpers: fadd, fsub, fmul, fdiv, fcmp,
+// fpext, fptrunc and the integer conversions, which the x86 backend
+// selects as SSE2 scalar instructions. The result is the helper's only
+// under the default FPSCR, round to nearest without flush to zero, and
+// when no NaN and no out of range conversion is involved, because ARM
+// and x86 choose NaNs and saturate differently. The caller checks the
+// FPSCR and checkVfpOperands first and builds the native op only where
+// both pass, running the helper otherwise, so no native instruction runs
+// in another mode. The exception flags of the native instructions
+// collect in MXCSR, which the dispatcher clears on entry and folds into
+// env on exit, see vfp_get_fpscr.
+struct VfpLowering {
+    // the value the helper returns, null for the compares.
+    LValue m_value;
+    // the FPSCR the compares leave, null for the others.
+    LValue m_fpscr;
+};
+
+// FPSCR bits that must be clear for the native lowering: the rounding
+// mode and FZ.
+enum { vfpNativeFpscrMask = (3 << 22) | (1 << 24) };
+
+// statusArg is set to the argument that holds the float_status pointer,
+// or -1 if the helper takes env and uses vfp.fp_status. False if func is
+// not lowered.
+bool isLoweredVfpHelper(void* func, int* statusArg);
+// i1, whether the native op computes what func does for args under the
+// default FPSCR. The checks are quiet compares of the operands.
+LValue checkVfpOperands(Output& output, void* func, const LValue* args);
+void lowerVfpHelper(Output& output, void* func, const LValue* args, LValue fpscr, VfpLowering* lowering);
+}
+#endif /* VFPLOWERING_H */
@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+"""
+Compile the qemu helpers to one LLVM bitcode module and write it out as a C
+array, helperBitcode/helperBitcodeSize, for HelperLibrary to load.
+Without a working clang the array is empty and every helper stays a call.
+
+usage: helperbitcode.py --clang CLANG --llvm-link LINK --output OUT.c
+                        [--arch ia32|x64] [-Idir] [-Dmacro] source.c...
+
+--arch is the gyp target_arch of the build, ia32 by default. HelperLibrary
+refuses bitcode whose triple is not the one the JIT emits for.
+"""
+import os
+import subprocess
+import sys
+import tempfile
+
+# the clang flag for each gyp target_arch.
+ARCH_FLAGS = {'ia32': '-m32', 'x64': '-m64'}
+
+
+def parse_args(argv):
+    options = {'--clang': None, '--llvm-link': None, '--output': None,
+               '--arch': 'ia32'}
+    flags = []
+    sources = []
+    i = 0
+    while i < len(argv):
+        arg = argv[i]
+        if arg in options:
+            options[arg] = argv[i + 1]
+            i += 2
+            continue
+        if arg in ('-m32', '-m64'):
+            options['--arch'] = 'ia32' if arg == '-m32' else 'x64'
+            i += 1
+            continue
+        if arg.startswith('-I') or arg.startswith('-D'):
+            flags.append(arg)
+        else:
+            sources.append(arg)
+        i += 1
+    return options, flags, sources
+
+
+def build_bitcode(clang, link, arch, flags, sources, workdir):
+    objects = []
+    for source in sources:
+        name = os.path.splitext(os.path.basename(source))[0]
+        output = os.path.join(workdir, name + '.bc')
+        # the same target and layout as the code the JIT emits, no debug
+        # info to clone into every module.
+        subprocess.check_call([clang, arch, '-msse2', '-O2', '-emit-llvm',
+                               '-c', '-o', output] + flags + [source])
+        objects.append(output)
+    combined = os.path.join(workdir, 'helpers.bc')
+    subprocess.check_call([link, '-o', combined] + objects)
+    with open(combined, 'rb') as f:
+        return bytearray(f.read())
+
+
+def write_array(path, data):
+    with open(path, 'w') as out:
+        out.write('/* generated by helperbitcode.py, do not edit. */\n')
+        out.write('#include <stddef.h>\n')
+        # a zero length array is not C, keep one byte and report size 0.
+        out.write('const unsigned char helperBitcode[] = {\n')
+        for i in range(0, max(len(data), 1), 16):
+            chunk = data[i:i + 16] or bytearray(1)
+            out.write('    ' + ', '.join('0x%02x' % b for b in chunk) + ',\n')
+        out.write('};\n')
+        out.write('const size_t helperBitcodeSize = %d;\n' % len(data))
+
+
+def main(argv):
+    options, flags, sources = parse_args(argv[1:])
+    if options['--arch'] not in ARCH_FLAGS:
+        sys.stderr.write('helperbitcode.py: unknown arch %s\n' % options['--arch'])
+        return 1
+    workdir = tempfile.mkdtemp()
+    try:
+        data = build_bitcode(options['--clang'], options['--llvm-link'],
+                             ARCH_FLAGS[options['--arch']], flags, sources, workdir)
+    except (OSError, subprocess.CalledProcessError) as e:
+        sys.stderr.write('helperbitcode.py: no helper bitcode, %s\n' % e)
+        data = bytearray()
+    finally:
+        for name in os.listdir(workdir):
+            os.remove(os.path.join(workdir, name))
+        os.rmdir(workdir)
+    write_array(options['--output'], data)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
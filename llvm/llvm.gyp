@@ -3,28 +3,66 @@
         'llvm.gypi',
     ],
     'targets': [
+        {
+            'target_name': 'helper_bitcode',
+            'type': 'none',
+            'actions': [
+                {
+                    'action_name': 'embed_helper_bitcode',
+                    'inputs': [
+                        'helperbitcode.py',
+                        '<@(helper_bitcode_sources)',
+                    ],
+                    'outputs': [
+                        '<(SHARED_INTERMEDIATE_DIR)/HelperBitcode.c',
+                    ],
+                    'action': [
+                        'python', 'helperbitcode.py',
+                        '--clang', '<(helper_clang)',
+                        '--llvm-link', '<!(<(llvm_config) --bindir)/llvm-link',
+                        '--output', '<(SHARED_INTERMEDIATE_DIR)/HelperBitcode.c',
+                        '--arch', '<(target_arch)',
+                        '-I.', '-I../qemu',
+                        '-DLLVMLOG_LEVEL=<(llvmlog_level)',
+                        '<@(helper_bitcode_sources)',
+                    ],
+                },
+            ],
+        },
         {
             'target_name': 'libllvm',
             'type': 'static_library',
-            'sources': [ '<@(sources)',],
+            'dependencies': [
+                'helper_bitcode',
+            ],
+            'sources': [
+                '<@(sources)',
+                '<(SHARED_INTERMEDIATE_DIR)/HelperBitcode.c',
+            ],
             'include_dirs': [
                 '.',
                 '<(DEPTH)/qemu',
+                '<!@(<(llvm_config) --includedir)',
             ],
             'defines': [
                 'LLVMLOG_LEVEL=<(llvmlog_level)',
+                '__STDC_CONSTANT_MACROS',
+                '__STDC_LIMIT_MACROS',
             ],
             'direct_dependent_settings': {
                 'include_dirs': [
                     '.',
                     '<(DEPTH)/qemu',
+                    '<!@(<(llvm_config) --includedir)',
                 ],
                 'libraries': [
+                    '<!@(<(llvm_config) --libs <(llvm_components))',
                     '-ldl',
                     '-lpthread',
                     '-lz',
                 ],
                 'ldflags': [
+                    '<!@(<(llvm_config) --ldflags)',
                 ],
                 'defines': [
                     'LLVMLOG_LEVEL=<(llvmlog_level)',
@@ -25,6 +25,16 @@ public:
     virtual void gen_add2_i32(TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
         TCGv_i32 ah, TCGv_i32 bl, TCGv_i32 bh)
         = 0;
+    // dest = t0 + t1, or t0 + t1 + cf with carry, and the ARM flags of
+    // it: nf and zf get the sum, cf the carry out as 0 or 1 and vf the
+    // signed overflow in bit 31.
+    virtual void gen_add_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry)
+        = 0;
+    // dest = t0 - t1, or t0 + ~t1 + cf with carry, and its flags likewise.
+    virtual void gen_sub_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry)
+        = 0;
 
     virtual void gen_add_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) = 0;
     virtual void gen_add_i64(TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2) = 0;
@@ -51,6 +61,16 @@ public:
         = 0;
     virtual void gen_mov_i32(TCGv_i32 ret, TCGv_i32 arg) = 0;
     virtual void gen_exit_tb(int direct) = 0;
+    // direct exit to guest pc dest, the pc is already stored. link is
+    // set when dest is the target of a BL.
+    virtual void gen_goto_tb(target_ulong dest, bool link) = 0;
+    // exit to the pc the block stored, at the end of a block that ends
+    // in an indirect branch.
+    virtual void gen_exit_indirect() = 0;
+    // the code generated in between serves the baseline tier only, such
+    // as its profiling, and is left out of op recordings.
+    virtual void begin_baseline_only() = 0;
+    virtual void end_baseline_only() = 0;
     virtual void gen_ext16s_i32(TCGv_i32 ret, TCGv_i32 arg) = 0;
     virtual void gen_ext16u_i32(TCGv_i32 ret, TCGv_i32 arg) = 0;
     virtual void gen_ext32u_i64(TCGv_i64 ret, TCGv_i64 arg) = 0;
@@ -127,5 +147,10 @@ public:
         = 0;
     virtual void func_start() = 0;
     virtual bool should_continue() = 0;
+    virtual void gen_insn_start(target_ulong pc, uint32_t condexec) = 0;
+    // the GuestStateMap stored behind the code, valid after link().
+    virtual const uint8_t* guest_state_map() = 0;
+    // where the generated code is entered, valid after link().
+    virtual void* code_entry() = 0;
 };
 #endif /* DISASCONTEXTBASE_H */
@@ -6,6 +6,7 @@
 #include "compatglib.h"
 #include "QEMUDisasContext.h"
 #include "ExecutableMemoryAllocator.h"
+#include "GuestStateMap.h"
 #include "log.h"
 
 #ifndef ARRAY_SIZE
@@ -56,6 +57,8 @@ int gen_new_label(TCGContext* s)
 
 struct QEMUDisasContext::QEMUDisasContextImpl {
     jit::ExecutableMemoryAllocator* m_allocator;
+    const uint8_t* m_guestStateMap;
+    void* m_codeEntry;
     TCGContext m_tcgCtx;
 };
 
@@ -154,6 +157,7 @@ static void tcg_func_start(TCGContext* s)
 
     s->gen_opc_ptr = s->gen_opc_buf;
     s->gen_opparam_ptr = s->gen_opparam_buf;
+    s->gen_insn_count = 0;
 }
 
 void tcg_pool_reset(TCGContext* s)
@@ -698,6 +702,53 @@ static void tcg_set_frame(TCGContext* s, int reg, intptr_t start, intptr_t size)
     s->frame_reg = reg;
 }
 
+static const TCGHelperInfo* lookup_helper(void* func)
+{
+    pthread_once(&tcgInitOnce, tcg_init_common);
+    return static_cast<const TCGHelperInfo*>(g_hash_table_lookup(helper_table, func));
+}
+
+bool helperReadsGlobals(void* func)
+{
+    const TCGHelperInfo* info = lookup_helper(func);
+    return !info || !(info->flags & TCG_CALL_NO_READ_GLOBALS);
+}
+
+bool helperWritesGlobals(void* func)
+{
+    // not reading globals implies not writing them.
+    const TCGHelperInfo* info = lookup_helper(func);
+    return !info || !(info->flags & (TCG_CALL_NO_READ_GLOBALS | TCG_CALL_NO_WRITE_GLOBALS));
+}
+
+const char* helperName(void* func)
+{
+    const TCGHelperInfo* info = lookup_helper(func);
+    return info ? info->name : nullptr;
+}
+
+void* helperByName(const char* name)
+{
+    for (int i = 0; i < ARRAY_SIZE(all_helpers); ++i) {
+        if (strcmp(all_helpers[i].name, name) == 0)
+            return all_helpers[i].func;
+    }
+    return nullptr;
+}
+
+bool helperHasSideEffects(void* func)
+{
+    const TCGHelperInfo* info = lookup_helper(func);
+    return !info || !(info->flags & TCG_CALL_NO_SIDE_EFFECTS);
+}
+
+bool helperIs64Bit(void* func, int index)
+{
+    const TCGHelperInfo* info = lookup_helper(func);
+    EMASSERT(info != nullptr);
+    return (info->sizemask >> (index * 2)) & 1;
+}
+
 static void tcg_context_init(TCGContext* s)
 {
     memset(s, 0, sizeof(*s));
@@ -713,7 +764,7 @@ static void tcg_context_init(TCGContext* s)
 }
 
 QEMUDisasContext::QEMUDisasContext(jit::ExecutableMemoryAllocator* allocator, void* dispDirect, void* dispIndirect, void* dispHot, void* hotObject)
-    : m_impl(new QEMUDisasContextImpl({ allocator }))
+    : m_impl(new QEMUDisasContextImpl({ allocator, nullptr, nullptr }))
 {
     tcg_context_init(&m_impl->m_tcgCtx);
     m_impl->m_tcgCtx.dispDirect = dispDirect;
@@ -877,6 +928,46 @@ void QEMUDisasContext::gen_add2_i32(TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
     }
 }
 
+void QEMUDisasContext::gen_add_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+    TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry)
+{
+    TCGv_i32 tmp = temp_new_i32();
+    gen_movi_i32(tmp, 0);
+    if (carry) {
+        gen_add2_i32(nf, cf, t0, tmp, cf, tmp);
+        gen_add2_i32(nf, cf, nf, cf, t1, tmp);
+    }
+    else {
+        gen_add2_i32(nf, cf, t0, tmp, t1, tmp);
+    }
+    gen_mov_i32(zf, nf);
+    gen_xor_i32(vf, nf, t0);
+    gen_xor_i32(tmp, t0, t1);
+    gen_andc_i32(vf, vf, tmp);
+    temp_free_i32(tmp);
+    gen_mov_i32(dest, nf);
+}
+
+void QEMUDisasContext::gen_sub_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+    TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry)
+{
+    TCGv_i32 tmp = temp_new_i32();
+    if (carry) {
+        gen_not_i32(tmp, t1);
+        gen_add_cc_i32(nf, zf, cf, vf, dest, t0, tmp, true);
+        temp_free_i32(tmp);
+        return;
+    }
+    gen_sub_i32(nf, t0, t1);
+    gen_mov_i32(zf, nf);
+    gen_setcond_i32(TCG_COND_GEU, cf, t0, t1);
+    gen_xor_i32(vf, nf, t0);
+    gen_xor_i32(tmp, t0, t1);
+    gen_and_i32(vf, vf, tmp);
+    temp_free_i32(tmp);
+    gen_mov_i32(dest, nf);
+}
+
 void QEMUDisasContext::gen_add_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2)
 {
     gen_op3_i32(INDEX_op_add_i32, ret, arg1, arg2);
@@ -1213,6 +1304,24 @@ void QEMUDisasContext::gen_exit_tb(int direct)
     gen_op1i(INDEX_op_exit_tb, direct);
 }
 
+void QEMUDisasContext::gen_goto_tb(target_ulong dest, bool link)
+{
+    gen_exit_tb(1);
+}
+
+void QEMUDisasContext::gen_exit_indirect()
+{
+    gen_exit_tb(0);
+}
+
+void QEMUDisasContext::begin_baseline_only()
+{
+}
+
+void QEMUDisasContext::end_baseline_only()
+{
+}
+
 void QEMUDisasContext::gen_ext16s_i32(TCGv_i32 ret, TCGv_i32 arg)
 {
     if (TCG_TARGET_HAS_ext16s_i32) {
@@ -2016,6 +2125,21 @@ bool QEMUDisasContext::should_continue()
     return m_impl->m_tcgCtx.gen_opc_ptr < (&m_impl->m_tcgCtx.gen_opc_buf[0]) + OPC_MAX_SIZE;
 }
 
+void QEMUDisasContext::gen_insn_start(target_ulong pc, uint32_t condexec)
+{
+    gen_op2ii(INDEX_op_debug_insn_start, pc, condexec);
+}
+
+const uint8_t* QEMUDisasContext::guest_state_map()
+{
+    return m_impl->m_guestStateMap;
+}
+
+void* QEMUDisasContext::code_entry()
+{
+    return m_impl->m_codeEntry;
+}
+
 void QEMUDisasContext::temp_free_internal(int idx)
 {
     TCGContext* s = &m_impl->m_tcgCtx;
@@ -3131,7 +3255,10 @@ static inline int tcg_gen_code_common(TCGContext* s,
                 s->op_sync_args[op_index]);
             break;
         case INDEX_op_debug_insn_start:
-            /* debug instruction */
+            s->gen_insn_host_off[s->gen_insn_count] = tcg_current_code_size(s);
+            s->gen_insn_pc[s->gen_insn_count] = args[0];
+            s->gen_insn_condexec[s->gen_insn_count] = args[1];
+            s->gen_insn_count++;
             break;
         case INDEX_op_nop:
         case INDEX_op_nop1:
@@ -3213,9 +3340,20 @@ void QEMUDisasContext::compile()
     static const size_t codeBufferSize = 4096;
     std::vector<tcg_insn_unit> genCodeBuffer(codeBufferSize);
     tcg_insn_unit* gen_code_buf = const_cast<tcg_insn_unit*>(genCodeBuffer.data());
-    int size = tcg_gen_code(&m_impl->m_tcgCtx, gen_code_buf);
-    void* dst = m_impl->m_allocator->allocate(size, 0);
+    TCGContext* s = &m_impl->m_tcgCtx;
+    int size = tcg_gen_code(s, gen_code_buf);
+
+    // the guest state map lives right behind the code.
+    jit::GuestStateMapEncoder encoder(s->gen_insn_count ? s->gen_insn_pc[0] : 0);
+    for (int i = 0; i < s->gen_insn_count; ++i) {
+        encoder.append(s->gen_insn_host_off[i], s->gen_insn_pc[i], s->gen_insn_condexec[i]);
+    }
+    const std::vector<uint8_t>& map = encoder.finish();
+    uint8_t* dst = static_cast<uint8_t*>(m_impl->m_allocator->allocate(size + map.size(), 64));
     memcpy(dst, gen_code_buf, size);
+    memcpy(dst + size, map.data(), map.size());
+    m_impl->m_guestStateMap = dst + size;
+    m_impl->m_codeEntry = dst;
 }
 
 void QEMUDisasContext::link()
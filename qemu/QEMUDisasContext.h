@@ -29,6 +29,10 @@ public:
     virtual void gen_add2_i32(TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
         TCGv_i32 ah, TCGv_i32 bl, TCGv_i32 bh)
         override;
+    virtual void gen_add_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry) override;
+    virtual void gen_sub_cc_i32(TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+        TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, bool carry) override;
 
     virtual void gen_add_i32(TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2) override;
     virtual void gen_add_i64(TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2) override;
@@ -55,6 +59,10 @@ public:
         override;
     virtual void gen_mov_i32(TCGv_i32 ret, TCGv_i32 arg) override;
     virtual void gen_exit_tb(int direct) override;
+    virtual void gen_goto_tb(target_ulong dest, bool link) override;
+    virtual void gen_exit_indirect() override;
+    virtual void begin_baseline_only() override;
+    virtual void end_baseline_only() override;
     virtual void gen_ext16s_i32(TCGv_i32 ret, TCGv_i32 arg) override;
     virtual void gen_ext16u_i32(TCGv_i32 ret, TCGv_i32 arg) override;
     virtual void gen_ext32u_i64(TCGv_i64 ret, TCGv_i64 arg) override;
@@ -132,6 +140,9 @@ public:
 
     virtual void func_start() override;
     virtual bool should_continue() override;
+    virtual void gen_insn_start(target_ulong pc, uint32_t condexec) override;
+    virtual const uint8_t* guest_state_map() override;
+    virtual void* code_entry() override;
 
 private:
     int global_mem_new_internal(TCGType type, int reg,
@@ -268,5 +279,19 @@ private:
     void temp_free_internal(int idx);
     std::unique_ptr<QEMUDisasContextImpl> m_impl;
 };
+// what a helper registered in helper.h may do to the TCG globals,
+// unknown functions do everything.
+bool helperReadsGlobals(void* func);
+bool helperWritesGlobals(void* func);
+// the name a helper is registered under, without the helper_ prefix, null
+// for unknown functions.
+const char* helperName(void* func);
+// the helper registered under name, null if there is none.
+void* helperByName(const char* name);
+// a helper without side effects writes no memory but what its flags allow.
+bool helperHasSideEffects(void* func);
+// whether the return value (index 0) or argument index - 1 of a helper is
+// 64 bits wide, by the sizemask it is registered with.
+bool helperIs64Bit(void* func, int index);
 }
 #endif /* QEMUDISASCONTEXT_H */
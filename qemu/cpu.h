@@ -196,6 +196,11 @@ typedef struct CPUARMState {
          */
         float_status fp_status;
         float_status standard_fp_status;
+        /* The softfloat flags the native VFP instructions of the LLVM
+         * tier raised in MXCSR, folded in whenever the dispatcher leaves
+         * translated code.
+         */
+        int native_exception_flags;
     } vfp;
     uint64_t exclusive_addr;
     uint64_t exclusive_val;
@@ -715,7 +720,15 @@ enum arm_cpu_mode {
 #define ENCODE_CP_REG(cp, is64, crn, crm, opc1, opc2) \
     (((cp) << 16) | ((is64) << 15) | ((crn) << 11) | ((crm) << 7) | ((opc1) << 3) | (opc2))
 #define g2h(x) ((void *)((unsigned long)(target_ulong)(x) + GUEST_BASE))
+#define h2g(x) ((uint32_t)((unsigned long)(x) - GUEST_BASE))
+#if defined(__x86_64__)
+/* Guest addresses stay 32 bits on a 64 bit host, the embedder maps the
+   guest address space at guest_base and sets it before translating.  */
+extern unsigned long guest_base;
+#define GUEST_BASE guest_base
+#else
 #define GUEST_BASE 0
+#endif
 
 static inline int arm_feature(CPUARMState *env, int feature)
 {
@@ -807,6 +820,9 @@ static inline bool arm_generate_debug_exceptions(CPUARMState *env)
 }
 uint32_t cpsr_read(CPUARMState *env);
 void cpsr_write(CPUARMState *env, uint32_t val, uint32_t mask);
+/* The dispatcher clears the MXCSR flags before it enters translated code,
+   and calls this when it leaves, before it restores the host's MXCSR.  */
+void vfp_fold_native_exception_flags(CPUARMState *env);
 void QEMU_NORETURN cpu_abort(CPUState *cpu, const char *fmt, ...)
     GCC_FMT_ATTR(2, 3);
 
@@ -49,6 +49,10 @@ static const ARMCPRegInfo cortexa15_cp_reginfo[] = {
 
 static void arm_cpu_reset(CPUState* s);
 
+#if defined(__x86_64__)
+unsigned long guest_base;
+#endif
+
 void cortex_a15_initfn(ARMCPU* cpu)
 {
     cpu->cp_regs = g_hash_table_new_full(g_int_hash, g_int_equal,
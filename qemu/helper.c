@@ -1071,6 +1071,49 @@ static inline int vfp_exceptbits_from_host(int host_bits)
     return target_bits;
 }
 
+/* The LLVM tier runs VFP arithmetic natively under the default FPSCR,
+   its exception flags collect in MXCSR.  MXCSR is shared with the host's
+   SSE code, so only the flags raised since the dispatcher entered
+   translated code are the guest's, see vfp_fold_native_exception_flags.  */
+static inline int vfp_native_exception_flags(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t mxcsr;
+    int host_bits = 0;
+
+    __asm__ __volatile__("stmxcsr %0" : "=m"(mxcsr));
+    if (mxcsr & 0x01)
+        host_bits |= float_flag_invalid;
+    if (mxcsr & 0x04)
+        host_bits |= float_flag_divbyzero;
+    if (mxcsr & 0x08)
+        host_bits |= float_flag_overflow;
+    if (mxcsr & 0x10)
+        host_bits |= float_flag_underflow;
+    if (mxcsr & 0x20)
+        host_bits |= float_flag_inexact;
+    return host_bits;
+#else
+    return 0;
+#endif
+}
+
+static inline void vfp_clear_native_exception_flags(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t mxcsr;
+
+    __asm__ __volatile__("stmxcsr %0" : "=m"(mxcsr));
+    mxcsr &= ~0x3f;
+    __asm__ __volatile__("ldmxcsr %0" : : "m"(mxcsr));
+#endif
+}
+
+void vfp_fold_native_exception_flags(CPUARMState *env)
+{
+    env->vfp.native_exception_flags |= vfp_native_exception_flags();
+}
+
 uint32_t HELPER(vfp_get_fpscr)(CPUARMState *env)
 {
     int i;
@@ -1081,6 +1124,10 @@ uint32_t HELPER(vfp_get_fpscr)(CPUARMState *env)
             | (env->vfp.vec_stride << 20);
     i = get_float_exception_flags(&env->vfp.fp_status);
     i |= get_float_exception_flags(&env->vfp.standard_fp_status);
+    /* called from translated code, MXCSR holds what the guest raised
+       since the dispatcher entered it.  */
+    i |= env->vfp.native_exception_flags;
+    i |= vfp_native_exception_flags();
     fpscr |= vfp_exceptbits_from_host(i);
     return fpscr;
 }
@@ -1149,6 +1196,8 @@ void HELPER(vfp_set_fpscr)(CPUARMState *env, uint32_t val)
     i = vfp_exceptbits_to_host(val);
     set_float_exception_flags(i, &env->vfp.fp_status);
     set_float_exception_flags(0, &env->vfp.standard_fp_status);
+    env->vfp.native_exception_flags = 0;
+    vfp_clear_native_exception_flags();
 }
 
 void vfp_set_fpscr(CPUARMState *env, uint32_t val)
@@ -11,6 +11,14 @@ struct TranslationBlock {
 #define CF_COUNT_MASK  0x7fff
 #define CF_LAST_IO     0x8000 /* Last insn may be an IO access.  */
     uint32_t icount;
+    /* decremented on every entry of the block, disp_hot(env, hot_object)
+       is called when it reaches zero.  NULL disables the counter.  */
+    int32_t *hot_counter;
+    void *disp_hot;
+    void *hot_object;
+    /* targets of the indirect exit are counted here, see
+       jit::IndirectProfile.  NULL disables the profile.  */
+    void *indirect_profile;
 };
 typedef struct TranslationBlock TranslationBlock;
 #endif /* TB_H */
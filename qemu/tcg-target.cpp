@@ -1926,11 +1926,24 @@ static inline void tcg_out_op(TCGContext* s, TCGOpcode opc,
         void* dest;
         if (args[0]) {
             dest = s->dispDirect;
+            /* keep the immediate in one cache line, so retargetDirectJump
+               can rewrite it atomically.  */
+            while (((tcg_current_code_size(s) + (TCG_TARGET_REG_BITS == 64 ? 2 : 1)) & 63) > 64 - TCG_TARGET_REG_BITS / 8) {
+                tcg_out8(s, 0x90);
+            }
         }
         else {
             dest = s->dispIndirect;
         }
+#if TCG_TARGET_REG_BITS == 64
+        /* always the 10 byte movq, patchDirectJump rewrites the site in
+           place and the dispatcher finds it 12 bytes before the return
+           address.  */
+        tcg_out_opc(s, OPC_MOVL_Iv + P_REXW + LOWREGMASK(TCG_REG_EAX), 0, TCG_REG_EAX, 0);
+        tcg_out64(s, (uintptr_t)dest);
+#else
         tcg_out_movi(s, TCG_TYPE_PTR, TCG_REG_EAX, (uintptr_t)dest);
+#endif
         tcg_out_modrm(s, OPC_GRP5,
             args[0] ? EXT5_CALLN_Ev : EXT5_JMPN_Ev, TCG_REG_EAX);
     } break;
@@ -2578,7 +2591,7 @@ static const TCGTargetOpDef x86_op_defs[] = {
 
 static int tcg_target_callee_save_regs[] = {
 #if TCG_TARGET_REG_BITS == 64
-    TCG_REG_RBP,
+    TCG_REG_RBP, /* Currently used for the global env. */
     TCG_REG_RBX,
 #if defined(_WIN64)
     TCG_REG_RDI,
@@ -2586,7 +2599,7 @@ static int tcg_target_callee_save_regs[] = {
 #endif
     TCG_REG_R12,
     TCG_REG_R13,
-    TCG_REG_R14, /* Currently used for the global env. */
+    TCG_REG_R14,
     TCG_REG_R15,
 #else
     TCG_REG_EBP, /* Currently used for the global env. */
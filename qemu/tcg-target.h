@@ -106,11 +106,7 @@ extern bool have_bmi1;
      ((ofs) == 0 && (len) == 16))
 #define TCG_TARGET_deposit_i64_valid    TCG_TARGET_deposit_i32_valid
 
-#if TCG_TARGET_REG_BITS == 64
-# define TCG_AREG0 TCG_REG_R14
-#else
-# define TCG_AREG0 TCG_REG_EBP
-#endif
+#define TCG_AREG0 TCG_REG_EBP
 
 static inline void flush_icache_range(uintptr_t start, uintptr_t stop)
 {
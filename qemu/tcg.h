@@ -447,6 +447,13 @@ struct TCGContext {
     uint16_t gen_opc_icount[OPC_BUF_SIZE];
     uint8_t gen_opc_instr_start[OPC_BUF_SIZE];
 
+    /* filled by tcg_gen_code from debug_insn_start, one entry per
+       guest instruction */
+    int gen_insn_count;
+    uint32_t gen_insn_host_off[OPC_BUF_SIZE];
+    target_ulong gen_insn_pc[OPC_BUF_SIZE];
+    uint8_t gen_insn_condexec[OPC_BUF_SIZE];
+
     /* Code generation.  Note that we specifically do not use tcg_insn_unit
        here, because there's too much arithmetic throughout that relies
        on addition and subtraction working on bytes.  Rely on the GCC
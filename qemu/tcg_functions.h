@@ -19,6 +19,10 @@ TCGv_i64 tcg_const_i64(DisasContext* s, int64_t val);
 
 void tcg_gen_add2_i32(DisasContext* s, TCGv_i32 rl, TCGv_i32 rh, TCGv_i32 al,
     TCGv_i32 ah, TCGv_i32 bl, TCGv_i32 bh);
+void tcg_gen_add_cc_i32(DisasContext* s, TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+    TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, int carry);
+void tcg_gen_sub_cc_i32(DisasContext* s, TCGv_i32 nf, TCGv_i32 zf, TCGv_i32 cf,
+    TCGv_i32 vf, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1, int carry);
 
 void tcg_gen_add_i32(DisasContext* s, TCGv_i32 ret, TCGv_i32 arg1, TCGv_i32 arg2);
 void tcg_gen_add_i64(DisasContext* s, TCGv_i64 ret, TCGv_i64 arg1, TCGv_i64 arg2);
@@ -42,6 +46,10 @@ void tcg_gen_deposit_i32(DisasContext* s, TCGv_i32 ret, TCGv_i32 arg1,
     unsigned int len);
 void tcg_gen_mov_i32(DisasContext* s, TCGv_i32 ret, TCGv_i32 arg);
 void tcg_gen_exit_tb(DisasContext* s, int direct);
+void tcg_gen_goto_tb(DisasContext* s, target_ulong dest, int link);
+void tcg_gen_exit_indirect(DisasContext* s);
+void tcg_begin_baseline_only(DisasContext* s);
+void tcg_end_baseline_only(DisasContext* s);
 void tcg_gen_ext16s_i32(DisasContext* s, TCGv_i32 ret, TCGv_i32 arg);
 void tcg_gen_ext16u_i32(DisasContext* s, TCGv_i32 ret, TCGv_i32 arg);
 void tcg_gen_ext32u_i64(DisasContext* s, TCGv_i64 ret, TCGv_i64 arg);
@@ -110,6 +118,7 @@ void tcg_gen_callN(DisasContext* s, void* func, TCGArg ret,
     int nargs, TCGArg* args);
 void tcg_func_start(DisasContext*s);
 bool tcg_should_continue(DisasContext*s);
+void tcg_gen_insn_start(DisasContext* s, target_ulong pc, uint32_t condexec);
 
 #ifdef __cplusplus
 }
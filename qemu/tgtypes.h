@@ -125,11 +125,9 @@ typedef target_long tcg_target_long;
 typedef target_ulong tcg_target_ulong;
 typedef intptr_t TCGArg;
 
-#if TCG_TARGET_REG_BITS == 64
-#define TCG_AREG0 TCG_REG_R14
-#else
+/* env stays in %ebp/%rbp on both hosts: the dispatcher sets it, and the
+   LLVM tier's frame pointer restores it at every exit.  */
 #define TCG_AREG0 TCG_REG_EBP
-#endif
 typedef enum {
     TCG_REG_EAX = 0,
     TCG_REG_ECX,
@@ -84,7 +84,7 @@ static inline int arm_dc_feature(DisasContext *dc, int feature)
 static inline uint16_t arm_lduw_code(CPUARMState *env, target_ulong addr,
                                      bool do_swap)
 {
-    uint16_t insn = lduw_le_p((const void*)addr);
+    uint16_t insn = lduw_le_p(g2h(addr));
     if (do_swap) {
         return bswap16(insn);
     }
@@ -126,7 +126,7 @@ static inline bool cp_access_ok(int current_el,
 
 #define cpu_ldl_code(env1, p) ldl_raw(p)
 #define ldl_raw(p) ldl_p(laddr((p)))
-#define laddr(x) (uint8_t *)(intptr_t)(x)
+#define laddr(x) (uint8_t *)g2h(x)
 #define ldl_p(p) ldl_le_p(p)
 
 static inline uint32_t arm_ldl_code(CPUARMState *env, target_ulong addr,
@@ -231,6 +231,50 @@ static void store_reg(DisasContext *s, int reg, TCGv_i32 var)
 #define gen_sxtb16(var) gen_helper_sxtb16(s, var, var)
 #define gen_uxtb16(var) gen_helper_uxtb16(s, var, var)
 
+/* Count block entries, tell the embedder once the block gets hot.  */
+static void gen_tb_start(DisasContext *s, TranslationBlock *tb)
+{
+    TCGv_ptr counter, func, obj;
+    TCGv_i32 count;
+    int skip;
+
+    if (!tb->hot_counter)
+        return;
+    tcg_begin_baseline_only(s);
+    counter = tcg_const_ptr(s, tb->hot_counter);
+    count = tcg_temp_new_i32(s);
+    tcg_gen_ld_i32(s, count, counter, 0);
+    tcg_gen_subi_i32(s, count, count, 1);
+    tcg_gen_st_i32(s, count, counter, 0);
+    skip = gen_new_label(s);
+    tcg_gen_brcondi_i32(s, TCG_COND_NE, count, 0, skip);
+    tcg_temp_free_i32(s, count);
+    tcg_temp_free_ptr(s, counter);
+    func = tcg_const_ptr(s, tb->disp_hot);
+    obj = tcg_const_ptr(s, tb->hot_object);
+    gen_helper_dispatch_hot(s, cpu_env, func, obj);
+    tcg_temp_free_ptr(s, func);
+    tcg_temp_free_ptr(s, obj);
+    gen_set_label(s, skip);
+    tcg_end_baseline_only(s);
+}
+
+/* Leave for the pc the block computed, counting it first if the block
+   profiles its indirect exit.  */
+static void gen_exit_indirect(DisasContext *s, TranslationBlock *tb)
+{
+    TCGv_ptr profile;
+
+    if (tb->indirect_profile) {
+        tcg_begin_baseline_only(s);
+        profile = tcg_const_ptr(s, tb->indirect_profile);
+        gen_helper_profile_indirect(s, cpu_env, profile);
+        tcg_temp_free_ptr(s, profile);
+        tcg_end_baseline_only(s);
+    }
+    tcg_gen_exit_indirect(s);
+}
+
 static void gen_tb_end(TranslationBlock *tb, int num_insns)
 {
 }
@@ -482,54 +526,25 @@ static void gen_sub_carry(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32
 /* dest = T0 + T1. Compute C, N, V and Z flags */
 static void gen_add_CC(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
 {
-    TCGv_i32 tmp = tcg_temp_new_i32(s);
-    tcg_gen_movi_i32(s, tmp, 0);
-    tcg_gen_add2_i32(s, cpu_NF, cpu_CF, t0, tmp, t1, tmp);
-    tcg_gen_mov_i32(s, cpu_ZF, cpu_NF);
-    tcg_gen_xor_i32(s, cpu_VF, cpu_NF, t0);
-    tcg_gen_xor_i32(s, tmp, t0, t1);
-    tcg_gen_andc_i32(s, cpu_VF, cpu_VF, tmp);
-    tcg_temp_free_i32(s, tmp);
-    tcg_gen_mov_i32(s, dest, cpu_NF);
+    tcg_gen_add_cc_i32(s, cpu_NF, cpu_ZF, cpu_CF, cpu_VF, dest, t0, t1, 0);
 }
 
 /* dest = T0 + T1 + CF.  Compute C, N, V and Z flags */
 static void gen_adc_CC(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
 {
-    TCGv_i32 tmp = tcg_temp_new_i32(s);
-    tcg_gen_movi_i32(s, tmp, 0);
-    tcg_gen_add2_i32(s, cpu_NF, cpu_CF, t0, tmp, cpu_CF, tmp);
-    tcg_gen_add2_i32(s, cpu_NF, cpu_CF, cpu_NF, cpu_CF, t1, tmp);
-    tcg_gen_mov_i32(s, cpu_ZF, cpu_NF);
-    tcg_gen_xor_i32(s, cpu_VF, cpu_NF, t0);
-    tcg_gen_xor_i32(s, tmp, t0, t1);
-    tcg_gen_andc_i32(s, cpu_VF, cpu_VF, tmp);
-    tcg_temp_free_i32(s, tmp);
-    tcg_gen_mov_i32(s, dest, cpu_NF);
+    tcg_gen_add_cc_i32(s, cpu_NF, cpu_ZF, cpu_CF, cpu_VF, dest, t0, t1, 1);
 }
 
 /* dest = T0 - T1. Compute C, N, V and Z flags */
 static void gen_sub_CC(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
 {
-    TCGv_i32 tmp;
-    tcg_gen_sub_i32(s, cpu_NF, t0, t1);
-    tcg_gen_mov_i32(s, cpu_ZF, cpu_NF);
-    tcg_gen_setcond_i32(s, TCG_COND_GEU, cpu_CF, t0, t1);
-    tcg_gen_xor_i32(s, cpu_VF, cpu_NF, t0);
-    tmp = tcg_temp_new_i32(s);
-    tcg_gen_xor_i32(s, tmp, t0, t1);
-    tcg_gen_and_i32(s, cpu_VF, cpu_VF, tmp);
-    tcg_temp_free_i32(s, tmp);
-    tcg_gen_mov_i32(s, dest, cpu_NF);
+    tcg_gen_sub_cc_i32(s, cpu_NF, cpu_ZF, cpu_CF, cpu_VF, dest, t0, t1, 0);
 }
 
 /* dest = T0 + ~T1 + CF.  Compute C, N, V and Z flags */
 static void gen_sbc_CC(DisasContext *s, TCGv_i32 dest, TCGv_i32 t0, TCGv_i32 t1)
 {
-    TCGv_i32 tmp = tcg_temp_new_i32(s);
-    tcg_gen_not_i32(s, tmp, t1);
-    gen_adc_CC(s, dest, t0, tmp);
-    tcg_temp_free_i32(s, tmp);
+    tcg_gen_sub_cc_i32(s, cpu_NF, cpu_ZF, cpu_CF, cpu_VF, dest, t0, t1, 1);
 }
 
 #define GEN_SHIFT(name)                                               \
@@ -3970,13 +3985,18 @@ static int disas_vfp_insn(DisasContext *s, uint32_t insn)
     return 0;
 }
 
-static inline void gen_goto_tb(DisasContext *s, target_ulong dest)
+/* link is set for a BL, dest then starts another guest function.  */
+static inline void gen_goto_tb(DisasContext *s, target_ulong dest, int link)
 {
     gen_set_pc_im(s, dest);
-    tcg_gen_exit_tb(s, 1);
+    /* Blocks of a region start outside IT blocks.  */
+    if (s->condexec_mask)
+        tcg_gen_exit_tb(s, 1);
+    else
+        tcg_gen_goto_tb(s, dest, link);
 }
 
-static inline void gen_jmp (DisasContext *s, uint32_t dest)
+static inline void gen_jmp_link(DisasContext *s, uint32_t dest, int link)
 {
     if (unlikely(s->singlestep_enabled || s->ss_active)) {
         /* An indirect jump so that we still trigger the debug exception.  */
@@ -3984,11 +4004,16 @@ static inline void gen_jmp (DisasContext *s, uint32_t dest)
             dest |= 1;
         gen_bx_im(s, dest);
     } else {
-        gen_goto_tb(s, dest);
+        gen_goto_tb(s, dest, link);
         s->is_jmp = DISAS_TB_JUMP;
     }
 }
 
+static inline void gen_jmp(DisasContext *s, uint32_t dest)
+{
+    gen_jmp_link(s, dest, 0);
+}
+
 static inline void gen_mulxy(DisasContext *s, TCGv_i32 t0, TCGv_i32 t1, int x, int y)
 {
     if (x)
@@ -8913,7 +8938,7 @@ static void disas_arm_insn(DisasContext *s, unsigned int insn)
                 }
                 offset = sextract32(insn << 2, 0, 26);
                 val += offset + 4;
-                gen_jmp(s, val);
+                gen_jmp_link(s, val, (insn >> 24) & 1);
             }
             break;
         case 0xc:
@@ -9728,7 +9753,7 @@ static int disas_thumb2_insn(CPUARMState *env, DisasContext *s, uint16_t insn_hw
                 offset += s->pc;
                 if (insn & (1 << 12)) {
                     /* b/bl */
-                    gen_jmp(s, offset);
+                    gen_jmp_link(s, offset, (insn >> 14) & 1);
                 } else {
                     /* blx */
                     offset &= ~(uint32_t)2;
@@ -11022,7 +11047,7 @@ void gen_intermediate_code_internal(ARMCPU* cpu,
     next_page_start = (pc_start & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
     num_insns = 0;
     max_insns = CF_COUNT_MASK;
-
+    gen_tb_start(dc, tb);
 
 
     /* A note on handling of the condexec (IT) bits:
@@ -11091,6 +11116,10 @@ void gen_intermediate_code_internal(ARMCPU* cpu,
             goto done_generating;
         }
 
+        /* Record pc and IT state for the host pc -> guest state map.  */
+        tcg_gen_insn_start(dc, dc->pc,
+                           (dc->condexec_cond << 4) | (dc->condexec_mask >> 1));
+
         if (dc->thumb) {
             disas_thumb_insn(env, dc);
             if (dc->condexec_mask) {
@@ -11186,13 +11215,13 @@ void gen_intermediate_code_internal(ARMCPU* cpu,
         gen_set_condexec(dc);
         switch(dc->is_jmp) {
         case DISAS_NEXT:
-            gen_goto_tb(dc, dc->pc);
+            gen_goto_tb(dc, dc->pc, 0);
             break;
         default:
         case DISAS_JUMP:
         case DISAS_UPDATE:
             /* indicate that the hash table must be used to find the next TB */
-            tcg_gen_exit_tb(dc, 0);
+            gen_exit_indirect(dc, tb);
             break;
         case DISAS_TB_JUMP:
             /* nothing more to generate */
@@ -11216,7 +11245,7 @@ void gen_intermediate_code_internal(ARMCPU* cpu,
         if (dc->condjmp) {
             gen_set_label(dc, dc->condlabel);
             gen_set_condexec(dc);
-            gen_goto_tb(dc, dc->pc);
+            gen_goto_tb(dc, dc->pc, 0);
             dc->condjmp = 0;
         }
     }
@@ -27,14 +27,14 @@ private:
     virtual bool check(const CPUARMState* state, const uintptr_t*, std::string& info) const override
     {
         RegisterOperation& op = RegisterOperation::getDefault();
-        const intptr_t* p = reinterpret_cast<const intptr_t*>(op.getRegisterPointer(state, m_regName));
+        const int32_t* p = reinterpret_cast<const int32_t*>(op.getRegisterPointer(state, m_regName));
         std::ostringstream oss;
-        oss << "CheckRegisterEqConst " << ((*p == static_cast<long>(m_val)) ? "PASSED" : "FAILED")
+        oss << "CheckRegisterEqConst " << ((*p == static_cast<int32_t>(m_val)) ? "PASSED" : "FAILED")
             << "; m_regName = " << m_regName
             << "; m_val = " << std::hex
             << m_val;
         info = oss.str();
-        return *p == static_cast<long>(m_val);
+        return *p == static_cast<int32_t>(m_val);
     }
     std::string m_regName;
     unsigned long long m_val;
@@ -52,7 +52,7 @@ private:
     virtual bool check(const CPUARMState* state, const uintptr_t*, std::string& info) const override
     {
         RegisterOperation& op = RegisterOperation::getDefault();
-        const intptr_t* p = reinterpret_cast<const intptr_t*>(op.getRegisterPointer(state, m_regName));
+        const int32_t* p = reinterpret_cast<const int32_t*>(op.getRegisterPointer(state, m_regName));
         float floatVal = bitCast<float>(*p);
         std::ostringstream oss;
         oss << "CheckRegisterEqFloatConst " << ((floatVal == m_val) ? "PASSED" : "FAILED")
@@ -78,8 +78,8 @@ private:
     virtual bool check(const CPUARMState* state, const uintptr_t*, std::string& info) const override
     {
         RegisterOperation& op = RegisterOperation::getDefault();
-        const uintptr_t* p1 = op.getRegisterPointer(state, m_regName1);
-        const uintptr_t* p2 = op.getRegisterPointer(state, m_regName2);
+        const uint32_t* p1 = op.getRegisterPointer(state, m_regName1);
+        const uint32_t* p2 = op.getRegisterPointer(state, m_regName2);
         std::ostringstream oss;
         oss << "CheckRegisterEq " << ((*p1 == *p2) ? "PASSED" : "FAILED")
             << "; m_regName1 = " << m_regName1
@@ -124,13 +124,13 @@ private:
     {
         std::ostringstream oss;
         RegisterOperation& op = RegisterOperation::getDefault();
-        const uintptr_t* p = op.getRegisterPointer(state, m_regName);
-        uintptr_t* const* pp = reinterpret_cast<uintptr_t* const*>(p);
-        oss << "CheckMemory " << (((**pp) == m_val) ? "PASSED" : "FAILED")
+        const uint32_t* p = op.getRegisterPointer(state, m_regName);
+        const uint32_t* memory = static_cast<const uint32_t*>(g2h(*p));
+        oss << "CheckMemory " << (((*memory) == m_val) ? "PASSED" : "FAILED")
             << "; m_val = " << std::hex << m_val
-            << "; memory = " << std::hex << **pp;
+            << "; memory = " << std::hex << *memory;
         info = oss.str();
-        return ((**pp) == m_val);
+        return ((*memory) == m_val);
     }
     std::string m_regName;
     unsigned long long m_val;
@@ -158,7 +158,7 @@ private:
     bool checkPrivate(const CPUARMState& env) const
     {
         RegisterOperation& op = RegisterOperation::getDefault();
-        const uintptr_t* pointer = op.getRegisterPointer(&env, m_regName);
+        const uint32_t* pointer = op.getRegisterPointer(&env, m_regName);
         switch (m_val->m_type) {
         case 64: {
             EMASSERT(m_val->m_intVec->size() <= 2);
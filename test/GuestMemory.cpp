@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <atomic>
+#include "log.h"
+#include "cpu.h"
+#include "GuestMemory.h"
+
+#if defined(__x86_64__)
+static const size_t guestSpaceSize = 256 * 1024 * 1024;
+// keep guest address 0 and the page after it free, as a null pointer.
+static const size_t guestSpaceStart = 64 * 1024;
+static std::atomic<size_t> guestSpaceUsed(guestSpaceStart);
+
+void initGuestMemory()
+{
+    void* space = mmap(nullptr, guestSpaceSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    EMASSERT(space != MAP_FAILED);
+    guest_base = reinterpret_cast<unsigned long>(space);
+}
+
+void* guestAlloc(size_t size)
+{
+    size = (size + 15) & ~static_cast<size_t>(15);
+    size_t offset = guestSpaceUsed.fetch_add(size);
+    EMASSERT(offset + size <= guestSpaceSize);
+    return g2h(offset);
+}
+
+void guestFree(void*)
+{
+    // the tests are short, the space is only given back at exit.
+}
+#else
+void initGuestMemory()
+{
+}
+
+void* guestAlloc(size_t size)
+{
+    return malloc(size);
+}
+
+void guestFree(void* p)
+{
+    free(p);
+}
+#endif
@@ -0,0 +1,12 @@
+#ifndef GUESTMEMORY_H
+#define GUESTMEMORY_H
+#include <stddef.h>
+
+// memory the guest code addresses: its code, stack and the buffers of
+// the memory register inits. On an x86-64 host it comes from a region
+// reserved at guest_base, so g2h and h2g translate the 32 bit guest
+// pointers; on x86 it is the host heap and guest_base is 0.
+void initGuestMemory();
+void* guestAlloc(size_t size);
+void guestFree(void* p);
+#endif /* GUESTMEMORY_H */
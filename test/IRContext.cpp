@@ -80,6 +80,12 @@ void contextSawCheckMemory(struct IRContext* context, const char* registerName,
     PUSH_BACK_CHECK(Check::createCheckMemory(registerName, val));
 }
 
+void contextSawCheckEnvLoads(struct IRContext* context, double maxPerInsn)
+{
+    LOGV("%s: maxPerInsn = %lf.\n", __FUNCTION__, maxPerInsn);
+    CONTEXT()->m_maxEnvLoadsPerInsn = maxPerInsn;
+}
+
 void contextYYError(int line, int column, struct IRContext* context, const char* reason, const char* text)
 {
     printf("line %d column %d: error:%s; text: %s.\n", line, column, reason, text);
@@ -18,6 +18,7 @@ void contextSawCheckVecRegsiterConst(struct IRContext* context, const char* regi
 void contextSawCheckRegister(struct IRContext* context, const char* registerName1, const char* registerName2);
 void contextSawCheckState(struct IRContext* context, unsigned long long val1);
 void contextSawCheckMemory(struct IRContext* context, const char* name, unsigned long long val2);
+void contextSawCheckEnvLoads(struct IRContext* context, double maxPerInsn);
 
 void contextYYError(int line, int column, struct IRContext* context, const char* reason, const char* text);
 
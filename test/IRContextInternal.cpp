@@ -3,5 +3,6 @@
 
 IRContextInternal::IRContextInternal()
     : m_thumb(false)
+    , m_maxEnvLoadsPerInsn(-1)
 {
 }
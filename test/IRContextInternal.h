@@ -14,6 +14,9 @@ struct IRContextInternal : IRContext {
     RegisterInitVector m_registerInit;
     CheckVector m_checks;
     bool m_thumb;
+    // CheckEnvLoads: the most CPUARMState loads per guest instruction the
+    // LLVM translations may keep, negative if not checked.
+    double m_maxEnvLoadsPerInsn;
     IRContextInternal();
 };
 
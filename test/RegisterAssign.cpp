@@ -8,7 +8,7 @@ RegisterAssign::RegisterAssign()
 RegisterAssign::~RegisterAssign() {}
 void RegisterAssign::assign(CPUARMState* state, const std::string& registerName, unsigned long long val)
 {
-    uintptr_t* p = RegisterOperation::getDefault().getRegisterPointer(state, registerName);
+    uint32_t* p = RegisterOperation::getDefault().getRegisterPointer(state, registerName);
     EMASSERT(p != nullptr);
     *p = val;
 }
@@ -4,6 +4,7 @@
 #include "RegisterInit.h"
 #include "RegisterOperation.h"
 #include "RegisterAssign.h"
+#include "GuestMemory.h"
 #include "Vec.h"
 RegisterInitControl::~RegisterInitControl() {}
 
@@ -66,7 +67,7 @@ void RegisterInitConstant::reset()
 RegisterInitMemory::~RegisterInitMemory()
 {
     if (m_buffer) {
-        free(m_buffer);
+        guestFree(m_buffer);
     }
 }
 
@@ -76,7 +77,7 @@ uintptr_t RegisterInitMemory::getVal()
         return 0;
     }
     EMASSERT(m_buffer == nullptr);
-    m_buffer = malloc(m_size);
+    m_buffer = guestAlloc(m_size);
     if (m_size == 1) {
         *static_cast<uint8_t*>(m_buffer) = static_cast<uint8_t>(m_val);
     }
@@ -86,8 +87,7 @@ uintptr_t RegisterInitMemory::getVal()
     else {
         *static_cast<uint32_t*>(m_buffer) = static_cast<uint32_t>(m_val);
     }
-    uintptr_t val = reinterpret_cast<uintptr_t>(m_buffer);
-    return val;
+    return h2g(m_buffer);
 }
 
 void RegisterInitMemory::init(CPUARMState& env, const std::string& name)
@@ -99,7 +99,7 @@ void RegisterInitMemory::init(CPUARMState& env, const std::string& name)
 void RegisterInitMemory::reset()
 {
     if (m_buffer) {
-        free(m_buffer);
+        guestFree(m_buffer);
         m_buffer = nullptr;
     }
 }
@@ -107,7 +107,7 @@ void RegisterInitMemory::reset()
 void RegisterInitNumVec::init(CPUARMState& env, const std::string& name)
 {
     RegisterOperation& op = RegisterOperation::getDefault();
-    uintptr_t* pointer = op.getRegisterPointer(&env, name);
+    uint32_t* pointer = op.getRegisterPointer(&env, name);
     switch (m_val->m_type) {
     case 64: {
         EMASSERT(m_val->m_intVec->size() <= 2);
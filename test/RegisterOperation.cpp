@@ -44,19 +44,19 @@ RegisterOperation::RegisterOperation()
 {
 }
 
-uintptr_t* RegisterOperation::getRegisterPointer(CPUARMState* state, const std::string& registerName)
+uint32_t* RegisterOperation::getRegisterPointer(CPUARMState* state, const std::string& registerName)
 {
-    const uintptr_t* ret = getRegisterPointer(static_cast<const CPUARMState*>(state), registerName);
-    return const_cast<uintptr_t*>(ret);
+    const uint32_t* ret = getRegisterPointer(static_cast<const CPUARMState*>(state), registerName);
+    return const_cast<uint32_t*>(ret);
 }
 
-const uintptr_t* RegisterOperation::getRegisterPointer(const CPUARMState* state, const std::string& registerName)
+const uint32_t* RegisterOperation::getRegisterPointer(const CPUARMState* state, const std::string& registerName)
 {
     auto found = m_map.find(registerName);
     if (found == m_map.end()) {
         return nullptr;
     }
-    return reinterpret_cast<const uintptr_t*>(reinterpret_cast<const char*>(state) + found->second);
+    return reinterpret_cast<const uint32_t*>(reinterpret_cast<const char*>(state) + found->second);
 }
 
 size_t RegisterOperation::getRegisterPointerOffset(const char* registerName)
@@ -9,8 +9,9 @@ class RegisterOperation {
 public:
     RegisterOperation(const RegisterOperation&) = delete;
     const RegisterOperation& operator=(const RegisterOperation&) = delete;
-    uintptr_t* getRegisterPointer(CPUARMState* state, const std::string& registerName);
-    const uintptr_t* getRegisterPointer(const CPUARMState* state, const std::string& registerName);
+    // the registers are 32 bit words of CPUARMState on either host.
+    uint32_t* getRegisterPointer(CPUARMState* state, const std::string& registerName);
+    const uint32_t* getRegisterPointer(const CPUARMState* state, const std::string& registerName);
     size_t getRegisterPointerOffset(const char* registerName);
     static RegisterOperation& getDefault();
 
@@ -0,0 +1,147 @@
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "log.h"
+#include "cpu.h"
+#include "ExecutableMemoryAllocator.h"
+#include "QEMUDisasContext.h"
+#include "LLVMDisasContext.h"
+#include "OpCapture.h"
+
+// Replays the blocks of a capture file, see OpCapture.h, into a backend
+// and reports the latency of compile and link and the code size. Nothing
+// runs, so no cpu or guest code is needed.
+
+class SizingExecutableMemoryAllocator : public jit::ExecutableMemoryAllocator {
+public:
+    SizingExecutableMemoryAllocator()
+        : m_buffer(nullptr)
+        , m_size(0)
+    {
+    }
+    ~SizingExecutableMemoryAllocator()
+    {
+        if (m_buffer) {
+            munmap(m_buffer, m_size);
+        }
+    }
+    inline size_t size() const { return m_size; }
+
+private:
+    virtual void* allocate(int size, int align) override
+    {
+        EMASSERT(m_buffer == nullptr);
+        m_size = size;
+        m_buffer = mmap(nullptr, m_size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        EMASSERT(m_buffer != MAP_FAILED);
+        return m_buffer;
+    }
+
+private:
+    void* m_buffer;
+    size_t m_size;
+};
+
+static char dispatchStub;
+
+static double elapsed(const struct timespec& t1, const struct timespec& t2)
+{
+    double t = t2.tv_sec - t1.tv_sec;
+    t += static_cast<double>(t2.tv_nsec - t1.tv_nsec) / 1e9;
+    return t;
+}
+
+static double percentile(const std::vector<double>& sorted, int p)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[(sorted.size() - 1) * p / 100];
+}
+
+int main(int argc, char** argv)
+{
+    bool optimal = false;
+    int rounds = 1;
+    int firstFile = 1;
+    for (; firstFile < argc && strncmp(argv[firstFile], "--", 2) == 0; ++firstFile) {
+        if (strcmp(argv[firstFile], "--llvm") == 0) {
+            optimal = true;
+        }
+        else if (strcmp(argv[firstFile], "--rounds") == 0 && firstFile + 1 < argc) {
+            rounds = atoi(argv[++firstFile]);
+        }
+        else {
+            break;
+        }
+    }
+    if (argc != firstFile + 1 || rounds <= 0) {
+        LOGE("usage: %s [--llvm] [--rounds N] capture-file\n", argv[0]);
+        exit(1);
+    }
+    jit::CaptureReader reader;
+    if (!reader.open(argv[firstFile]))
+        exit(1);
+    std::vector<double> latencies;
+    size_t codeSize = 0, blocks = 0;
+    uint64_t guestInsns = 0;
+    jit::OpRecording recording;
+    while (reader.next(recording)) {
+        blocks++;
+        guestInsns += recording.icount();
+        for (int i = 0; i < rounds; ++i) {
+            SizingExecutableMemoryAllocator allocator;
+            std::unique_ptr<DisasContextBase> ctx;
+            if (optimal)
+                ctx.reset(new jit::LLVMDisasContext(&allocator, &dispatchStub, &dispatchStub));
+            else
+                ctx.reset(new qemu::QEMUDisasContext(&allocator, &dispatchStub, &dispatchStub, nullptr, nullptr));
+            TranslationBlock tb = { recording.pc(), recording.flags() };
+            struct timespec t2, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            recording.replay(*ctx, &tb);
+            ctx->compile();
+            ctx->link();
+            clock_gettime(CLOCK_MONOTONIC, &t2);
+            latencies.push_back(elapsed(t1, t2));
+            if (i == 0)
+                codeSize += allocator.size();
+        }
+    }
+    if (!blocks) {
+        LOGE("%s: no blocks in %s.\n", argv[0], argv[firstFile]);
+        exit(1);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    LOGE("%s: %zu blocks, %llu guest instructions.\n", optimal ? "llvm" : "qemu", blocks, static_cast<unsigned long long>(guestInsns));
+    LOGE("latency: p50 %lf us, p90 %lf us, p99 %lf us.\n", percentile(latencies, 50) * 1e6, percentile(latencies, 90) * 1e6, percentile(latencies, 99) * 1e6);
+    LOGE("code size: %zu bytes in total, %zu bytes per block.\n", codeSize, codeSize / blocks);
+    if (optimal)
+        jit::CompileStats::dump();
+    return 0;
+}
+
+extern "C" {
+void helper_handle_swi(CPUARMState* env, int32_t ex);
+void helper_handle_kernel_trap(CPUARMState* env);
+void helper_handle_strex(CPUARMState* env);
+}
+
+void helper_handle_swi(CPUARMState* env, int32_t ex)
+{
+    EMUNREACHABLE();
+}
+
+void helper_handle_kernel_trap(CPUARMState* env)
+{
+    EMUNREACHABLE();
+}
+
+void helper_handle_strex(CPUARMState* env)
+{
+    EMUNREACHABLE();
+}
@@ -33,7 +33,7 @@ void yyerror(YYLTYPE* yylloc, struct IRContext* context, const char* reason)
 %token CHECKSTATE CHECKEQ CHECKMEMORY
 %token LEFT_BRACKET RIGHT_BRACKET MEMORY
 %token PLUS MINUS MULTIPLE DIVIDE
-%token CHECKEQFLOAT CHECKEQDOUBLE
+%token CHECKEQFLOAT CHECKEQDOUBLE CHECKENVLOADS
 %token <floatpoint> FLOATCONST
 %token DOT LEFT_BRACE RIGHT_BRACE
 %token <inttype> INTTYPE
@@ -173,5 +173,8 @@ check_statment:
     contextSawCheckVecRegsiterConst(context, $2, $3);
     free($2);
 }
+| CHECKENVLOADS FLOATCONST {
+    contextSawCheckEnvLoads(context, $2);
+}
 ;
 %%
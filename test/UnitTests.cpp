@@ -0,0 +1,271 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+#include "log.h"
+#include "cpu.h"
+#include "StackMaps.h"
+#include "RegionFormer.h"
+
+// Checks of the pieces of the jit that need no guest code and no
+// compiler, run on sections and profiles built in place.
+
+static int g_failures;
+
+#define UNIT_CHECK(p)                                                 \
+    do {                                                              \
+        if (!(p)) {                                                   \
+            fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #p); \
+            g_failures++;                                             \
+        }                                                             \
+    } while (0)
+
+namespace {
+// writes a .llvm_stackmaps section as LLVM 3.6 emits it, version 1.
+class StackMapWriter {
+public:
+    explicit StackMapWriter(uint32_t numRecords)
+    {
+        put<uint8_t>(1);
+        put<uint8_t>(0);
+        put<uint16_t>(0);
+        put<uint32_t>(1); // functions
+        put<uint32_t>(1); // constants
+        put<uint32_t>(numRecords);
+        put<uint64_t>(0x1000); // function address
+        put<uint64_t>(32); // stack size
+        put<int64_t>(0x123456789); // constant
+    }
+
+    void record(int64_t id, uint32_t instOffset, unsigned numLocations, unsigned numLiveOuts)
+    {
+        put<int64_t>(id);
+        put<uint32_t>(instOffset);
+        put<uint16_t>(0);
+        put<uint16_t>(numLocations);
+        for (unsigned i = 0; i < numLocations; ++i) {
+            put<uint8_t>(jit::StackMaps::Location::Register);
+            put<uint8_t>(4);
+            put<uint16_t>(dwarfReg(id, i));
+            put<int32_t>(static_cast<int32_t>(id * 16 + i));
+        }
+        put<uint16_t>(0); // padding
+        put<uint16_t>(numLiveOuts);
+        for (unsigned i = 0; i < numLiveOuts; ++i) {
+            put<uint16_t>(dwarfReg(id, i + 3));
+            put<uint8_t>(0);
+            put<uint8_t>(8);
+        }
+        if (m_data.size() & 7)
+            put<uint32_t>(0);
+    }
+
+    static uint16_t dwarfReg(int64_t id, unsigned i) { return (id + i) % 16; }
+
+    const uint8_t* data() const { return m_data.data(); }
+
+private:
+    template <typename T>
+    void put(T value)
+    {
+        size_t size = m_data.size();
+        m_data.resize(size + sizeof(T));
+        memcpy(&m_data[size], &value, sizeof(T));
+    }
+
+    std::vector<uint8_t> m_data;
+};
+}
+
+static void testStackMapReader()
+{
+    static const unsigned numLocations[] = { 3, 0, 5, 1, 2 };
+    static const unsigned numLiveOuts[] = { 2, 1, 0, 3, 0 };
+    const unsigned numRecords = sizeof(numLocations) / sizeof(numLocations[0]);
+    StackMapWriter writer(numRecords);
+    for (unsigned i = 0; i < numRecords; ++i)
+        writer.record(i + 1, 0x40 * i, numLocations[i], numLiveOuts[i]);
+
+    jit::DataView view(writer.data());
+    jit::StackMaps stackMaps;
+    UNIT_CHECK(stackMaps.parse(&view));
+    UNIT_CHECK(stackMaps.records.size() == numRecords);
+
+    jit::StackMapReader reader(writer.data());
+    jit::StackMapReader::Record record;
+    unsigned count = 0;
+    while (reader.next(record)) {
+        UNIT_CHECK(count < numRecords);
+        if (count >= numRecords)
+            break;
+        const jit::StackMaps::Record& expected = stackMaps.records[count];
+        UNIT_CHECK(record.patchpointID == count + 1);
+        UNIT_CHECK(record.patchpointID == expected.patchpointID);
+        UNIT_CHECK(record.instructionOffset == expected.instructionOffset);
+        UNIT_CHECK(record.numLocations == expected.locations.size());
+        UNIT_CHECK(record.numLiveOuts == expected.liveOuts.size());
+        for (unsigned i = 0; i < record.numLocations; ++i) {
+            jit::StackMaps::Location location = record.location(i);
+            UNIT_CHECK(location.kind == jit::StackMaps::Location::Register);
+            UNIT_CHECK(location.size == 4);
+            UNIT_CHECK(location.dwarfReg.dwarfRegNum() == StackMapWriter::dwarfReg(count + 1, i));
+            UNIT_CHECK(location.offset == expected.locations[i].offset);
+        }
+        for (unsigned i = 0; i < record.numLiveOuts; ++i) {
+            jit::StackMaps::LiveOut liveOut = record.liveOut(i);
+            UNIT_CHECK(liveOut.dwarfReg.dwarfRegNum() == StackMapWriter::dwarfReg(count + 1, i + 3));
+            UNIT_CHECK(liveOut.size == 8);
+        }
+        count++;
+    }
+    UNIT_CHECK(count == numRecords);
+}
+
+static void testStackMapReaderFailure()
+{
+    // a negative ID is how LLVM signals a failed compilation.
+    StackMapWriter writer(3);
+    writer.record(1, 0, 2, 1);
+    writer.record(-1, 0x10, 1, 0);
+    writer.record(3, 0x20, 0, 0);
+
+    jit::DataView view(writer.data());
+    jit::StackMaps stackMaps;
+    UNIT_CHECK(!stackMaps.parse(&view));
+
+    jit::StackMapReader reader(writer.data());
+    jit::StackMapReader::Record record;
+    UNIT_CHECK(reader.next(record));
+    UNIT_CHECK(record.patchpointID == 1);
+    UNIT_CHECK(!reader.next(record));
+    UNIT_CHECK(!reader.next(record));
+}
+
+typedef std::unordered_map<uint32_t, jit::BlockProfile> ProfileMap;
+
+static const jit::BlockProfile* lookupProfile(void* opaque, uint32_t pc)
+{
+    const ProfileMap* profiles = static_cast<const ProfileMap*>(opaque);
+    auto found = profiles->find(pc);
+    return found != profiles->end() ? &found->second : nullptr;
+}
+
+// a block that ran executions times and took its direct exits to
+// successor0 and successor1 edge0 and edge1 times.
+static jit::BlockProfile& addBlock(ProfileMap& profiles, uint32_t pc, uint32_t executions, uint32_t successor0 = 0, uint32_t edge0 = 0, uint32_t successor1 = 0, uint32_t edge1 = 0, uint64_t flags = 0)
+{
+    jit::BlockProfile& profile = profiles[pc];
+    memset(&profile, 0, sizeof(profile));
+    profile.m_pc = pc;
+    profile.m_flags = flags;
+    profile.m_executions = executions;
+    profile.m_successors[0] = successor0;
+    profile.m_edgeCounts[0] = edge0;
+    profile.m_successors[1] = successor1;
+    profile.m_edgeCounts[1] = edge1;
+    return profile;
+}
+
+static bool traceIs(const std::vector<jit::RegionBlock>& trace, std::initializer_list<uint32_t> pcs)
+{
+    if (trace.size() != pcs.size())
+        return false;
+    size_t i = 0;
+    for (uint32_t pc : pcs) {
+        if (trace[i++].m_pc != pc)
+            return false;
+    }
+    return true;
+}
+
+static void testFormTrace()
+{
+    std::vector<jit::RegionBlock> trace;
+    {
+        // the profile of testsLoop: the entry falls into the first loop,
+        // which closes on itself, then the second loop.
+        ProfileMap profiles;
+        addBlock(profiles, 0x1000, 1, 0x1008, 1);
+        addBlock(profiles, 0x1008, 100, 0x1008, 99, 0x1018, 1);
+        addBlock(profiles, 0x1018, 1, 0x1020, 1);
+        addBlock(profiles, 0x1020, 100, 0x1020, 99, 0x1034, 1);
+        jit::formTrace(profiles[0x1000], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x1000, 0x1008 }));
+        jit::formTrace(profiles[0x1008], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x1008 }));
+        jit::formTrace(profiles[0x1018], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x1018, 0x1020 }));
+    }
+    {
+        // a loop of three blocks closes on its entry, a balanced branch
+        // stops the trace.
+        ProfileMap profiles;
+        addBlock(profiles, 0x2000, 50, 0x2010, 48, 0x2100, 2);
+        addBlock(profiles, 0x2010, 48, 0x2020, 48);
+        addBlock(profiles, 0x2020, 48, 0x2000, 47);
+        addBlock(profiles, 0x2100, 10, 0x2110, 5, 0x2120, 5);
+        addBlock(profiles, 0x2110, 5);
+        jit::formTrace(profiles[0x2000], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x2000, 0x2010, 0x2020 }));
+        jit::formTrace(profiles[0x2100], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x2100 }));
+    }
+    {
+        // a dominant indirect target of the same instruction set is
+        // followed, a thumb target is not.
+        ProfileMap profiles;
+        jit::BlockProfile& ret = addBlock(profiles, 0x3000, 10);
+        ret.m_indirect.m_targets[0] = 0x3100;
+        ret.m_indirect.m_counts[0] = 9;
+        ret.m_indirect.m_others = 1;
+        addBlock(profiles, 0x3100, 9);
+        jit::BlockProfile& thumb = addBlock(profiles, 0x3200, 10);
+        thumb.m_indirect.m_targets[0] = 0x3101;
+        thumb.m_indirect.m_counts[0] = 10;
+        jit::formTrace(profiles[0x3000], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x3000, 0x3100 }));
+        jit::formTrace(profiles[0x3200], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x3200 }));
+    }
+    {
+        // blocks with other flags, and blocks without a profile, end the
+        // trace, an entry inside an IT block is a trace of its own.
+        ProfileMap profiles;
+        addBlock(profiles, 0x4000, 10, 0x4010, 10);
+        addBlock(profiles, 0x4010, 10, 0x4020, 10, 0, 0, 1 << ARM_TBFLAG_THUMB_SHIFT);
+        addBlock(profiles, 0x4100, 10, 0x4200, 10);
+        uint64_t condexec = static_cast<uint64_t>(0x10) << ARM_TBFLAG_CONDEXEC_SHIFT;
+        addBlock(profiles, 0x4300, 10, 0x4310, 10, 0, 0, condexec);
+        addBlock(profiles, 0x4310, 10, 0, 0, 0, 0, condexec);
+        jit::formTrace(profiles[0x4000], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x4000 }));
+        jit::formTrace(profiles[0x4100], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x4100 }));
+        jit::formTrace(profiles[0x4300], lookupProfile, &profiles, trace);
+        UNIT_CHECK(traceIs(trace, { 0x4300 }));
+        UNIT_CHECK(trace[0].m_flags == condexec);
+    }
+    {
+        // a long straight line is cut into traces of at most 16 blocks.
+        ProfileMap profiles;
+        for (uint32_t i = 0; i < 20; ++i)
+            addBlock(profiles, 0x5000 + i * 0x10, 10, 0x5010 + i * 0x10, 10);
+        jit::formTrace(profiles[0x5000], lookupProfile, &profiles, trace);
+        UNIT_CHECK(trace.size() == 16);
+        UNIT_CHECK(trace[15].m_pc == 0x50f0);
+    }
+}
+
+int main()
+{
+    testStackMapReader();
+    testStackMapReaderFailure();
+    testFormTrace();
+    if (g_failures) {
+        fprintf(stderr, "%d checks failed\n", g_failures);
+        return 1;
+    }
+    printf("all unit tests passed\n");
+    return 0;
+}
@@ -7,19 +7,26 @@
 #include <pthread.h>
 #include <memory>
 #include <fstream>
+#include <map>
+#include <set>
 #include <streambuf>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "IRContextInternal.h"
 #include "RegisterInit.h"
 #include "Check.h"
 #include "log.h"
 #include "cpuinit.h"
 #include "TcgGenerator.h"
+#include "CompileQueue.h"
 #include "ExecutableMemoryAllocator.h"
+#include "GuestMemory.h"
 
 class MyExecutableMemoryAllocator : public jit::ExecutableMemoryAllocator {
 public:
-    static const size_t execMemSize = 4096;
+    static const size_t execMemSize = 4096 * 4;
     MyExecutableMemoryAllocator()
         : m_buffer(nullptr)
     {
@@ -46,11 +53,299 @@ private:
     void* m_buffer;
 };
 
+// --queue: the translations of all compile workers, kept until the test
+// ends.
+class SharedExecutableMemoryAllocator : public jit::ExecutableMemoryAllocator {
+public:
+    static const size_t execMemSize = 1024 * 1024;
+    SharedExecutableMemoryAllocator()
+        : m_used(0)
+    {
+        pthread_mutex_init(&m_lock, nullptr);
+        m_buffer = static_cast<char*>(mmap(nullptr, execMemSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        EMASSERT(m_buffer != MAP_FAILED);
+    }
+    ~SharedExecutableMemoryAllocator()
+    {
+        munmap(m_buffer, execMemSize);
+        pthread_mutex_destroy(&m_lock);
+    }
+
+    bool contains(uintptr_t address) const
+    {
+        return address >= reinterpret_cast<uintptr_t>(m_buffer) && address < reinterpret_cast<uintptr_t>(m_buffer) + execMemSize;
+    }
+
+private:
+    virtual void* allocate(int size, int align) override
+    {
+        pthread_mutex_lock(&m_lock);
+        size_t start = m_used;
+        if (align > 1)
+            start = (start + align - 1) & ~static_cast<size_t>(align - 1);
+        EMASSERT(start + size <= execMemSize);
+        m_used = start + size;
+        pthread_mutex_unlock(&m_lock);
+        return m_buffer + start;
+    }
+
+private:
+    pthread_mutex_t m_lock;
+    char* m_buffer;
+    size_t m_used;
+};
+
+// --llvm: translate every block with the LLVM tier instead of qemu tcg.
+static bool g_optimal = false;
+// --bench N: translate every block N more times and report the mean
+// latency. Pair with --no-reuse to compare against rebuilding the LLVM
+// pipeline for every block.
+static int g_benchRounds = 0;
+// --promote: keep guest registers in SSA values in LLVM translations.
+static bool g_promote = false;
+// --function: translate the whole guest function at each pc with the LLVM
+// tier, so guest loops run inside one translation.
+static bool g_function = false;
+// --replay: with --llvm, record every block with the baseline first and
+// give the LLVM tier the recording instead of the guest code.
+static bool g_replay = false;
+// --queue: hot baseline blocks go to a CompileQueue, and the LLVM
+// translation it installs runs from then on. The baseline blocks are kept
+// and chained, install moves their chained exits to the LLVM translation.
+static bool g_queue = false;
+// --queue-cancel: with --queue, cancel the first request of every block
+// while the worker compiles it. The block is queued again when it next
+// gets hot.
+static bool g_queueCancel = false;
+// --trace: run the test with the baseline first, counting the executions
+// and the edges of every block. Then run it again from the start, each
+// time with the LLVM translation of the trace formTrace grows from the
+// block at pc.
+static bool g_trace = false;
+// --chain: with the LLVM tier, keep every translation, and link the
+// direct exits of later ones straight to the translations already kept,
+// see ChainLookup.h. A loop's back edge jumps to the loop head without
+// going through the dispatcher, carrying the pinned registers. Blocks with
+// exits chained into them are translated once more and the exits
+// retargeted to the new translation.
+static bool g_chain = false;
+// --deopt: run the test with the baseline first, recording r0-r12 at the
+// first execution of every block. Then run it again from the start with
+// the LLVM tier, speculating that each block starts with those values
+// and that the guest code is not stored to. A failed guard resumes the
+// block in the baseline at the guarded instruction.
+static bool g_deopt = false;
+
+static double elapsed(const struct timespec& t1, const struct timespec& t2)
+{
+    double t = t2.tv_sec - t1.tv_sec;
+    t += static_cast<double>(t2.tv_nsec - t1.tv_nsec) / 1e9;
+    return t;
+}
+
+static double timedTranslate(CPUARMState* env, jit::TranslateDesc& tdesc)
+{
+    struct timespec t2, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    jit::translate(env, tdesc);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    return elapsed(t1, t2);
+}
+
 static void invokeLLVM(CPUARMState* env, void* obj)
 {
     LOGE("should try to invoke llvm here, env = %p, obj = %p.\n", env, obj);
 }
 
+// the pc and tb flags of the block env is about to run, what translations
+// are kept by.
+typedef std::pair<uint32_t, uint64_t> BlockKey;
+
+static BlockKey blockKey(CPUARMState* env)
+{
+    uint32_t pc;
+    uint64_t flags;
+    jit::getBlockState(env, &pc, &flags);
+    return BlockKey(pc, flags);
+}
+
+// --queue: a baseline block kept for chaining, and the counter its entries
+// decrement.
+struct BaselineBlock {
+    void* m_code;
+    int32_t m_hotCounter;
+};
+
+// --queue: blocks get hot on their second entry, once the exits into them
+// have been chained.
+static const uint32_t queueHotThreshold = 2;
+
+// what the guest thread of a test shares with the worker of its
+// CompileQueue in --queue mode.
+struct QueueDriver {
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_cond;
+    jit::CompileQueue* m_queue;
+    // queued, and neither installed nor cancelled yet.
+    std::set<BlockKey> m_queued;
+    std::map<BlockKey, void*> m_installed;
+    unsigned m_installs;
+    // the baseline blocks, only used by the guest thread, and the direct
+    // jumps of baseline blocks chained to each. Install moves the sites
+    // over to the LLVM translation.
+    std::map<BlockKey, BaselineBlock> m_baseline;
+    std::multimap<BlockKey, uintptr_t> m_chainedSites;
+    unsigned m_retargets;
+    // --queue-cancel: the blocks cancelled once, and the block the worker
+    // holds until the guest thread cancels it.
+    std::set<BlockKey> m_cancelled;
+    bool m_inFlight;
+    BlockKey m_inFlightKey;
+};
+
+// called with the lock of the CompileQueue held, so it must not wait for
+// the guest thread.
+static void queueInstall(void* opaque, uint32_t pc, uint64_t flags, const jit::TranslateDesc& desc)
+{
+    QueueDriver* driver = static_cast<QueueDriver*>(opaque);
+    BlockKey key(pc, flags);
+    pthread_mutex_lock(&driver->m_lock);
+    driver->m_installs++;
+    driver->m_installed[key] = desc.m_code;
+    driver->m_queued.erase(key);
+    // baseline exits enter LLVM translations at m_code, where the pinned
+    // registers are loaded.
+    auto sites = driver->m_chainedSites.equal_range(key);
+    for (auto it = sites.first; it != sites.second; ++it) {
+        jit::retargetDirectJump(it->second, reinterpret_cast<uintptr_t>(desc.m_code));
+        driver->m_retargets++;
+    }
+    driver->m_chainedSites.erase(sites.first, sites.second);
+    pthread_cond_broadcast(&driver->m_cond);
+    pthread_mutex_unlock(&driver->m_lock);
+}
+
+// --queue-cancel: the compile hook of the CompileQueue. Holds the first
+// request of each block in flight until the guest thread has cancelled
+// it.
+static void queueInFlight(void* opaque, uint32_t pc, uint64_t flags)
+{
+    QueueDriver* driver = static_cast<QueueDriver*>(opaque);
+    BlockKey key(pc, flags);
+    pthread_mutex_lock(&driver->m_lock);
+    if (!driver->m_cancelled.count(key)) {
+        driver->m_inFlight = true;
+        driver->m_inFlightKey = key;
+        pthread_cond_broadcast(&driver->m_cond);
+        while (!driver->m_cancelled.count(key))
+            pthread_cond_wait(&driver->m_cond, &driver->m_lock);
+    }
+    pthread_mutex_unlock(&driver->m_lock);
+}
+
+// called with m_lock held. cancel takes the lock of the CompileQueue,
+// which queueInstall holds when it takes m_lock, so m_lock is released
+// around it.
+static void cancelInFlight(QueueDriver* driver)
+{
+    BlockKey key = driver->m_inFlightKey;
+    driver->m_inFlight = false;
+    pthread_mutex_unlock(&driver->m_lock);
+    driver->m_queue->cancel(key.first, key.first + 1);
+    pthread_mutex_lock(&driver->m_lock);
+    driver->m_cancelled.insert(key);
+    driver->m_queued.erase(key);
+    pthread_cond_broadcast(&driver->m_cond);
+}
+
+// the LLVM translation of the block, null if there is none. Waits for the
+// block if it is queued, so a test runs the same translations every time.
+static void* waitInstalled(QueueDriver* driver, const BlockKey& key)
+{
+    pthread_mutex_lock(&driver->m_lock);
+    while (true) {
+        if (driver->m_inFlight)
+            cancelInFlight(driver);
+        else if (driver->m_queued.count(key))
+            pthread_cond_wait(&driver->m_cond, &driver->m_lock);
+        else
+            break;
+    }
+    auto found = driver->m_installed.find(key);
+    void* code = found != driver->m_installed.end() ? found->second : nullptr;
+    pthread_mutex_unlock(&driver->m_lock);
+    return code;
+}
+
+// the dispHot of the baseline blocks, called on the guest thread inside
+// the block. The block carries on in the baseline, and the chained exits
+// into it go to the LLVM translation from the next jump on. A cancelled
+// block counts again.
+static void queueHot(CPUARMState* env, void* obj)
+{
+    QueueDriver* driver = static_cast<QueueDriver*>(obj);
+    BlockKey key = blockKey(env);
+    pthread_mutex_lock(&driver->m_lock);
+    bool queue = !driver->m_installed.count(key) && driver->m_queued.insert(key).second;
+    pthread_mutex_unlock(&driver->m_lock);
+    if (!queue)
+        return;
+    driver->m_queue->enqueue(env, 1);
+    if (!waitInstalled(driver, key))
+        driver->m_baseline[key].m_hotCounter = queueHotThreshold;
+}
+
+// link the direct jump at site of a baseline block to code, the
+// translation of the block at key. A site chained to a baseline block is
+// kept for queueInstall.
+static void chainBaselineSite(QueueDriver* driver, uintptr_t site, const BlockKey& key, void* code)
+{
+    pthread_mutex_lock(&driver->m_lock);
+    jit::patchDirectJump(site, reinterpret_cast<uintptr_t>(code));
+    if (!driver->m_installed.count(key))
+        driver->m_chainedSites.insert(std::make_pair(key, site));
+    pthread_mutex_unlock(&driver->m_lock);
+}
+
+// wait until every request is installed or cancelled.
+static void drainQueue(QueueDriver* driver)
+{
+    pthread_mutex_lock(&driver->m_lock);
+    while (driver->m_inFlight || !driver->m_queued.empty()) {
+        if (driver->m_inFlight)
+            cancelInFlight(driver);
+        else
+            pthread_cond_wait(&driver->m_cond, &driver->m_lock);
+    }
+    pthread_mutex_unlock(&driver->m_lock);
+}
+
+// --chain: the LLVM translations of a test, by pc and tb flags.
+struct ChainDriver {
+    SharedExecutableMemoryAllocator m_allocator;
+    std::map<BlockKey, jit::TranslateDesc> m_translations;
+    // the direct exits linked to a kept translation, by the block they
+    // jump to, and the blocks translated again since.
+    std::multimap<BlockKey, uintptr_t> m_sites;
+    std::set<BlockKey> m_replaced;
+    unsigned m_chainedExits;
+    unsigned m_retargets;
+    unsigned m_dispatcherRuns;
+};
+
+// the chain lookup of the translations, called by link.
+static void* chainLookup(void* opaque, uint32_t pc, uint64_t flags, uintptr_t site)
+{
+    ChainDriver* driver = static_cast<ChainDriver*>(opaque);
+    BlockKey key(pc, flags);
+    auto found = driver->m_translations.find(key);
+    if (found == driver->m_translations.end())
+        return nullptr;
+    driver->m_chainedExits++;
+    driver->m_sites.insert(std::make_pair(key, site));
+    return found->second.m_chainEntry;
+}
+
 extern "C" {
 void yyparse(IRContext*);
 typedef void* yyscan_t;
@@ -68,6 +363,114 @@ void vex_disp_cp_chain_me_to_fastEP(void);
 void vex_disp_cp_xindir(void);
 void vex_disp_cp_xassisted(void);
 void vex_disp_cp_evcheck_fail(void);
+void vex_disp_cp_deopt(void);
+}
+
+// VG_TRC_CHAIN_ME_TO_FAST_EP of dispatch_vex.S, a direct exit.
+static const uintptr_t trcChainMeToFastEP = 51;
+// VG_TRC_DEOPT, a failed speculation guard.
+static const uintptr_t trcDeopt = 53;
+
+// --chain: translate the block at env with the LLVM tier and keep it.
+static const jit::TranslateDesc& keepChained(ChainDriver* driver, CPUARMState* env)
+{
+    jit::TranslateDesc desc = { reinterpret_cast<void*>(vex_disp_cp_chain_me_to_fastEP), reinterpret_cast<void*>(vex_disp_cp_xindir), nullptr, nullptr, &driver->m_allocator, true, nullptr, 0 };
+    desc.m_promoteRegisters = g_promote;
+    desc.m_chainLookup = chainLookup;
+    desc.m_chainOpaque = driver;
+    jit::translate(env, desc);
+    jit::TranslateDesc& kept = driver->m_translations[blockKey(env)];
+    kept = desc;
+    return kept;
+}
+
+// --chain: translate each block with exits chained into it once more, as
+// another tier would replace it, and move the exits over to the new
+// translation with retargetDirectJump. That checks the chained form of
+// the exits and that link padded their immediates into one cache line.
+static void replaceChained(ChainDriver* driver, CPUARMState* env)
+{
+    uint32_t pc = env->regs[15];
+    for (auto it = driver->m_sites.begin(); it != driver->m_sites.end();) {
+        BlockKey key = it->first;
+        env->regs[15] = key.first;
+        if (!driver->m_replaced.count(key) && blockKey(env) == key) {
+            driver->m_replaced.insert(key);
+            uintptr_t entry = reinterpret_cast<uintptr_t>(keepChained(driver, env).m_chainEntry);
+            auto sites = driver->m_sites.equal_range(key);
+            for (auto site = sites.first; site != sites.second; ++site) {
+                jit::retargetDirectJump(site->second, entry);
+                driver->m_retargets++;
+            }
+        }
+        it = driver->m_sites.upper_bound(key);
+    }
+    env->regs[15] = pc;
+}
+
+typedef std::unordered_map<uint32_t, jit::BlockProfile> ProfileMap;
+
+static const jit::BlockProfile* lookupProfile(void* opaque, uint32_t pc)
+{
+    const ProfileMap* profiles = static_cast<const ProfileMap*>(opaque);
+    auto found = profiles->find(pc);
+    return found != profiles->end() ? &found->second : nullptr;
+}
+
+// the first two successors get a slot, as the two direct exits would.
+static void recordEdge(jit::BlockProfile& profile, uint32_t successor)
+{
+    for (int i = 0; i < 2; ++i) {
+        if (profile.m_successors[i] == 0 || profile.m_successors[i] == successor) {
+            profile.m_successors[i] = successor;
+            profile.m_edgeCounts[i]++;
+            return;
+        }
+    }
+}
+
+// --trace: the profile an embedder would collect from baseline blocks.
+// The baseline counts the indirect targets itself.
+static void profileBlocks(CPUARMState* env, ProfileMap& profiles)
+{
+    uintptr_t twoWords[2];
+    while (env->regs[15] != 0xfffffffe) {
+        uint32_t pc;
+        uint64_t flags;
+        jit::getBlockState(env, &pc, &flags);
+        jit::BlockProfile& profile = profiles[pc];
+        profile.m_pc = pc;
+        profile.m_flags = flags;
+        profile.m_executions++;
+        MyExecutableMemoryAllocator allocator;
+        jit::TranslateDesc tdesc = { reinterpret_cast<void*>(vex_disp_cp_chain_me_to_fastEP), reinterpret_cast<void*>(vex_disp_cp_xindir), nullptr, nullptr, &allocator, false };
+        tdesc.m_indirectProfile = &profile.m_indirect;
+        jit::translate(env, tdesc);
+        vex_disp_run_translations(twoWords, env, allocator.buffer());
+        if (twoWords[0] == trcChainMeToFastEP)
+            recordEdge(profile, env->regs[15]);
+    }
+}
+
+typedef std::unordered_map<uint32_t, std::vector<jit::Speculation> > SpeculationMap;
+
+// --deopt: the speculations, the core registers each block started with
+// the first time. Later executions of a loop body start with others.
+static void speculateBlocks(CPUARMState* env, SpeculationMap& speculations)
+{
+    uintptr_t twoWords[2];
+    while (env->regs[15] != 0xfffffffe) {
+        uint32_t pc = env->regs[15];
+        if (!speculations.count(pc)) {
+            std::vector<jit::Speculation>& values = speculations[pc];
+            for (int i = 0; i < 13; ++i)
+                values.push_back({ pc, static_cast<uint32_t>(offsetof(CPUARMState, regs) + i * sizeof(uint32_t)), env->regs[i] });
+        }
+        MyExecutableMemoryAllocator allocator;
+        jit::TranslateDesc tdesc = { reinterpret_cast<void*>(vex_disp_cp_chain_me_to_fastEP), reinterpret_cast<void*>(vex_disp_cp_xindir), nullptr, nullptr, &allocator, false };
+        jit::translate(env, tdesc);
+        vex_disp_run_translations(twoWords, env, allocator.buffer());
+    }
 }
 
 static void initGuestState(CPUARMState& state, const IRContextInternal& context, char* stack)
@@ -77,7 +480,7 @@ static void initGuestState(CPUARMState& state, const IRContextInternal& context,
         ri.m_control->init(state, ri.m_name);
     }
     // init sp
-    state.regs[13] = reinterpret_cast<uintptr_t>(stack);
+    state.regs[13] = h2g(stack);
     state.regs[13] += 1024;
     // init lr
     state.regs[14] = 0xffffffff;
@@ -182,6 +585,17 @@ static void assmbleAndLoad(const char* path, std::string& output)
     }
 }
 
+// CheckEnvLoads: report the file as failed if the LLVM translations keep
+// more loads of CPUARMState per guest instruction than the test allows.
+static void checkEnvLoads(const char* fileName, const IRContextInternal& context, uint32_t envLoads, uint32_t guestInsns)
+{
+    if (!g_optimal || context.m_maxEnvLoadsPerInsn < 0 || guestInsns == 0)
+        return;
+    double perInsn = static_cast<double>(envLoads) / guestInsns;
+    bool passed = perInsn <= context.m_maxEnvLoadsPerInsn;
+    LOGE("%s: %u env loads in %u guest instructions, %lf per instruction, %s.\n", fileName, envLoads, guestInsns, perInsn, passed ? "passed" : "failed");
+}
+
 static void* worker(void* p)
 {
     // assemble and load the binary
@@ -206,38 +620,248 @@ static void* worker(void* p)
     ARMCPU cpu = { 0 };
 
     cortex_a15_initfn(&cpu);
-    std::vector<char> stack(1024);
-    initGuestState(cpu.env, context, const_cast<char*>(stack.data()));
+    char* stack = static_cast<char*>(guestAlloc(1024));
+    initGuestState(cpu.env, context, stack);
     // setup pc
-    cpu.env.regs[15] = (uint32_t)(uintptr_t)binaryCode.data();
+    char* guestCode = static_cast<char*>(guestAlloc(binaryCode.size()));
+    memcpy(guestCode, binaryCode.data(), binaryCode.size());
+    cpu.env.regs[15] = h2g(guestCode);
+    ProfileMap profiles;
+    size_t traceBlocks = 0, traces = 0;
+    SpeculationMap speculations;
+    unsigned deopts = 0, resumes = 0;
+    bool deopted = false;
+    if (g_trace)
+        profileBlocks(&cpu.env, profiles);
+    if (g_deopt)
+        speculateBlocks(&cpu.env, speculations);
+    if (g_trace || g_deopt) {
+        // start over from a fresh cpu and the code as loaded, a test may
+        // store into it.
+        cortex_a15_deinitfn(&cpu);
+        memset(&cpu, 0, sizeof(cpu));
+        cortex_a15_initfn(&cpu);
+        initGuestState(cpu.env, context, stack);
+        memcpy(guestCode, binaryCode.data(), binaryCode.size());
+        cpu.env.regs[15] = h2g(guestCode);
+    }
     uintptr_t twoWords[2];
+    int32_t hotCounter;
+    double benchTime = 0, runTime = 0;
+    int benchCount = 0;
+    uint32_t envLoads = 0, guestInsns = 0;
+    std::unique_ptr<SharedExecutableMemoryAllocator> queueAllocator;
+    std::unique_ptr<SharedExecutableMemoryAllocator> baselineAllocator;
+    std::unique_ptr<QueueDriver> driver;
+    unsigned queueRuns = 0;
+    std::unique_ptr<ChainDriver> chainDriver;
+    if (g_chain)
+        chainDriver.reset(new ChainDriver());
+    if (g_queue) {
+        queueAllocator.reset(new SharedExecutableMemoryAllocator);
+        baselineAllocator.reset(new SharedExecutableMemoryAllocator);
+        driver.reset(new QueueDriver());
+        pthread_mutex_init(&driver->m_lock, nullptr);
+        pthread_cond_init(&driver->m_cond, nullptr);
+        jit::TranslateDesc queueDesc = { reinterpret_cast<void*>(vex_disp_cp_chain_me_to_fastEP), reinterpret_cast<void*>(vex_disp_cp_xindir), nullptr, nullptr, queueAllocator.get(), true, nullptr, 0 };
+        queueDesc.m_promoteRegisters = g_promote;
+        driver->m_queue = new jit::CompileQueue(1, queueDesc, queueInstall, driver.get());
+        if (g_queueCancel)
+            driver->m_queue->setCompileHook(queueInFlight, driver.get());
+    }
+    // --queue: the direct jump of the baseline block that last left for
+    // the dispatcher, chained to the block that runs next.
+    uintptr_t chainSite = 0;
     while (cpu.env.regs[15] != 0xfffffffe) {
+        if (driver) {
+            BlockKey key = blockKey(&cpu.env);
+            void* code = waitInstalled(driver.get(), key);
+            bool optimized = code != nullptr;
+            if (!code) {
+                BaselineBlock& block = driver->m_baseline[key];
+                if (!block.m_code) {
+                    jit::TranslateDesc baselineDesc = { reinterpret_cast<void*>(vex_disp_cp_chain_me_to_fastEP), reinterpret_cast<void*>(vex_disp_cp_xindir), queueHot, driver.get(), baselineAllocator.get(), false, &block.m_hotCounter, queueHotThreshold };
+                    jit::translate(&cpu.env, baselineDesc);
+                    block.m_code = baselineDesc.m_code;
+                }
+                code = block.m_code;
+            }
+            if (chainSite)
+                chainBaselineSite(driver.get(), chainSite, key, code);
+            vex_disp_run_translations(twoWords, &cpu.env, code);
+            if (optimized)
+                queueRuns++;
+            // the exits of LLVM translations are left to the dispatcher.
+            chainSite = twoWords[0] == trcChainMeToFastEP && baselineAllocator->contains(twoWords[1]) ? twoWords[1] : 0;
+            LOGE("%s: status is %d r15 = %08x.\n", fileName, static_cast<int>(twoWords[0]), cpu.env.regs[15]);
+            continue;
+        }
+        if (chainDriver) {
+            auto found = chainDriver->m_translations.find(blockKey(&cpu.env));
+            if (found == chainDriver->m_translations.end())
+                keepChained(chainDriver.get(), &cpu.env);
+            replaceChained(chainDriver.get(), &cpu.env);
+            found = chainDriver->m_translations.find(blockKey(&cpu.env));
+            vex_disp_run_translations(twoWords, &cpu.env, found->second.m_code);
+            chainDriver->m_dispatcherRuns++;
+            LOGE("%s: status is %d r15 = %08x.\n", fileName, static_cast<int>(twoWords[0]), cpu.env.regs[15]);
+            continue;
+        }
         MyExecutableMemoryAllocator allocator;
-        jit::TranslateDesc tdesc = { reinterpret_cast<void*>(vex_disp_cp_chain_me_to_fastEP), reinterpret_cast<void*>(vex_disp_cp_xindir), invokeLLVM, reinterpret_cast<void*>(-1), &allocator };
-        struct timespec t2, t1;
-        clock_gettime(CLOCK_MONOTONIC, &t1);
-        jit::translate(&cpu.env, tdesc);
-        clock_gettime(CLOCK_MONOTONIC, &t2);
-        double t = t2.tv_sec - t1.tv_sec;
-        t += static_cast<double>(t2.tv_nsec - t1.tv_nsec) / 1e9;
+        jit::TranslateDesc tdesc = { reinterpret_cast<void*>(vex_disp_cp_chain_me_to_fastEP), reinterpret_cast<void*>(vex_disp_cp_xindir), invokeLLVM, reinterpret_cast<void*>(-1), &allocator, g_optimal, &hotCounter, 1 };
+        tdesc.m_promoteRegisters = g_promote;
+        tdesc.m_function = g_function;
+        std::vector<jit::RegionBlock> trace;
+        if (g_trace) {
+            uint32_t pc;
+            uint64_t flags;
+            jit::getBlockState(&cpu.env, &pc, &flags);
+            const jit::BlockProfile* profile = lookupProfile(&profiles, pc);
+            if (profile && profile->m_flags == flags)
+                jit::formTrace(*profile, lookupProfile, &profiles, trace);
+            tdesc.m_optimal = true;
+            tdesc.m_region = trace.data();
+            tdesc.m_regionSize = trace.size();
+            tdesc.m_profileLookup = lookupProfile;
+            tdesc.m_profileOpaque = &profiles;
+            tdesc.m_executions = profile ? profile->m_executions : 0;
+            traceBlocks += trace.size();
+            traces++;
+        }
+        if (g_deopt) {
+            // resume where the guard failed, which may be inside a block.
+            tdesc.m_optimal = !deopted;
+            if (deopted)
+                resumes++;
+            else
+                tdesc.m_dispDeopt = reinterpret_cast<void*>(vex_disp_cp_deopt);
+            auto found = speculations.find(cpu.env.regs[15]);
+            if (found != speculations.end()) {
+                tdesc.m_speculations = found->second.data();
+                tdesc.m_speculationCount = found->second.size();
+            }
+            tdesc.m_codeStart = h2g(guestCode);
+            tdesc.m_codeEnd = h2g(guestCode) + binaryCode.size();
+        }
+        jit::OpRecording recording;
+        if (tdesc.m_optimal && g_replay) {
+            MyExecutableMemoryAllocator baselineAllocator;
+            jit::TranslateDesc baselineDesc = tdesc;
+            baselineDesc.m_optimal = false;
+            baselineDesc.m_executableMemAllocator = &baselineAllocator;
+            baselineDesc.m_recording = &recording;
+            jit::translate(&cpu.env, baselineDesc);
+            tdesc.m_recording = &recording;
+        }
+        double t = timedTranslate(&cpu.env, tdesc);
+        envLoads += tdesc.m_envLoads;
+        guestInsns += tdesc.m_guestInsns;
         LOGE("using %lf seconds to translate.\n", t);
+        for (int i = 0; i < g_benchRounds; ++i) {
+            MyExecutableMemoryAllocator benchAllocator;
+            jit::TranslateDesc benchDesc = tdesc;
+            benchDesc.m_executableMemAllocator = &benchAllocator;
+            benchTime += timedTranslate(&cpu.env, benchDesc);
+            benchCount++;
+        }
         void* execMem = allocator.buffer();
+        struct timespec t2, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
         vex_disp_run_translations(twoWords, &cpu.env, execMem);
-        LOGE("%s: status is %d r15 = %08x.\n", fileName, twoWords[0], cpu.env.regs[15]);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        runTime += elapsed(t1, t2);
+        deopted = g_deopt && twoWords[0] == trcDeopt;
+        if (deopted)
+            deopts++;
+        LOGE("%s: status is %d r15 = %08x.\n", fileName, static_cast<int>(twoWords[0]), cpu.env.regs[15]);
+    }
+    if (benchCount) {
+        LOGE("%s: %d translations, %lf ms per block.\n", fileName, benchCount, benchTime * 1e3 / benchCount);
+        LOGE("%s: %lf ms running the translations.\n", fileName, runTime * 1e3);
+    }
+    if (driver) {
+        drainQueue(driver.get());
+        delete driver->m_queue;
+        // a cancelled translation installed too would show up as a second
+        // install of its block.
+        bool passed = driver->m_installs == driver->m_installed.size() && queueRuns != 0 && driver->m_retargets != 0;
+        LOGE("%s: %u translations installed for %zu blocks, %zu cancelled in flight, %u chained sites retargeted, %u runs, %s.\n",
+            fileName, driver->m_installs, driver->m_installed.size(), driver->m_cancelled.size(), driver->m_retargets, queueRuns, passed ? "passed" : "failed");
+        pthread_cond_destroy(&driver->m_cond);
+        pthread_mutex_destroy(&driver->m_lock);
+    }
+    if (chainDriver) {
+        bool passed = chainDriver->m_chainedExits != 0 && chainDriver->m_retargets != 0;
+        LOGE("%s: %zu translations, %u exits chained, %u retargeted, %u dispatcher runs, %s.\n",
+            fileName, chainDriver->m_translations.size(), chainDriver->m_chainedExits, chainDriver->m_retargets, chainDriver->m_dispatcherRuns, passed ? "passed" : "failed");
     }
-    checkRun("llvm", context, twoWords, cpu.env);
+    if (g_deopt) {
+        bool passed = deopts != 0 && resumes == deopts;
+        LOGE("%s: %u deopts, %u resumed in the baseline, %s.\n", fileName, deopts, resumes, passed ? "passed" : "failed");
+    }
+    if (traces)
+        LOGE("%s: %zu traces, %lf blocks per trace.\n", fileName, traces, static_cast<double>(traceBlocks) / traces);
+    checkRun(driver ? "queue" : chainDriver ? "chain" : g_deopt ? "deopt" : g_trace ? "trace" : g_optimal ? "llvm" : "qemu", context, twoWords, cpu.env);
+    checkEnvLoads(fileName, context, envLoads, guestInsns);
     cortex_a15_deinitfn(&cpu);
+    guestFree(guestCode);
+    guestFree(stack);
     return nullptr;
 }
 
 int main(int argc, char** argv)
 {
-    if (argc <= 1) {
-        LOGE("need one arg.");
+    int firstFile = 1;
+    for (; firstFile < argc && strncmp(argv[firstFile], "--", 2) == 0; ++firstFile) {
+        if (strcmp(argv[firstFile], "--llvm") == 0) {
+            g_optimal = true;
+        }
+        else if (strcmp(argv[firstFile], "--promote") == 0) {
+            g_promote = true;
+        }
+        else if (strcmp(argv[firstFile], "--function") == 0) {
+            g_function = true;
+        }
+        else if (strcmp(argv[firstFile], "--replay") == 0) {
+            g_replay = true;
+        }
+        else if (strcmp(argv[firstFile], "--trace") == 0) {
+            g_trace = true;
+        }
+        else if (strcmp(argv[firstFile], "--deopt") == 0) {
+            g_deopt = true;
+        }
+        else if (strcmp(argv[firstFile], "--chain") == 0) {
+            g_chain = true;
+        }
+        else if (strcmp(argv[firstFile], "--queue") == 0) {
+            g_queue = true;
+        }
+        else if (strcmp(argv[firstFile], "--queue-cancel") == 0) {
+            g_queue = true;
+            g_queueCancel = true;
+        }
+        else if (strcmp(argv[firstFile], "--no-reuse") == 0) {
+            jit::setLLVMPipelineRecycleLimit(1);
+        }
+        else if (strcmp(argv[firstFile], "--capture") == 0 && firstFile + 1 < argc) {
+            if (!jit::startOpCapture(argv[++firstFile]))
+                exit(1);
+        }
+        else if (strcmp(argv[firstFile], "--bench") == 0 && firstFile + 1 < argc) {
+            g_benchRounds = atoi(argv[++firstFile]);
+        }
+        else {
+            break;
+        }
+    }
+    if (argc <= firstFile || strncmp(argv[firstFile], "--", 2) == 0) {
+        LOGE("usage: %s [--llvm] [--promote] [--function] [--replay] [--trace] [--chain] [--deopt] [--queue] [--queue-cancel] [--capture FILE] [--bench N] [--no-reuse] test.txt...\n", argv[0]);
         exit(1);
     }
+    initGuestMemory();
     std::vector<pthread_t> mythreads;
-    for (int i = 1; i < argc; ++i) {
+    for (int i = firstFile; i < argc; ++i) {
         pthread_t thread;
         if (0 != pthread_create(&thread, nullptr, worker, argv[i])) {
             LOGE("create thread error.\n");
@@ -66,5 +66,37 @@
                 '<(DEPTH)/qemu/qemu.gyp:libqemu',
             ],
         },
+        {
+            'target_name': 'replayBench',
+            'type': 'executable',
+            'sources': [ '<@(replay_bench_sources)',],
+            'include_dirs': [
+                '<(DEPTH)/qemu',
+                '<(DEPTH)/llvm',
+            ],
+            'defines': [
+                'LLVMLOG_LEVEL=<(llvmlog_level)',
+            ],
+            'dependencies': [
+                '<(DEPTH)/llvm/llvm.gyp:libllvm',
+                '<(DEPTH)/qemu/qemu.gyp:libqemu',
+            ],
+        },
+        {
+            'target_name': 'unitTests',
+            'type': 'executable',
+            'sources': [ '<@(unit_tests_sources)',],
+            'include_dirs': [
+                '<(DEPTH)/qemu',
+                '<(DEPTH)/llvm',
+            ],
+            'defines': [
+                'LLVMLOG_LEVEL=<(llvmlog_level)',
+            ],
+            'dependencies': [
+                '<(DEPTH)/llvm/llvm.gyp:libllvm',
+                '<(DEPTH)/qemu/qemu.gyp:libqemu',
+            ],
+        },
     ],
 }